@@ -15,10 +15,14 @@ LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/fs/BufferFile.cpp
 LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/fs/File.cpp
 LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/fs/FSFile.cpp
 LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/fs/MemoryFile.cpp
+LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/mt/EventLoopPool.cpp
+LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/mt/Future.cpp
+LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/mt/LockFreeQueue.cpp
 LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/mt/MsgThread.cpp
 LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/mt/Queue.cpp
 LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/mt/Semaphore.cpp
 LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/mt/Thread.cpp
+LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/mt/ThreadPool.cpp
 LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/net/HostNameResolver.cpp
 LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/net/IPAddress.cpp
 LOCAL_SRC_FILES += $(SRC_BASE_DIR)ting/net/Lib.cpp
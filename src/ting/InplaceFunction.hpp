@@ -0,0 +1,263 @@
+/* The MIT License:
+
+Copyright (c) 2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+
+
+/**
+ * @author Ivan Gagis <igagis@gmail.com>
+ */
+
+#pragma once
+
+#include <new>
+#include <cstddef>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+#include "util.hpp"
+
+
+namespace ting{
+
+
+
+template <class T_Signature, std::size_t capacity> class InplaceFunction;
+
+
+
+/**
+ * @brief Callable wrapper with fixed capacity inline storage.
+ * Similar to std::function, but the wrapped callable object is always stored right inside
+ * the InplaceFunction object, so creating, moving and destroying it never allocates memory.
+ * Trying to wrap a callable object which does not fit into the storage is a compile time error.
+ * Unlike std::function, InplaceFunction is move-only, so it can also wrap move-only
+ * callable objects, e.g. lambdas which capture std::unique_ptr.
+ * Usage:
+ * @code
+ * ting::InplaceFunction<int(int), 32> f = [](int a){return a + 1;};
+ * int res = f(3);
+ * @endcode
+ * @param T_Res - return type.
+ * @param T_Args - argument types.
+ * @param capacity - size of the inline storage in bytes, i.e. maximum size of the callable object.
+ */
+template <class T_Res, class... T_Args, std::size_t capacity> class InplaceFunction<T_Res(T_Args...), capacity>{
+	typedef typename std::aligned_storage<capacity, alignof(std::max_align_t)>::type T_Storage;
+
+	//operations on the stored callable object, there is one such structure per callable type
+	struct Ops{
+		T_Res (*invoke)(void* f, T_Args&&... args);
+
+		//move-construct object at 'to' from object at 'from' and destroy object at 'from'
+		void (*relocate)(void* to, void* from)NOEXCEPT;
+
+		void (*destroy)(void* f)NOEXCEPT;
+	};
+
+	template <class T_Callable> struct OpsFor{
+		static T_Res Invoke(void* f, T_Args&&... args){
+			return (*reinterpret_cast<T_Callable*>(f))(std::forward<T_Args>(args)...);
+		}
+
+		static void Relocate(void* to, void* from)NOEXCEPT{
+			T_Callable* c = reinterpret_cast<T_Callable*>(from);
+			new(to) T_Callable(std::move(*c));
+			c->~T_Callable();
+		}
+
+		static void Destroy(void* f)NOEXCEPT{
+			reinterpret_cast<T_Callable*>(f)->~T_Callable();
+		}
+
+		static const Ops ops;
+	};
+
+	const Ops* ops = nullptr;
+
+	mutable T_Storage storage;
+
+	template <class T_Callable> struct IsInplaceFunction : std::false_type{};
+	template <std::size_t c> struct IsInplaceFunction<InplaceFunction<T_Res(T_Args...), c>> : std::true_type{};
+
+public:
+	/**
+	 * @brief Size of the inline storage.
+	 */
+	static const std::size_t DCapacity = capacity;
+
+	/**
+	 * @brief Create empty function.
+	 */
+	InplaceFunction()NOEXCEPT{}
+
+	/**
+	 * @brief Create empty function.
+	 */
+	InplaceFunction(std::nullptr_t)NOEXCEPT{}
+
+	/**
+	 * @brief Create function wrapping a callable object.
+	 * If the callable object is a null function pointer or an empty std::function,
+	 * then empty function is created.
+	 * @param f - callable object to wrap. It is moved or copied into the inline storage.
+	 */
+	template <class T_Callable, class = typename std::enable_if<
+			!IsInplaceFunction<typename std::decay<T_Callable>::type>::value
+		>::type>
+	InplaceFunction(T_Callable&& f){
+		this->Set(std::forward<T_Callable>(f));
+	}
+
+	InplaceFunction(InplaceFunction&& f)NOEXCEPT{
+		this->MoveFrom(f);
+	}
+
+	InplaceFunction(const InplaceFunction&) = delete;
+	InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+	InplaceFunction& operator=(InplaceFunction&& f)NOEXCEPT{
+		if(this != &f){
+			this->Reset();
+			this->MoveFrom(f);
+		}
+		return *this;
+	}
+
+	InplaceFunction& operator=(std::nullptr_t)NOEXCEPT{
+		this->Reset();
+		return *this;
+	}
+
+	template <class T_Callable, class = typename std::enable_if<
+			!IsInplaceFunction<typename std::decay<T_Callable>::type>::value
+		>::type>
+	InplaceFunction& operator=(T_Callable&& f){
+		this->Reset();
+		this->Set(std::forward<T_Callable>(f));
+		return *this;
+	}
+
+	~InplaceFunction()NOEXCEPT{
+		this->Reset();
+	}
+
+	/**
+	 * @brief Check if the function is not empty.
+	 * @return true if the function wraps a callable object.
+	 * @return false if the function is empty.
+	 */
+	explicit operator bool()const NOEXCEPT{
+		return this->ops != nullptr;
+	}
+
+	/**
+	 * @brief Call the wrapped callable object.
+	 * @param args - arguments to pass to the callable object.
+	 * @return the value returned by the callable object.
+	 * @throw std::bad_function_call - if the function is empty.
+	 */
+	T_Res operator()(T_Args... args)const{
+		if(!this->ops){
+			throw std::bad_function_call();
+		}
+		return this->ops->invoke(&this->storage, std::forward<T_Args>(args)...);
+	}
+
+private:
+	template <class T> static bool IsNull(T* f)NOEXCEPT{
+		return f == nullptr;
+	}
+
+	template <class T> static bool IsNull(const std::function<T>& f)NOEXCEPT{
+		return !f;
+	}
+
+	template <class T> static bool IsNull(const T&)NOEXCEPT{
+		return false;
+	}
+
+	template <class T_Callable> void Set(T_Callable&& f){
+		typedef typename std::decay<T_Callable>::type T_Decayed;
+
+		static_assert(sizeof(T_Decayed) <= capacity, "InplaceFunction: the callable object does not fit into the inline storage, increase capacity");
+		static_assert(alignof(T_Decayed) <= alignof(T_Storage), "InplaceFunction: the callable object requires too strict alignment");
+		static_assert(std::is_nothrow_move_constructible<T_Decayed>::value, "InplaceFunction: the callable object should be nothrow move constructible");
+
+		//null function pointer or empty std::function would crash when called, keep the function empty instead
+		if(IsNull(static_cast<const T_Decayed&>(f))){
+			return;
+		}
+
+		new(&this->storage) T_Decayed(std::forward<T_Callable>(f));
+		this->ops = &OpsFor<T_Decayed>::ops;
+	}
+
+	void MoveFrom(InplaceFunction& f)NOEXCEPT{
+		if(f.ops){
+			f.ops->relocate(&this->storage, &f.storage);
+			this->ops = f.ops;
+			f.ops = nullptr;
+		}
+	}
+
+	void Reset()NOEXCEPT{
+		if(this->ops){
+			this->ops->destroy(&this->storage);
+			this->ops = nullptr;
+		}
+	}
+};
+
+
+
+template <class T_Res, class... T_Args, std::size_t capacity>
+template <class T_Callable>
+const typename InplaceFunction<T_Res(T_Args...), capacity>::Ops InplaceFunction<T_Res(T_Args...), capacity>::OpsFor<T_Callable>::ops = {
+	&InplaceFunction<T_Res(T_Args...), capacity>::OpsFor<T_Callable>::Invoke,
+	&InplaceFunction<T_Res(T_Args...), capacity>::OpsFor<T_Callable>::Relocate,
+	&InplaceFunction<T_Res(T_Args...), capacity>::OpsFor<T_Callable>::Destroy
+};
+
+
+
+template <class T_Signature, std::size_t capacity> bool operator==(const InplaceFunction<T_Signature, capacity>& f, std::nullptr_t)NOEXCEPT{
+	return !f;
+}
+
+template <class T_Signature, std::size_t capacity> bool operator==(std::nullptr_t, const InplaceFunction<T_Signature, capacity>& f)NOEXCEPT{
+	return !f;
+}
+
+template <class T_Signature, std::size_t capacity> bool operator!=(const InplaceFunction<T_Signature, capacity>& f, std::nullptr_t)NOEXCEPT{
+	return bool(f);
+}
+
+template <class T_Signature, std::size_t capacity> bool operator!=(std::nullptr_t, const InplaceFunction<T_Signature, capacity>& f)NOEXCEPT{
+	return bool(f);
+}
+
+
+
+}//~namespace
@@ -42,7 +42,7 @@ THE SOFTWARE. */
 #include "debug.hpp"
 #include "types.hpp"
 #include "Exc.hpp"
-#include "mt/SpinLock.hpp"
+#include "mt/AdaptiveSpinLock.hpp"
 #include "util.hpp"
 
 
@@ -134,7 +134,7 @@ template <size_t element_size, std::uint32_t num_elements_in_chunk = 32> class M
 	T_ChunkList fullChunks;
 	T_ChunkList chunks;
 	
-	ting::mt::SpinLock lock;
+	ting::mt::AdaptiveSpinLock lock;
 	
 public:
 	~MemoryPool()NOEXCEPT{
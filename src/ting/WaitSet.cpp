@@ -1,431 +1,1446 @@
-/* The MIT License:
-
-Copyright (c) 2009-2013 Ivan Gagis <igagis@gmail.com>
-
-Permission is hereby granted, free of charge, to any person obtaining a copy
-of this software and associated documentation files (the "Software"), to deal
-in the Software without restriction, including without limitation the rights
-to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-copies of the Software, and to permit persons to whom the Software is
-furnished to do so, subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in
-all copies or substantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
-THE SOFTWARE. */
-
-// Home page: http://ting.googlecode.com
-
-
-
-#include "WaitSet.hpp"
-
-
-#if M_OS == M_OS_MACOSX
-#	include <sys/time.h>
-#endif
-
-
-
-using namespace ting;
-
-
-
-#if M_OS == M_OS_MACOSX
-
-void WaitSet::AddFilter(Waitable& w, int16_t filter){
-	struct kevent e;
-
-	EV_SET(&e, w.GetHandle(), filter, EV_ADD | EV_RECEIPT, 0, 0, (void*)&w);
-
-	const timespec timeout = {0, 0}; //0 to make effect of polling, because passing NULL will cause to wait indefinitely.
-
-	int res = kevent(this->queue, &e, 1, &e, 1, &timeout);
-	if(res < 0){
-		throw Exc("WaitSet::Add(): AddFilter(): kevent() failed");
-	}
-	
-	ASSERT((e.flags & EV_ERROR) != 0) //EV_ERROR is always returned because of EV_RECEIPT, according to kevent() documentation.
-	if(e.data != 0){//data should be 0 if added successfully
-		TRACE(<< "WaitSet::Add(): e.data = " << e.data << std::endl)
-		throw Exc("WaitSet::Add(): AddFilter(): kevent() failed to add filter");
-	}
-}
-
-
-
-void WaitSet::RemoveFilter(Waitable& w, int16_t filter){
-	struct kevent e;
-
-	EV_SET(&e, w.GetHandle(), filter, EV_DELETE | EV_RECEIPT, 0, 0, 0);
-
-	const timespec timeout = {0, 0}; //0 to make effect of polling, because passing NULL will cause to wait indefinitely.
-
-	int res = kevent(this->queue, &e, 1, &e, 1, &timeout);
-	if(res < 0){
-		//ignore the failure
-		TRACE(<< "WaitSet::Remove(): RemoveFilter(): kevent() failed" << std::endl);
-	}
-	
-	ASSERT((e.flags & EV_ERROR) != 0) //EV_ERROR is always returned because of EV_RECEIPT, according to kevent() documentation.
-}
-
-#endif
-
-
-
-void WaitSet::Add(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor){
-//		TRACE(<< "WaitSet::Add(): enter" << std::endl)
-	ASSERT(!w.isAdded)
-
-#if M_OS == M_OS_WINDOWS
-	ASSERT(this->numWaitables <= this->handles.size())
-	if(this->numWaitables == this->handles.size()){
-		throw Exc("WaitSet::Add(): wait set is full");
-	}
-
-	//NOTE: Setting wait flags may throw an exception, so do that before
-	//adding object to the array and incrementing number of added objects.
-	w.SetWaitingEvents(flagsToWaitFor);
-
-	this->handles[this->numWaitables] = w.GetHandle();
-	this->waitables[this->numWaitables] = &w;
-
-#elif M_OS == M_OS_LINUX
-	epoll_event e;
-	e.data.fd = w.GetHandle();
-	e.data.ptr = &w;
-	e.events =
-			(std::uint32_t(flagsToWaitFor) & Waitable::READ ? (EPOLLIN | EPOLLPRI) : 0)
-			| (std::uint32_t(flagsToWaitFor) & Waitable::WRITE ? EPOLLOUT : 0)
-			| (EPOLLERR);
-	int res = epoll_ctl(
-			this->epollSet,
-			EPOLL_CTL_ADD,
-			w.GetHandle(),
-			&e
-		);
-	if(res < 0){
-		TRACE(<< "WaitSet::Add(): epoll_ctl() failed. If you are adding socket, please check that is is opened before adding to WaitSet." << std::endl)
-		throw Exc("WaitSet::Add(): epoll_ctl() failed");
-	}
-#elif M_OS == M_OS_MACOSX
-	ASSERT(this->NumWaitables() <= revents.size() / 2)
-	
-	if((std::uint32_t(flagsToWaitFor) & Waitable::READ) != 0){
-		this->AddFilter(w, EVFILT_READ);
-	}
-	if((std::uint32_t(flagsToWaitFor) & Waitable::WRITE) != 0){
-		this->AddFilter(w, EVFILT_WRITE);
-	}
-#else
-#	error "Unsupported OS"
-#endif
-
-	++this->numWaitables;
-
-	w.isAdded = true;
-//		TRACE(<< "WaitSet::Add(): exit" << std::endl)
-}
-
-
-
-void WaitSet::Change(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor){
-	ASSERT(w.isAdded)
-
-#if M_OS == M_OS_WINDOWS
-	//check if the Waitable object is added to this wait set
-	{
-		unsigned i;
-		for(i = 0; i < this->numWaitables; ++i){
-			if(this->waitables[i] == &w){
-				break;
-			}
-		}
-		ASSERT(i <= this->numWaitables)
-		if(i == this->numWaitables){
-			throw Exc("WaitSet::Change(): the Waitable is not added to this wait set");
-		}
-	}
-
-	//set new wait flags
-	w.SetWaitingEvents(flagsToWaitFor);
-
-#elif M_OS == M_OS_LINUX
-	epoll_event e;
-	e.data.fd = w.GetHandle();
-	e.data.ptr = &w;
-	e.events =
-			(std::uint32_t(flagsToWaitFor) & Waitable::READ ? (EPOLLIN | EPOLLPRI) : 0)
-			| (std::uint32_t(flagsToWaitFor) & Waitable::WRITE ? EPOLLOUT : 0)
-			| (EPOLLERR);
-	int res = epoll_ctl(
-			this->epollSet,
-			EPOLL_CTL_MOD,
-			w.GetHandle(),
-			&e
-		);
-	if(res < 0){
-		throw Exc("WaitSet::Change(): epoll_ctl() failed");
-	}
-#elif M_OS == M_OS_MACOSX
-	if((std::uint32_t(flagsToWaitFor) & Waitable::READ) != 0){
-		this->AddFilter(w, EVFILT_READ);
-	}else{
-		this->RemoveFilter(w, EVFILT_READ);
-	}
-	if((std::uint32_t(flagsToWaitFor) & Waitable::WRITE) != 0){
-		this->AddFilter(w, EVFILT_WRITE);
-	}else{
-		this->RemoveFilter(w, EVFILT_WRITE);
-	}
-#else
-#	error "Unsupported OS"
-#endif
-}
-
-
-
-void WaitSet::Remove(Waitable& w)NOEXCEPT{
-	ASSERT(w.isAdded)
-	
-	ASSERT(this->NumWaitables() != 0)
-
-#if M_OS == M_OS_WINDOWS
-	//remove object from array
-	{
-		unsigned i;
-		for(i = 0; i < this->numWaitables; ++i){
-			if(this->waitables[i] == &w){
-				break;
-			}
-		}
-		ASSERT(i <= this->numWaitables)
-		ASSERT_INFO(i != this->numWaitables, "WaitSet::Remove(): Waitable is not added to wait set")
-
-		unsigned numObjects = this->numWaitables - 1;//decrease number of objects before shifting the object handles in the array
-		//shift object handles in the array
-		for(; i < numObjects; ++i){
-			this->handles[i] = this->handles[i + 1];
-			this->waitables[i] = this->waitables[i + 1];
-		}
-	}
-
-	//clear wait flags (disassociate socket and Windows event)
-	w.SetWaitingEvents(0);
-
-#elif M_OS == M_OS_LINUX
-	int res = epoll_ctl(
-			this->epollSet,
-			EPOLL_CTL_DEL,
-			w.GetHandle(),
-			0
-		);
-	if(res < 0){
-		ASSERT_INFO(false, "WaitSet::Remove(): epoll_ctl failed, probably the Waitable was not added to the wait set")
-	}
-#elif M_OS == M_OS_MACOSX	
-	this->RemoveFilter(w, EVFILT_READ);
-	this->RemoveFilter(w, EVFILT_WRITE);
-#else
-#	error "Unsupported OS"
-#endif
-
-	--this->numWaitables;
-
-	w.isAdded = false;
-//		TRACE(<< "WaitSet::Remove(): completed successfuly" << std::endl)
-}
-
-
-
-unsigned WaitSet::Wait(bool waitInfinitly, std::uint32_t timeout, Buffer<Waitable*>* out_events){
-	if(this->numWaitables == 0){
-		throw Exc("WaitSet::Wait(): no Waitable objects were added to the WaitSet, can't perform Wait()");
-	}
-
-	if(out_events){
-		if(out_events->size() < this->numWaitables){
-			throw Exc("WaitSet::Wait(): passed out_events buffer is not large enough to hold all possible triggered objects");
-		}
-	}
-
-#if M_OS == M_OS_WINDOWS
-	DWORD waitTimeout = waitInfinitly ? (INFINITE) : DWORD(timeout);
-
-	DWORD res = WaitForMultipleObjectsEx(
-			this->numWaitables,
-			&*this->handles.begin(),
-			FALSE, //do not wait for all objects, wait for at least one
-			waitTimeout,
-			FALSE
-		);
-
-	ASSERT(res != WAIT_IO_COMPLETION)//it is impossible because we supplied FALSE as last parameter to WaitForMultipleObjectsEx()
-
-	//we are not expecting abandoned mutexes
-	ASSERT(res < WAIT_ABANDONED_0 || (WAIT_ABANDONED_0 + this->numWaitables) <= res)
-
-	if(res == WAIT_FAILED){
-		throw Exc("WaitSet::Wait(): WaitForMultipleObjectsEx() failed");
-	}
-
-	if(res == WAIT_TIMEOUT){
-		return 0;
-	}
-
-	ASSERT(WAIT_OBJECT_0 <= res && res < (WAIT_OBJECT_0 + this->numWaitables ))
-
-	//check for activities
-	unsigned numEvents = 0;
-	for(unsigned i = 0; i < this->numWaitables; ++i){
-		if(this->waitables[i]->CheckSignaled()){
-			if(out_events){
-				ASSERT(numEvents < out_events->size())
-				out_events->operator[](numEvents) = this->waitables[i];
-			}
-			++numEvents;
-		}else{
-			//NOTE: sometimes the event is reported as signaled, but no read/write events indicated.
-			//      Don't know why it happens.
-//			ASSERT_INFO(i != (res - WAIT_OBJECT_0), "i = " << i << " (res - WAIT_OBJECT_0) = " << (res - WAIT_OBJECT_0) << " waitflags = " << this->waitables[i]->readinessFlags)
-		}
-	}
-
-	//NOTE: Sometimes the event is reported as signaled, but no actual activity is there.
-	//      Don't know why.
-//		ASSERT(numEvents > 0)
-
-	return numEvents;
-
-#elif M_OS == M_OS_LINUX
-	ASSERT(int(timeout) >= 0)
-	int epollTimeout = waitInfinitly ? (-1) : int(timeout);
-
-//		TRACE(<< "going to epoll_wait() with timeout = " << epollTimeout << std::endl)
-
-	int res;
-
-	while(true){
-		res = epoll_wait(
-				this->epollSet,
-				&*this->revents.begin(),
-				this->revents.size(),
-				epollTimeout
-			);
-
-//			TRACE(<< "epoll_wait() returned " << res << std::endl)
-
-		if(res < 0){
-			//if interrupted by signal, try waiting again.
-			if(errno == EINTR){
-				continue;
-			}
-
-			std::stringstream ss;
-			ss << "WaitSet::Wait(): epoll_wait() failed, error code = " << errno << ": " << strerror(errno);
-			throw Exc(ss.str().c_str());
-		}
-		break;
-	};
-
-	ASSERT(unsigned(res) <= this->revents.size())
-
-	unsigned numEvents = 0;
-	for(
-			epoll_event *e = &*this->revents.begin();
-			e < &*this->revents.begin() + res;
-			++e
-		)
-	{
-		Waitable* w = static_cast<Waitable*>(e->data.ptr);
-		ASSERT(w)
-		if((e->events & EPOLLERR) != 0){
-			w->SetErrorFlag();
-		}
-		if((e->events & (EPOLLIN | EPOLLPRI)) != 0){
-			w->SetCanReadFlag();
-		}
-		if((e->events & EPOLLOUT) != 0){
-			w->SetCanWriteFlag();
-		}
-		ASSERT(w->CanRead() || w->CanWrite() || w->ErrorCondition())
-		if(out_events){
-			ASSERT(numEvents < out_events->size())
-			out_events->operator[](numEvents) = w;
-			++numEvents;
-		}
-	}
-
-	ASSERT(res >= 0)//NOTE: 'res' can be zero, if no events happened in the specified timeout
-	return unsigned(res);
-#elif M_OS == M_OS_MACOSX
-	struct timespec ts = {
-		timeout / 1000, //seconds
-		(timeout % 1000) * 1000000 //nanoseconds
-	};
-
-	//loop forever
-	for(;;){
-		int res = kevent(
-				this->queue,
-				0,
-				0,
-				&*this->revents.begin(),
-				this->revents.size(),
-				(waitInfinitly) ? 0 : &ts
-			);
-
-		if(res < 0){
-			if(errno == EINTR){
-				continue;
-			}
-			
-			std::stringstream ss;
-			ss << "WaitSet::Wait(): kevent() failed, error code = " << errno << ": " << strerror(errno);
-			throw Exc(ss.str().c_str());
-		}else if(res == 0){
-			return 0; // timeout
-		}else if(res > 0){
-			unsigned out_i = 0;// index to out_events
-			for(unsigned i = 0; i != unsigned(res); ++i){
-				struct kevent &e = this->revents[i];
-				Waitable *w = reinterpret_cast<Waitable*>(e.udata);
-				if(e.filter == EVFILT_WRITE){
-					w->SetCanWriteFlag();
-				}else if(e.filter == EVFILT_READ){
-					w->SetCanReadFlag();
-				}
-				
-				if((e.flags & EV_ERROR) != 0){
-					w->SetErrorFlag();
-				}
-				
-				if(out_events){
-					//check if Waitable is already added
-					unsigned k = 0;
-					for(; k != out_i; ++k){
-						if(out_events->operator[](k) == w){
-							break;
-						}
-					}
-					if(k == out_i){
-						ASSERT(out_i < out_events->size())
-						out_events->operator[](out_i) = w;
-						++out_i;
-					}
-				}
-			}
-			return unsigned(res);
-		}
-	}
-#else
-#	error "Unsupported OS"
-#endif
-}
+/* The MIT License:
+
+Copyright (c) 2009-2013 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+
+
+#include "WaitSet.hpp"
+#include "mt/CpuRelax.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+#if M_OS == M_OS_MACOSX
+#	include <sys/time.h>
+
+#elif M_OS == M_OS_LINUX
+#	include <poll.h>
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+#	include <unordered_map>
+
+#	if defined(__has_include)
+#		if __has_include(<linux/io_uring.h>)
+#			include <linux/io_uring.h>
+#		endif
+#	endif
+
+#	if defined(__NR_io_uring_setup) && defined(IORING_POLL_ADD_MULTI)
+#		define M_WAITSET_IO_URING 1
+#	else
+#		define M_WAITSET_IO_URING 0
+#	endif
+
+#	if defined(__NR_epoll_pwait2)
+#		include <atomic>
+#		include <signal.h>
+#		define M_WAITSET_EPOLL_PWAIT2 1
+#	else
+#		define M_WAITSET_EPOLL_PWAIT2 0
+#	endif
+#endif
+
+
+
+using namespace ting;
+
+
+
+namespace{
+
+//time left until the deadline, or zero if the deadline has passed
+std::chrono::nanoseconds TimeLeft(std::chrono::steady_clock::time_point deadline){
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if(deadline <= now){
+		return std::chrono::nanoseconds::zero();
+	}
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now);
+}
+
+#if M_OS == M_OS_LINUX || M_OS == M_OS_WINDOWS
+//time left until the deadline in milliseconds, rounded up, so that wait is never shorter than requested
+std::uint32_t MillisecondsLeft(std::chrono::steady_clock::time_point deadline){
+	std::int64_t ns = TimeLeft(deadline).count();
+	std::int64_t ms = (ns + 999999) / 1000000;
+	//limit to maximum positive 32 bit int value, this is what epoll_wait() accepts
+	return std::uint32_t(std::min(ms, std::int64_t(0x7fffffff)));
+}
+#endif
+
+#if M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX
+timespec TimespecLeft(std::chrono::steady_clock::time_point deadline){
+	std::int64_t ns = TimeLeft(deadline).count();
+	timespec ts;
+	ts.tv_sec = decltype(ts.tv_sec)(ns / 1000000000);
+	ts.tv_nsec = decltype(ts.tv_nsec)(ns % 1000000000);
+	return ts;
+}
+#endif
+
+#if M_OS == M_OS_LINUX && M_WAITSET_EPOLL_PWAIT2
+//set to false if the kernel turns out to not support epoll_pwait2()
+std::atomic<bool> epollPwait2Supported(true);
+#endif
+
+}//~namespace
+
+
+
+#if M_OS == M_OS_MACOSX
+
+void WaitSet::AddFilter(Waitable& w, int16_t filter){
+	struct kevent e;
+
+	std::uint16_t flags = EV_ADD | EV_RECEIPT;
+	if((w.triggerMode & Waitable::EDGE_TRIGGERED) != 0){
+		flags |= EV_CLEAR;
+	}
+	if((w.triggerMode & Waitable::ONE_SHOT) != 0){
+		flags |= EV_ONESHOT;
+	}
+
+	EV_SET(&e, w.GetHandle(), filter, flags, 0, 0, (void*)&w);
+
+	const timespec timeout = {0, 0}; //0 to make effect of polling, because passing NULL will cause to wait indefinitely.
+
+	int res = kevent(this->queue, &e, 1, &e, 1, &timeout);
+	if(res < 0){
+		throw Exc("WaitSet::Add(): AddFilter(): kevent() failed");
+	}
+	
+	ASSERT((e.flags & EV_ERROR) != 0) //EV_ERROR is always returned because of EV_RECEIPT, according to kevent() documentation.
+	if(e.data != 0){//data should be 0 if added successfully
+		TRACE(<< "WaitSet::Add(): e.data = " << e.data << std::endl)
+		throw Exc("WaitSet::Add(): AddFilter(): kevent() failed to add filter");
+	}
+}
+
+
+
+void WaitSet::RemoveFilter(Waitable& w, int16_t filter){
+	struct kevent e;
+
+	EV_SET(&e, w.GetHandle(), filter, EV_DELETE | EV_RECEIPT, 0, 0, 0);
+
+	const timespec timeout = {0, 0}; //0 to make effect of polling, because passing NULL will cause to wait indefinitely.
+
+	int res = kevent(this->queue, &e, 1, &e, 1, &timeout);
+	if(res < 0){
+		//ignore the failure
+		TRACE(<< "WaitSet::Remove(): RemoveFilter(): kevent() failed" << std::endl);
+	}
+	
+	ASSERT((e.flags & EV_ERROR) != 0) //EV_ERROR is always returned because of EV_RECEIPT, according to kevent() documentation.
+}
+
+#elif M_OS == M_OS_LINUX
+
+std::uint32_t WaitSet::EpollEvents(std::uint32_t flagsToWaitFor, std::uint32_t triggerMode)NOEXCEPT{
+	return (flagsToWaitFor & Waitable::READ ? (EPOLLIN | EPOLLPRI) : 0)
+			| (flagsToWaitFor & Waitable::WRITE ? EPOLLOUT : 0)
+			| (triggerMode & Waitable::EDGE_TRIGGERED ? EPOLLET : 0)
+			| (triggerMode & Waitable::ONE_SHOT ? EPOLLONESHOT : 0)
+			| (EPOLLERR);
+}
+
+
+
+#if M_WAITSET_IO_URING
+
+namespace{
+
+//user data of the poll removal requests, completions of those are ignored
+const std::uint64_t DRemoveRequestUserData = std::uint64_t(-1);
+
+//poll events mask in SQE is stored as two swapped 16 bit halves on big endian machines
+std::uint32_t PollEventsToSQE(std::uint32_t events)NOEXCEPT{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	return (events << 16) | (events >> 16);
+#else
+	return events;
+#endif
+}
+
+}//~namespace
+
+
+
+struct WaitSet::IoUring{
+	int fd;
+
+	void* sqRingPtr = MAP_FAILED;
+	std::size_t sqRingSize;
+	void* cqRingPtr = MAP_FAILED;
+	std::size_t cqRingSize;
+	io_uring_sqe* sqes = reinterpret_cast<io_uring_sqe*>(MAP_FAILED);
+	std::size_t sqesSize;
+
+	unsigned* sqHead;
+	unsigned* sqTail;
+	unsigned sqMask;
+	unsigned sqEntries;
+	unsigned* sqArray;
+
+	unsigned* cqHead;
+	unsigned* cqTail;
+	unsigned cqMask;
+	io_uring_cqe* cqes;
+
+	//Each added Waitable occupies a slot. The poll requests are identified by slot index
+	//and slot generation, generation is changed each time the poll request is cancelled,
+	//this allows ignoring the completions of the cancelled requests which arrive later.
+	struct Slot{
+		Waitable* w = nullptr;
+		std::uint32_t generation = 0;
+		std::uint32_t pollEvents = 0;
+		bool armed = false;//poll request is submitted and not completed yet
+		bool multishot = false;//armed poll request is a multishot one
+		std::uint64_t lastReportedWait = 0;//to avoid reporting the Waitable twice in one batch
+	};
+
+	std::vector<Slot> slots;
+	std::vector<std::uint32_t> freeSlots;
+	std::unordered_map<Waitable*, std::uint32_t> slotIndices;
+
+	std::uint64_t waitCounter = 0;
+
+	//cleared when the kernel refuses the first multishot poll request
+	bool multishotSupported = true;
+
+	IoUring(unsigned entries);
+
+	~IoUring()NOEXCEPT{
+		this->Release();
+	}
+
+	void Release()NOEXCEPT{
+		if(this->sqes != MAP_FAILED){
+			munmap(this->sqes, this->sqesSize);
+		}
+		if(this->cqRingPtr != MAP_FAILED && this->cqRingPtr != this->sqRingPtr){
+			munmap(this->cqRingPtr, this->cqRingSize);
+		}
+		if(this->sqRingPtr != MAP_FAILED){
+			munmap(this->sqRingPtr, this->sqRingSize);
+		}
+		close(this->fd);
+	}
+
+	static std::uint64_t UserData(std::uint32_t index, std::uint32_t generation)NOEXCEPT{
+		return (std::uint64_t(generation) << 32) | std::uint64_t(index);
+	}
+
+	unsigned NumToSubmit()const NOEXCEPT{
+		return *this->sqTail - __atomic_load_n(this->sqHead, __ATOMIC_ACQUIRE);
+	}
+
+	bool CompletionQueueEmpty()const NOEXCEPT{
+		return *this->cqHead == __atomic_load_n(this->cqTail, __ATOMIC_ACQUIRE);
+	}
+
+	int Enter(unsigned minComplete, unsigned flags, void* arg, std::size_t argSize)NOEXCEPT{
+		return int(syscall(__NR_io_uring_enter, this->fd, this->NumToSubmit(), minComplete, flags, arg, argSize));
+	}
+
+	//submit the queued requests to the kernel without waiting for completions
+	void Submit(){
+		while(this->NumToSubmit() != 0){
+			int res = this->Enter(0, 0, 0, 0);
+			if(res > 0){
+				continue;
+			}
+			if(res == 0 || errno == EAGAIN || errno == EBUSY){
+				//the kernel is out of resources or the completion queue has overflown,
+				//the requests will be submitted by the next Wait() call
+				return;
+			}
+			if(errno == EINTR){
+				continue;
+			}
+			std::stringstream ss;
+			ss << "WaitSet: io_uring_enter() failed, error code = " << errno << ": " << strerror(errno);
+			throw Exc(ss.str().c_str());
+		}
+	}
+
+	io_uring_sqe& GetSQE(){
+		if(this->NumToSubmit() == this->sqEntries){
+			//submission queue is full, submit the requests to the kernel to free it up
+			this->Submit();
+			if(this->NumToSubmit() == this->sqEntries){
+				throw Exc("WaitSet: io_uring submission queue is full");
+			}
+		}
+
+		unsigned tail = *this->sqTail;
+		unsigned index = tail & this->sqMask;
+		this->sqArray[index] = index;
+		io_uring_sqe& sqe = this->sqes[index];
+		memset(&sqe, 0, sizeof(sqe));
+		__atomic_store_n(this->sqTail, tail + 1, __ATOMIC_RELEASE);
+		return sqe;
+	}
+
+	void Arm(std::uint32_t index){
+		Slot& s = this->slots[index];
+		ASSERT(s.w)
+		ASSERT(!s.armed)
+
+		io_uring_sqe& sqe = this->GetSQE();
+		sqe.opcode = IORING_OP_POLL_ADD;
+		sqe.fd = s.w->GetHandle();
+		sqe.poll32_events = PollEventsToSQE(s.pollEvents);
+		s.multishot = this->multishotSupported
+				&& (s.w->triggerMode & Waitable::EDGE_TRIGGERED) != 0
+				&& (s.w->triggerMode & Waitable::ONE_SHOT) == 0;
+		if(s.multishot){
+			//multishot poll requests are edge-triggered
+			sqe.len = IORING_POLL_ADD_MULTI;
+		}
+		sqe.user_data = UserData(index, s.generation);
+		s.armed = true;
+	}
+
+	void Disarm(std::uint32_t index)NOEXCEPT{
+		Slot& s = this->slots[index];
+		if(s.armed){
+			try{
+				io_uring_sqe& sqe = this->GetSQE();
+				sqe.opcode = IORING_OP_POLL_REMOVE;
+				sqe.addr = UserData(index, s.generation);
+				sqe.user_data = DRemoveRequestUserData;
+			}catch(std::exception& e){
+				ASSERT_INFO(false, "WaitSet: failed to cancel io_uring poll request: " << e.what())
+			}
+			s.armed = false;
+		}
+		++s.generation;
+	}
+
+	static std::uint32_t PollEvents(std::uint32_t flagsToWaitFor)NOEXCEPT{
+		return (flagsToWaitFor & Waitable::READ ? (POLLIN | POLLPRI) : 0)
+				| (flagsToWaitFor & Waitable::WRITE ? POLLOUT : 0)
+				| POLLERR;
+	}
+
+	void Add(Waitable& w, std::uint32_t flagsToWaitFor){
+		ASSERT(this->slotIndices.find(&w) == this->slotIndices.end())
+
+		if(this->freeSlots.size() == 0){
+			this->slots.push_back(Slot());
+			//reserve space for all slots, so that freeing the slot never throws
+			this->freeSlots.reserve(this->slots.size());
+			this->freeSlots.push_back(std::uint32_t(this->slots.size() - 1));
+		}
+		std::uint32_t index = this->freeSlots.back();
+
+		this->slotIndices[&w] = index;
+
+		Slot& s = this->slots[index];
+		s.w = &w;
+		s.pollEvents = PollEvents(flagsToWaitFor);
+		try{
+			this->Arm(index);
+		}catch(...){
+			s.w = nullptr;
+			this->slotIndices.erase(&w);
+			throw;
+		}
+		this->freeSlots.pop_back();
+	}
+
+	void Change(Waitable& w, std::uint32_t flagsToWaitFor){
+		auto i = this->slotIndices.find(&w);
+		if(i == this->slotIndices.end()){
+			throw Exc("WaitSet::Change(): the Waitable is not added to this wait set");
+		}
+		this->Disarm(i->second);
+		this->slots[i->second].pollEvents = PollEvents(flagsToWaitFor);
+		this->Arm(i->second);
+
+		//submit the cancellation right away, otherwise the kernel keeps the old poll request,
+		//and so the reference to the file, until the next Wait() call
+		this->Submit();
+	}
+
+	void Remove(Waitable& w)NOEXCEPT{
+		auto i = this->slotIndices.find(&w);
+		if(i == this->slotIndices.end()){
+			ASSERT_INFO(false, "WaitSet::Remove(): the Waitable is not added to this wait set")
+			return;
+		}
+		this->Disarm(i->second);
+		this->slots[i->second].w = nullptr;
+		this->freeSlots.push_back(i->second);//does not throw, the capacity is reserved when the slot is created
+		this->slotIndices.erase(i);
+
+		//Submit the cancellation right away, otherwise the kernel keeps the poll request, and so
+		//the reference to the file, until the next Wait() call. Until then the file would stay
+		//open even if the Waitable is closed after removal.
+		try{
+			this->Submit();
+		}catch(std::exception& e){
+			TRACE(<< "WaitSet::Remove(): failed to submit io_uring poll cancellation: " << e.what() << std::endl)
+		}
+	}
+
+	unsigned Wait(bool waitInfinitly, std::chrono::steady_clock::time_point deadline, Buffer<Waitable*>* out_events, unsigned maxEvents);
+};
+
+
+
+WaitSet::IoUring::IoUring(unsigned entries){
+	io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = entries * 4;//each added Waitable has one outstanding poll request which can complete
+
+	this->fd = int(syscall(__NR_io_uring_setup, entries, &p));
+	if(this->fd < 0){
+		std::stringstream ss;
+		ss << "WaitSet: io_uring_setup() failed, error code = " << errno << ": " << strerror(errno);
+		throw Exc(ss.str().c_str());
+	}
+
+	//Extended arguments to io_uring_enter() are needed for timeouts, those appeared in Linux 5.11.
+	//Support of multishot poll requests is not advertised by the kernel, it is detected when the
+	//first one is refused, see Wait().
+	const std::uint32_t requiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+	if((p.features & requiredFeatures) != requiredFeatures){
+		close(this->fd);
+		throw Exc("WaitSet: io_uring in this kernel does not support required features");
+	}
+
+	//check that poll requests are supported, those can be disabled in the kernel
+	{
+		const unsigned numOps = 256;
+		std::vector<std::uint8_t> buf(sizeof(io_uring_probe) + numOps * sizeof(io_uring_probe_op));
+		io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(&buf[0]);
+		if(syscall(__NR_io_uring_register, this->fd, IORING_REGISTER_PROBE, probe, numOps) < 0){
+			close(this->fd);
+			throw Exc("WaitSet: probing io_uring operations failed");
+		}
+		for(unsigned op : {unsigned(IORING_OP_POLL_ADD), unsigned(IORING_OP_POLL_REMOVE)}){
+			if(op >= probe->ops_len || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0){
+				close(this->fd);
+				throw Exc("WaitSet: io_uring in this kernel does not support poll requests");
+			}
+		}
+	}
+
+	this->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	this->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+	//with IORING_FEAT_SINGLE_MMAP both rings are mapped by one mmap() call
+	this->sqRingSize = this->cqRingSize = std::max(this->sqRingSize, this->cqRingSize);
+	this->sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+
+	this->sqRingPtr = mmap(0, this->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->fd, IORING_OFF_SQ_RING);
+	this->cqRingPtr = this->sqRingPtr;
+	if(this->sqRingPtr != MAP_FAILED){
+		this->sqes = reinterpret_cast<io_uring_sqe*>(
+				mmap(0, this->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->fd, IORING_OFF_SQES)
+			);
+	}
+	if(this->sqRingPtr == MAP_FAILED || this->sqes == MAP_FAILED){
+		this->Release();
+		throw Exc("WaitSet: mapping io_uring rings to memory failed");
+	}
+
+	std::uint8_t* sq = reinterpret_cast<std::uint8_t*>(this->sqRingPtr);
+	this->sqHead = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+	this->sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+	this->sqMask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+	this->sqEntries = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_entries);
+	this->sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+
+	std::uint8_t* cq = reinterpret_cast<std::uint8_t*>(this->cqRingPtr);
+	this->cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+	this->cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+	this->cqMask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+	this->cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+}
+
+
+
+unsigned WaitSet::IoUring::Wait(bool waitInfinitly, std::chrono::steady_clock::time_point deadline, Buffer<Waitable*>* out_events, unsigned maxEvents){
+	for(;;){
+		++this->waitCounter;
+
+		//The completions which did not fit into the previous batch are still in the completion
+		//queue, no need to wait if there are some. Pending re-arming requests are submitted
+		//by the same system call which waits for completions.
+		bool needToWait = this->CompletionQueueEmpty();
+
+		//Completions are posted to the shared memory ring by the kernel asynchronously, so
+		//non-blocking poll does not need a system call if there is nothing to submit.
+		if(needToWait && !waitInfinitly && this->NumToSubmit() == 0 && TimeLeft(deadline) == std::chrono::nanoseconds::zero()){
+			needToWait = false;
+		}
+
+		if(needToWait || this->NumToSubmit() != 0){
+			for(;;){
+				int res;
+				if(waitInfinitly || !needToWait){
+					res = this->Enter(needToWait ? 1 : 0, IORING_ENTER_GETEVENTS, 0, 0);
+				}else{
+					//recalculate the timeout each time, so that waiting interrupted by signal does not extend the deadline
+					timespec left = TimespecLeft(deadline);
+					__kernel_timespec ts;
+					ts.tv_sec = left.tv_sec;
+					ts.tv_nsec = left.tv_nsec;
+
+					io_uring_getevents_arg arg;
+					memset(&arg, 0, sizeof(arg));
+					arg.ts = std::uint64_t(reinterpret_cast<std::size_t>(&ts));
+
+					res = this->Enter(1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+				}
+
+				if(res < 0){
+					//if interrupted by signal, try waiting again.
+					if(errno == EINTR){
+						continue;
+					}
+					//ETIME means timeout, EBUSY means the kernel has completions it was not
+					//able to put to the completion queue, in both cases just go on to reaping
+					//the completion queue.
+					if(errno != ETIME && errno != EBUSY && errno != EAGAIN){
+						std::stringstream ss;
+						ss << "WaitSet::Wait(): io_uring_enter() failed, error code = " << errno << ": " << strerror(errno);
+						throw Exc(ss.str().c_str());
+					}
+				}
+				break;
+			}
+		}
+
+		unsigned numEvents = 0;
+
+		unsigned head = *this->cqHead;
+		unsigned tail = __atomic_load_n(this->cqTail, __ATOMIC_ACQUIRE);
+		for(; head != tail && numEvents != maxEvents; ++head){
+			const io_uring_cqe& cqe = this->cqes[head & this->cqMask];
+
+			if(cqe.user_data == DRemoveRequestUserData){
+				continue;
+			}
+
+			std::uint32_t index = std::uint32_t(cqe.user_data);
+			std::uint32_t generation = std::uint32_t(cqe.user_data >> 32);
+			ASSERT(index < this->slots.size())
+
+			Slot& s = this->slots[index];
+			if(!s.w || s.generation != generation){
+				//completion of the cancelled request
+				continue;
+			}
+
+			if((cqe.flags & IORING_CQE_F_MORE) == 0){
+				s.armed = false;
+			}
+
+			Waitable* w = s.w;
+
+			if(cqe.res == -ECANCELED || (cqe.res == -EINVAL && s.multishot)){
+				//The poll request was terminated by the kernel without any events, e.g. a multishot
+				//request is cancelled when the completion queue overflows, or the kernel does not
+				//support multishot poll requests. The Waitable is not errored, just re-arm it.
+				ASSERT(!s.armed)
+				if(cqe.res == -EINVAL){
+					TRACE(<< "WaitSet: multishot io_uring poll requests are not supported, using one-shot ones" << std::endl)
+					this->multishotSupported = false;
+				}
+				this->Arm(index);
+				continue;
+			}
+
+			if(cqe.res < 0){
+				w->SetErrorFlag();
+			}else{
+				std::uint32_t events = std::uint32_t(cqe.res);
+				if((events & POLLERR) != 0){
+					w->SetErrorFlag();
+				}
+				if((events & (POLLIN | POLLPRI)) != 0){
+					w->SetCanReadFlag();
+				}
+				if((events & POLLOUT) != 0){
+					w->SetCanWriteFlag();
+				}
+				if((events & POLLHUP) != 0){
+					//hang up, reading will return end of file if waiting for reading, otherwise it is an error
+					if((s.pollEvents & POLLIN) != 0){
+						w->SetCanReadFlag();
+					}else{
+						w->SetErrorFlag();
+					}
+				}
+			}
+
+			//one-shot poll requests are re-armed in level-triggered mode, the request will be submitted
+			//to the kernel on next Wait() call, so if the Waitable is still ready by that time it will
+			//be reported again
+			if(!s.armed && (w->triggerMode & Waitable::ONE_SHOT) == 0){
+				this->Arm(index);
+			}
+
+			if(s.lastReportedWait != this->waitCounter){
+				s.lastReportedWait = this->waitCounter;
+				if(out_events){
+					ASSERT(numEvents < out_events->size())
+					out_events->operator[](numEvents) = w;
+				}
+				++numEvents;
+			}
+		}
+		__atomic_store_n(this->cqHead, head, __ATOMIC_RELEASE);
+
+		//If only completions of cancelled requests have arrived, wait again until the deadline.
+		if(numEvents != 0 || (!waitInfinitly && std::chrono::steady_clock::now() >= deadline)){
+			return numEvents;
+		}
+	}
+}
+
+
+#else
+
+//io_uring is not available at build time, WaitSet always falls back to epoll
+struct WaitSet::IoUring{
+	IoUring(unsigned){
+		throw Exc("WaitSet: io_uring support is not compiled in");
+	}
+
+	void Add(Waitable&, std::uint32_t){}
+	void Change(Waitable&, std::uint32_t){}
+	void Remove(Waitable&)NOEXCEPT{}
+
+	unsigned Wait(bool, std::chrono::steady_clock::time_point, Buffer<Waitable*>*, unsigned){
+		return 0;
+	}
+};
+
+#endif //~M_WAITSET_IO_URING
+
+#endif
+
+
+
+struct WaitSet::StatsData : public WaitSet::Stats{
+	//used to get triggered Waitables when Wait() is called without output buffer
+	std::vector<Waitable*> buffer;
+};
+
+
+
+WaitSet::StatsData* WaitSet::CreateStats(){
+#ifdef M_ENABLE_WAITSET_STATS
+	return new StatsData();
+#else
+	return nullptr;
+#endif
+}
+
+
+
+const WaitSet::Stats* WaitSet::GetStats()const NOEXCEPT{
+	return this->stats.get();
+}
+
+
+
+void WaitSet::ResetStats()NOEXCEPT{
+	if(!this->stats){
+		return;
+	}
+	static_cast<Stats&>(*this->stats) = Stats();
+}
+
+
+
+WaitSet::WaitSet(unsigned batchSize, EBackend backend)
+#if M_OS == M_OS_WINDOWS
+		: batchSize(batchSize),
+		stats(CreateStats())
+{
+	ASSERT(batchSize > 0)
+	if(backend != NATIVE){
+		TRACE(<< "WaitSet::WaitSet(): only native backend is available on Windows" << std::endl)
+	}
+}
+#elif M_OS == M_OS_LINUX
+		: revents(batchSize),
+		stats(CreateStats())
+{
+	ASSERT(int(batchSize) > 0)
+
+	if(backend == IO_URING){
+		//submission queue should be able to hold re-arming requests for the whole batch
+		unsigned entries = 32;
+		while(entries < batchSize * 2 && entries < 32768){
+			entries <<= 1;
+		}
+		try{
+			this->ioUring = std::unique_ptr<IoUring>(new IoUring(entries));
+			return;
+		}catch(Exc& e){
+			TRACE(<< "WaitSet::WaitSet(): io_uring is not available, falling back to epoll: " << e.What() << std::endl)
+		}
+	}
+
+	this->epollSet = epoll_create(int(batchSize));//the size argument is ignored by modern kernels, but should be positive
+	if(this->epollSet < 0){
+		throw Exc("WaitSet::WaitSet(): epoll_create() failed");
+	}
+}
+#elif M_OS == M_OS_MACOSX
+		: revents(batchSize),
+		stats(CreateStats())
+{
+	ASSERT(batchSize > 0)
+	if(backend != NATIVE){
+		TRACE(<< "WaitSet::WaitSet(): only native backend is available on Mac OS X" << std::endl)
+	}
+	this->queue = kqueue();
+	if(this->queue == -1){
+		throw Exc("WaitSet::WaitSet(): kqueue creation failed");
+	}
+}
+#else
+#	error "Unsupported OS"
+#endif
+
+
+
+WaitSet::~WaitSet()NOEXCEPT{
+	//assert the wait set is empty
+	ASSERT_INFO(this->numWaitables == 0, "attempt to destroy WaitSet containig Waitables")
+#if M_OS == M_OS_WINDOWS
+	//do nothing
+#elif M_OS == M_OS_LINUX
+	if(this->epollSet >= 0){
+		close(this->epollSet);
+	}
+#elif M_OS == M_OS_MACOSX
+	close(this->queue);
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+void WaitSet::Add(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor, Waitable::ETriggerMode triggerMode){
+//		TRACE(<< "WaitSet::Add(): enter" << std::endl)
+	ASSERT(!w.isAdded)
+
+#if M_OS == M_OS_WINDOWS
+	if(triggerMode != Waitable::LEVEL_TRIGGERED){
+		throw Exc("WaitSet::Add(): only level-triggered mode is supported on Windows");
+	}
+#endif
+
+	w.triggerMode = triggerMode;
+
+	this->AddToSystem(w, flagsToWaitFor);
+
+	w.flagsToWaitFor = flagsToWaitFor;
+
+	++this->numWaitables;
+
+	w.isAdded = true;
+//		TRACE(<< "WaitSet::Add(): exit" << std::endl)
+}
+
+
+
+void WaitSet::AddDeferred(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor, Waitable::ETriggerMode triggerMode){
+	ASSERT(!w.isAdded)
+	ASSERT(w.deferredIndex == Waitable::DNotDeferred)
+
+#if M_OS == M_OS_WINDOWS
+	if(triggerMode != Waitable::LEVEL_TRIGGERED){
+		throw Exc("WaitSet::AddDeferred(): only level-triggered mode is supported on Windows");
+	}
+#endif
+
+	this->deferred.push_back(&w);
+	w.deferredIndex = unsigned(this->deferred.size() - 1);
+	w.deferredAdd = true;
+	w.deferredFlags = flagsToWaitFor;
+
+	w.triggerMode = triggerMode;
+
+	++this->numWaitables;
+
+	w.isAdded = true;
+}
+
+
+
+void WaitSet::AddToSystem(Waitable& w, std::uint32_t flagsToWaitFor){
+#ifdef M_ENABLE_WAITSET_STATS
+	++this->stats->numSystemAdds;
+#endif
+
+#if M_OS == M_OS_WINDOWS
+	ASSERT(this->handles.size() == this->waitables.size())
+	if(this->handles.size() == MAXIMUM_WAIT_OBJECTS){
+		throw Exc("WaitSet::Add(): wait set is full, Windows does not allow waiting for more than MAXIMUM_WAIT_OBJECTS objects");
+	}
+
+	//reserve space in advance, so that adding to the arrays below does not throw
+	this->handles.reserve(this->handles.size() + 1);
+	this->waitables.reserve(this->waitables.size() + 1);
+
+	//NOTE: Setting wait flags may throw an exception, so do that before
+	//adding object to the array and incrementing number of added objects.
+	w.SetWaitingEvents(flagsToWaitFor);
+
+	this->handles.push_back(w.GetHandle());
+	this->waitables.push_back(&w);
+
+#elif M_OS == M_OS_LINUX
+	if(this->ioUring){
+		this->ioUring->Add(w, flagsToWaitFor);
+		return;
+	}
+
+	epoll_event e;
+	e.data.fd = w.GetHandle();
+	e.data.ptr = &w;
+	e.events = EpollEvents(flagsToWaitFor, w.triggerMode);
+	int res = epoll_ctl(
+			this->epollSet,
+			EPOLL_CTL_ADD,
+			w.GetHandle(),
+			&e
+		);
+	if(res < 0){
+		TRACE(<< "WaitSet::Add(): epoll_ctl() failed. If you are adding socket, please check that is is opened before adding to WaitSet." << std::endl)
+		throw Exc("WaitSet::Add(): epoll_ctl() failed");
+	}
+#elif M_OS == M_OS_MACOSX
+	if((flagsToWaitFor & Waitable::READ) != 0){
+		this->AddFilter(w, EVFILT_READ);
+	}
+	if((flagsToWaitFor & Waitable::WRITE) != 0){
+		this->AddFilter(w, EVFILT_WRITE);
+	}
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+void WaitSet::Change(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor){
+	ASSERT(w.isAdded)
+
+	if(w.deferredIndex != Waitable::DNotDeferred){
+		//apply deferred changes right away, with the new flags
+		w.deferredFlags = flagsToWaitFor;
+		this->ApplyDeferred(w);
+		return;
+	}
+
+	//one-shot Waitables are re-armed by Change() even if flags are the same
+	if(flagsToWaitFor == w.flagsToWaitFor && (w.triggerMode & Waitable::ONE_SHOT) == 0){
+		return;
+	}
+
+	this->ChangeInSystem(w, flagsToWaitFor);
+
+	w.flagsToWaitFor = flagsToWaitFor;
+}
+
+
+
+void WaitSet::ChangeDeferred(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor){
+	ASSERT(w.isAdded)
+
+	if(w.deferredIndex == Waitable::DNotDeferred){
+		if(flagsToWaitFor == w.flagsToWaitFor && (w.triggerMode & Waitable::ONE_SHOT) == 0){
+			return;
+		}
+		this->deferred.push_back(&w);
+		w.deferredIndex = unsigned(this->deferred.size() - 1);
+	}
+
+	w.deferredFlags = flagsToWaitFor;
+}
+
+
+
+void WaitSet::ApplyDeferred(Waitable& w){
+	ASSERT(w.deferredIndex < this->deferred.size())
+	ASSERT(this->deferred[w.deferredIndex] == &w)
+
+	//in case of error the change remains deferred, so the Waitable stays in consistent state
+	if(w.deferredAdd){
+		try{
+			this->AddToSystem(w, w.deferredFlags);
+		}catch(Exc& e){
+			throw Exc(e.What(), &w);
+		}
+		w.deferredAdd = false;
+	}else if(w.deferredFlags != w.flagsToWaitFor || (w.triggerMode & Waitable::ONE_SHOT) != 0){
+		try{
+			this->ChangeInSystem(w, w.deferredFlags);
+		}catch(Exc& e){
+			throw Exc(e.What(), &w);
+		}
+	}
+	//else flags were changed back to the original ones
+
+	this->deferred[w.deferredIndex] = nullptr;
+	w.deferredIndex = Waitable::DNotDeferred;
+
+	w.flagsToWaitFor = w.deferredFlags;
+}
+
+
+
+void WaitSet::ApplyDeferredChanges(){
+	for(unsigned i = 0; i != this->deferred.size(); ++i){
+		if(Waitable* w = this->deferred[i]){
+			this->ApplyDeferred(*w);
+		}
+	}
+	this->deferred.clear();
+}
+
+
+
+void WaitSet::ChangeInSystem(Waitable& w, std::uint32_t flagsToWaitFor){
+#ifdef M_ENABLE_WAITSET_STATS
+	++this->stats->numSystemChanges;
+#endif
+
+#if M_OS == M_OS_WINDOWS
+	//check if the Waitable object is added to this wait set
+	if(std::find(this->waitables.begin(), this->waitables.end(), &w) == this->waitables.end()){
+		throw Exc("WaitSet::Change(): the Waitable is not added to this wait set");
+	}
+
+	//set new wait flags
+	w.SetWaitingEvents(flagsToWaitFor);
+
+#elif M_OS == M_OS_LINUX
+	if(this->ioUring){
+		this->ioUring->Change(w, flagsToWaitFor);
+		return;
+	}
+
+	epoll_event e;
+	e.data.fd = w.GetHandle();
+	e.data.ptr = &w;
+	e.events = EpollEvents(flagsToWaitFor, w.triggerMode);
+	int res = epoll_ctl(
+			this->epollSet,
+			EPOLL_CTL_MOD,
+			w.GetHandle(),
+			&e
+		);
+	if(res < 0){
+		throw Exc("WaitSet::Change(): epoll_ctl() failed");
+	}
+#elif M_OS == M_OS_MACOSX
+	if((flagsToWaitFor & Waitable::READ) != 0){
+		this->AddFilter(w, EVFILT_READ);
+	}else{
+		this->RemoveFilter(w, EVFILT_READ);
+	}
+	if((flagsToWaitFor & Waitable::WRITE) != 0){
+		this->AddFilter(w, EVFILT_WRITE);
+	}else{
+		this->RemoveFilter(w, EVFILT_WRITE);
+	}
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+void WaitSet::Remove(Waitable& w)NOEXCEPT{
+	ASSERT(w.isAdded)
+	
+	ASSERT(this->NumWaitables() != 0)
+
+	if(w.deferredIndex != Waitable::DNotDeferred){
+		//cancel deferred changes
+		ASSERT(this->deferred[w.deferredIndex] == &w)
+		this->deferred[w.deferredIndex] = nullptr;
+		w.deferredIndex = Waitable::DNotDeferred;
+	}
+
+	if(w.deferredAdd){
+		//the Waitable was not actually added to the system wait set yet
+		w.deferredAdd = false;
+	}else{
+		this->RemoveFromSystem(w);
+	}
+
+	--this->numWaitables;
+
+#ifdef M_ENABLE_WAITSET_STATS
+	this->stats->numTriggered.erase(&w);
+#endif
+
+	//do not call handler of the removed Waitable if it is still pending dispatch
+	for(unsigned i = this->dispatchIndex; i < this->numToDispatch; ++i){
+		if(this->dispatchList[i] == &w){
+			this->dispatchList[i] = nullptr;
+		}
+	}
+
+	w.isAdded = false;
+//		TRACE(<< "WaitSet::Remove(): completed successfuly" << std::endl)
+}
+
+
+
+void WaitSet::RemoveFromSystem(Waitable& w)NOEXCEPT{
+#ifdef M_ENABLE_WAITSET_STATS
+	++this->stats->numSystemRemoves;
+#endif
+
+#if M_OS == M_OS_WINDOWS
+	//remove object from array
+	{
+		unsigned i;
+		for(i = 0; i < this->waitables.size(); ++i){
+			if(this->waitables[i] == &w){
+				break;
+			}
+		}
+		ASSERT(i <= this->waitables.size())
+		ASSERT_INFO(i != this->waitables.size(), "WaitSet::Remove(): Waitable is not added to wait set")
+
+		this->handles.erase(this->handles.begin() + i);
+		this->waitables.erase(this->waitables.begin() + i);
+
+		if(this->nextToCheck > i){
+			--this->nextToCheck;
+		}
+	}
+
+	//clear wait flags (disassociate socket and Windows event)
+	w.SetWaitingEvents(0);
+
+#elif M_OS == M_OS_LINUX
+	if(this->ioUring){
+		this->ioUring->Remove(w);
+	}else{
+		int res = epoll_ctl(
+				this->epollSet,
+				EPOLL_CTL_DEL,
+				w.GetHandle(),
+				0
+			);
+		if(res < 0){
+			ASSERT_INFO(false, "WaitSet::Remove(): epoll_ctl failed, probably the Waitable was not added to the wait set")
+		}
+	}
+#elif M_OS == M_OS_MACOSX	
+	this->RemoveFilter(w, EVFILT_READ);
+	this->RemoveFilter(w, EVFILT_WRITE);
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+unsigned WaitSet::Wait(bool waitInfinitly, T_TimePoint deadline, Buffer<Waitable*>* out_events){
+#ifdef M_ENABLE_WAITSET_STATS
+	T_TimePoint waitStart = std::chrono::steady_clock::now();
+#endif
+
+	this->ApplyDeferredChanges();
+
+	if(this->numWaitables == 0){
+		throw Exc("WaitSet::Wait(): no Waitable objects were added to the WaitSet, can't perform Wait()");
+	}
+
+	//maximum number of triggered objects to report
+	unsigned maxEvents = this->BatchSize();
+	if(out_events){
+		if(out_events->size() == 0){
+			throw Exc("WaitSet::Wait(): passed out_events buffer is empty");
+		}
+		maxEvents = std::min(maxEvents, unsigned(out_events->size()));
+	}
+
+#ifdef M_ENABLE_WAITSET_STATS
+	//need to know which Waitables have triggered to count triggerings of each Waitable
+	Buffer<Waitable*> statsBuffer;
+	if(!out_events){
+		this->stats->buffer.resize(maxEvents);
+		statsBuffer = Buffer<Waitable*>(this->stats->buffer);
+		out_events = &statsBuffer;
+	}
+#endif
+
+	unsigned numEvents = 0;
+
+	if(this->busyPollMaxBudget != std::chrono::nanoseconds::zero() && (waitInfinitly || deadline > std::chrono::steady_clock::now())){
+		numEvents = this->BusyPoll(waitInfinitly, deadline, out_events, maxEvents);
+	}
+
+	if(numEvents == 0){
+		numEvents = this->WaitInSystem(waitInfinitly, deadline, out_events, maxEvents);
+	}
+
+#ifdef M_ENABLE_WAITSET_STATS
+	this->UpdateStats(waitStart, out_events, numEvents);
+#endif
+
+	return numEvents;
+}
+
+
+
+#ifdef M_ENABLE_WAITSET_STATS
+void WaitSet::UpdateStats(T_TimePoint waitStart, Buffer<Waitable*>* out_events, unsigned numEvents){
+	ASSERT(out_events)
+
+	std::uint64_t us = std::uint64_t(
+			std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStart).count()
+		);
+
+	StatsData& s = *this->stats;
+
+	++s.numWaits;
+	s.numEvents += numEvents;
+	++s.waitDurations[Stats::HistogramBucket(us)];
+	++s.eventsPerWait[Stats::HistogramBucket(numEvents)];
+
+	for(unsigned i = 0; i != numEvents; ++i){
+		++s.numTriggered[out_events->operator[](i)];
+	}
+}
+#endif
+
+
+
+namespace{
+//number of pause instructions between non-blocking polls while busy polling
+const unsigned DNumPausesPerPoll = 16;
+
+//the spin budget does not go lower than the maximum budget divided by this value
+const unsigned DMinBusyPollBudgetDivisor = 64;
+}
+
+
+
+unsigned WaitSet::BusyPoll(bool waitInfinitly, T_TimePoint deadline, Buffer<Waitable*>* out_events, unsigned maxEvents){
+	T_TimePoint spinDeadline = std::chrono::steady_clock::now() + this->busyPollBudget;
+	bool spinUntilDeadline = !waitInfinitly && deadline <= spinDeadline;
+	if(spinUntilDeadline){
+		spinDeadline = deadline;
+	}
+
+	for(;;){
+		++this->busyPollCounters.numPolls;
+
+		//deadline in the past makes the non-blocking poll
+		unsigned numEvents = this->WaitInSystem(false, T_TimePoint(), out_events, maxEvents);
+		if(numEvents != 0){
+			++this->busyPollCounters.numSpinHits;
+			this->busyPollBudget = std::min(this->busyPollBudget * 2, this->busyPollMaxBudget);
+			return numEvents;
+		}
+
+		if(std::chrono::steady_clock::now() >= spinDeadline){
+			break;
+		}
+
+		for(unsigned i = 0; i != DNumPausesPerPoll; ++i){
+			mt::CpuRelax();
+		}
+	}
+
+	//If timeout has been hit while spinning then it is not a miss of the spin budget.
+	if(!spinUntilDeadline){
+		++this->busyPollCounters.numBlocks;
+		//The budget should not go down to zero, because it would never grow back from zero,
+		//this can happen when the maximum budget is less than DMinBusyPollBudgetDivisor nanoseconds.
+		this->busyPollBudget = std::max({
+				this->busyPollBudget / 2,
+				this->busyPollMaxBudget / DMinBusyPollBudgetDivisor,
+				std::chrono::nanoseconds(1)
+			});
+	}
+	return 0;
+}
+
+
+
+unsigned WaitSet::WaitInSystem(bool waitInfinitly, T_TimePoint deadline, Buffer<Waitable*>* out_events, unsigned maxEvents){
+#ifdef M_ENABLE_WAITSET_STATS
+	++this->stats->numSystemWaits;
+#endif
+
+#if M_OS == M_OS_WINDOWS
+	ASSERT(this->numWaitables == this->handles.size())//all deferred changes are applied
+
+	DWORD waitTimeout = waitInfinitly ? (INFINITE) : DWORD(MillisecondsLeft(deadline));
+
+	DWORD res = WaitForMultipleObjectsEx(
+			this->numWaitables,
+			&*this->handles.begin(),
+			FALSE, //do not wait for all objects, wait for at least one
+			waitTimeout,
+			FALSE
+		);
+
+	ASSERT(res != WAIT_IO_COMPLETION)//it is impossible because we supplied FALSE as last parameter to WaitForMultipleObjectsEx()
+
+	//we are not expecting abandoned mutexes
+	ASSERT(res < WAIT_ABANDONED_0 || (WAIT_ABANDONED_0 + this->numWaitables) <= res)
+
+	if(res == WAIT_FAILED){
+		throw Exc("WaitSet::Wait(): WaitForMultipleObjectsEx() failed");
+	}
+
+	if(res == WAIT_TIMEOUT){
+		return 0;
+	}
+
+	ASSERT(WAIT_OBJECT_0 <= res && res < (WAIT_OBJECT_0 + this->numWaitables ))
+
+	//Check for activities. Start from the object next to the last reported one, so that
+	//if there are more triggered objects than fit into the batch, every object gets reported eventually.
+	if(this->nextToCheck >= this->numWaitables){
+		this->nextToCheck = 0;
+	}
+	unsigned numEvents = 0;
+	for(unsigned j = 0; j != this->numWaitables && numEvents != maxEvents; ++j){
+		unsigned i = (this->nextToCheck + j) % this->numWaitables;
+		if(this->waitables[i]->CheckSignaled()){
+			if(out_events){
+				ASSERT(numEvents < out_events->size())
+				out_events->operator[](numEvents) = this->waitables[i];
+			}
+			++numEvents;
+			this->nextToCheck = i + 1;
+		}else{
+			//NOTE: sometimes the event is reported as signaled, but no read/write events indicated.
+			//      Don't know why it happens.
+//			ASSERT_INFO(i != (res - WAIT_OBJECT_0), "i = " << i << " (res - WAIT_OBJECT_0) = " << (res - WAIT_OBJECT_0) << " waitflags = " << this->waitables[i]->readinessFlags)
+		}
+	}
+
+	//NOTE: Sometimes the event is reported as signaled, but no actual activity is there.
+	//      Don't know why.
+//		ASSERT(numEvents > 0)
+
+	return numEvents;
+
+#elif M_OS == M_OS_LINUX
+	if(this->ioUring){
+		return this->ioUring->Wait(waitInfinitly, deadline, out_events, maxEvents);
+	}
+
+	int res;
+
+	//NOTE: if more events are ready than 'maxEvents', the rest of them stay in the
+	//      epoll ready list and are returned by the next epoll_wait() call, this is also
+	//      true for edge-triggered and one-shot Waitables.
+	while(true){
+#	if M_WAITSET_EPOLL_PWAIT2
+		//epoll_pwait2() takes timeout with nanosecond resolution, the timeout is recalculated
+		//on each iteration, so that wait interrupted by signal does not extend the deadline
+		if(!waitInfinitly && epollPwait2Supported.load(std::memory_order_relaxed)){
+			timespec ts = TimespecLeft(deadline);
+			res = int(syscall(
+					__NR_epoll_pwait2,
+					this->epollSet,
+					&*this->revents.begin(),
+					int(maxEvents),
+					&ts,
+					nullptr,
+					_NSIG / 8
+				));
+			if(res < 0 && errno == ENOSYS){
+				epollPwait2Supported.store(false, std::memory_order_relaxed);
+				continue;
+			}
+		}else
+#	endif
+		{
+			res = epoll_wait(
+					this->epollSet,
+					&*this->revents.begin(),
+					int(maxEvents),
+					waitInfinitly ? (-1) : int(MillisecondsLeft(deadline))
+				);
+		}
+
+		if(res < 0){
+			//if interrupted by signal, continue waiting for the rest of the timeout.
+			if(errno == EINTR){
+				continue;
+			}
+
+			std::stringstream ss;
+			ss << "WaitSet::Wait(): epoll_wait() failed, error code = " << errno << ": " << strerror(errno);
+			throw Exc(ss.str().c_str());
+		}
+		break;
+	};
+
+	ASSERT(unsigned(res) <= maxEvents)
+
+	unsigned numEvents = 0;
+	for(
+			epoll_event *e = &*this->revents.begin();
+			e < &*this->revents.begin() + res;
+			++e
+		)
+	{
+		Waitable* w = static_cast<Waitable*>(e->data.ptr);
+		ASSERT(w)
+		if((e->events & EPOLLERR) != 0){
+			w->SetErrorFlag();
+		}
+		if((e->events & (EPOLLIN | EPOLLPRI)) != 0){
+			w->SetCanReadFlag();
+		}
+		if((e->events & EPOLLOUT) != 0){
+			w->SetCanWriteFlag();
+		}
+		ASSERT(w->CanRead() || w->CanWrite() || w->ErrorCondition())
+		if(out_events){
+			ASSERT(numEvents < out_events->size())
+			out_events->operator[](numEvents) = w;
+			++numEvents;
+		}
+	}
+
+	ASSERT(res >= 0)//NOTE: 'res' can be zero, if no events happened in the specified timeout
+	return unsigned(res);
+#elif M_OS == M_OS_MACOSX
+	//NOTE: if more events are ready than 'maxEvents', the rest of them stay in the
+	//      kqueue and are returned by the next kevent() call.
+	//      One Waitable can produce up to two events (read and write), so number of
+	//      reported Waitables never exceeds the number of events.
+
+	//loop forever
+	for(;;){
+		//recalculate the timeout each time, so that wait interrupted by signal does not extend the deadline
+		struct timespec ts = TimespecLeft(deadline);
+
+		int res = kevent(
+				this->queue,
+				0,
+				0,
+				&*this->revents.begin(),
+				int(maxEvents),
+				(waitInfinitly) ? 0 : &ts
+			);
+
+		if(res < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			
+			std::stringstream ss;
+			ss << "WaitSet::Wait(): kevent() failed, error code = " << errno << ": " << strerror(errno);
+			throw Exc(ss.str().c_str());
+		}else if(res == 0){
+			return 0; // timeout
+		}else if(res > 0){
+			unsigned out_i = 0;// index to out_events
+			for(unsigned i = 0; i != unsigned(res); ++i){
+				struct kevent &e = this->revents[i];
+				Waitable *w = reinterpret_cast<Waitable*>(e.udata);
+				if(e.filter == EVFILT_WRITE){
+					w->SetCanWriteFlag();
+				}else if(e.filter == EVFILT_READ){
+					w->SetCanReadFlag();
+				}
+				
+				if((e.flags & EV_ERROR) != 0){
+					w->SetErrorFlag();
+				}
+				
+				if(out_events){
+					//check if Waitable is already added
+					unsigned k = 0;
+					for(; k != out_i; ++k){
+						if(out_events->operator[](k) == w){
+							break;
+						}
+					}
+					if(k == out_i){
+						ASSERT(out_i < out_events->size())
+						out_events->operator[](out_i) = w;
+						++out_i;
+					}
+				}
+			}
+			return out_events ? out_i : unsigned(res);
+		}
+	}
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+unsigned WaitSet::Dispatch(bool waitInfinitly, T_TimePoint deadline){
+	ASSERT_INFO(this->numToDispatch == 0, "WaitSet::Dispatch(): recursive call to Dispatch() from readiness handler is not allowed")
+
+	if(this->dispatchList.size() != this->BatchSize()){
+		this->dispatchList.resize(this->BatchSize());
+	}
+
+	Buffer<Waitable*> buf(this->dispatchList);
+	unsigned numTriggered = this->Wait(waitInfinitly, deadline, &buf);
+
+	this->numToDispatch = numTriggered;
+
+	try{
+		for(this->dispatchIndex = 0; this->dispatchIndex != this->numToDispatch; ++this->dispatchIndex){
+			Waitable* w = this->dispatchList[this->dispatchIndex];
+			if(!w || !w->readinessHandler){
+				continue;
+			}
+			w->readinessHandler(*w, Waitable::EReadinessFlags(w->readinessFlags));
+		}
+	}catch(...){
+		this->numToDispatch = 0;
+		this->dispatchIndex = 0;
+		throw;
+	}
+
+	this->numToDispatch = 0;
+	this->dispatchIndex = 0;
+
+	return numTriggered;
+}
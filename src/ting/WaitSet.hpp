@@ -1,494 +1,993 @@
-/* The MIT License:
-
-Copyright (c) 2009-2014 Ivan Gagis <igagis@gmail.com>
-
-Permission is hereby granted, free of charge, to any person obtaining a copy
-of this software and associated documentation files (the "Software"), to deal
-in the Software without restriction, including without limitation the rights
-to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-copies of the Software, and to permit persons to whom the Software is
-furnished to do so, subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in
-all copies or substantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
-THE SOFTWARE. */
-
-// Home page: http://ting.googlecode.com
-
-
-
-/**
- * @file WaitSet.hpp
- * @author Ivan Gagis <igagis@gmail.com>
- * @author Jose Luis Hidalgo <joseluis.hidalgo@gmail.com> - Mac OS X port
- * @brief Wait set.
- */
-
-#pragma once
-
-#include <vector>
-#include <sstream>
-#include <cerrno>
-#include <cstdint>
-
-#include "config.hpp"
-#include "types.hpp"
-#include "debug.hpp"
-#include "Exc.hpp"
-#include "Buffer.hpp"
-
-
-#if M_OS == M_OS_WINDOWS
-#	include "windows.hpp"
-
-#elif M_OS == M_OS_LINUX
-#	include <sys/epoll.h>
-#	include <unistd.h>
-
-#elif M_OS == M_OS_MACOSX
-#	include <sys/types.h>
-#	include <sys/event.h>
-#	include <unistd.h>
-
-#else
-#	error "Unsupported OS"
-#endif
-
-
-//disable warning about throw specification is ignored.
-#if M_COMPILER == M_COMPILER_MSVC
-#	pragma warning(push) //push warnings state
-#	pragma warning( disable : 4290)
-#endif
-
-
-
-namespace ting{
-
-
-
-/**
- * @brief Base class for objects which can be waited for.
- * Base class for objects which can be used in wait sets.
- */
-class Waitable{
-	friend class WaitSet;
-
-	bool isAdded = false;
-
-	void* userData = nullptr;
-
-public:
-	enum EReadinessFlags{
-		NOT_READY = 0,      // bin: 00000000
-		READ = 1,           // bin: 00000001
-		WRITE = 2,          // bin: 00000010
-		READ_AND_WRITE = 3, // bin: 00000011
-		ERROR_CONDITION = 4 // bin: 00000100
-	};
-
-protected:
-	std::uint32_t readinessFlags = NOT_READY;
-
-	Waitable() = default;
-
-
-
-	bool IsAdded()const NOEXCEPT{
-		return this->isAdded;
-	}
-
-
-
-
-	Waitable(const Waitable& w) = delete;
-	
-	Waitable(Waitable&& w);
-
-
-	Waitable& operator=(Waitable&& w);
-
-
-
-	void SetCanReadFlag()NOEXCEPT{
-		this->readinessFlags |= READ;
-	}
-
-	void ClearCanReadFlag()NOEXCEPT{
-		this->readinessFlags &= (~READ);
-	}
-
-	void SetCanWriteFlag()NOEXCEPT{
-		this->readinessFlags |= WRITE;
-	}
-
-	void ClearCanWriteFlag()NOEXCEPT{
-		this->readinessFlags &= (~WRITE);
-	}
-
-	void SetErrorFlag()NOEXCEPT{
-		this->readinessFlags |= ERROR_CONDITION;
-	}
-
-	void ClearErrorFlag()NOEXCEPT{
-		this->readinessFlags &= (~ERROR_CONDITION);
-	}
-
-	void ClearAllReadinessFlags()NOEXCEPT{
-		this->readinessFlags = NOT_READY;
-	}
-
-public:
-	virtual ~Waitable()NOEXCEPT{
-		ASSERT(!this->isAdded)
-	}
-
-	/**
-	 * @brief Check if "Can read" flag is set.
-	 * @return true if Waitable is ready for reading.
-	 */
-	bool CanRead()const NOEXCEPT{
-		return (this->readinessFlags & READ) != 0;
-	}
-
-	/**
-	 * @brief Check if "Can write" flag is set.
-	 * @return true if Waitable is ready for writing.
-	 */
-	bool CanWrite()const NOEXCEPT{
-		return (this->readinessFlags & WRITE) != 0;
-	}
-
-	/**
-	 * @brief Check if "error" flag is set.
-	 * @return true if Waitable is in error state.
-	 */
-	bool ErrorCondition()const NOEXCEPT{
-		return (this->readinessFlags & ERROR_CONDITION) != 0;
-	}
-
-	/**
-	 * @brief Get user data associated with this Waitable.
-	 * Returns the pointer to the user data which was previously set by SetUserData() method.
-	 * @return pointer to the user data.
-	 * @return zero pointer if the user data was not set.
-	 */
-	void* GetUserData()NOEXCEPT{
-		return this->userData;
-	}
-
-	/**
-	 * @brief Set user data.
-	 * See description of GetUserData() for more details.
-	 * @param data - pointer to the user data to associate with this Waitable.
-	 */
-	void SetUserData(void* data)NOEXCEPT{
-		this->userData = data;
-	}
-
-#if M_OS == M_OS_WINDOWS
-protected:
-	virtual HANDLE GetHandle() = 0;
-
-	virtual void SetWaitingEvents(std::uint32_t /*flagsToWaitFor*/){}
-
-	//returns true if signaled
-	virtual bool CheckSignaled(){
-		return this->readinessFlags != 0;
-	}
-
-#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
-public:
-	/**
-	 * @brief Get Unix file descriptor.
-	 * This method is specific to Unix-based operating systems, like Linux, MAC OS X, Unix.
-	 * This method is made public in order to ease embedding Waitables to existing epoll() sets.
-	 * Use this method only if you know what you are doing!
-	 */
-	virtual int GetHandle() = 0;
-
-#else
-#	error "Unsupported OS"
-#endif
-
-};//~class Waitable
-
-
-
-
-
-/**
- * @brief Set of Waitable objects to wait for.
- */
-class WaitSet{
-	const unsigned size;
-	unsigned numWaitables = 0;//number of Waitables added
-
-#if M_OS == M_OS_WINDOWS
-	std::vector<Waitable*> waitables;
-	std::vector<HANDLE> handles; //used to pass array of HANDLEs to WaitForMultipleObjectsEx()
-
-#elif M_OS == M_OS_LINUX
-	int epollSet;
-
-	std::vector<epoll_event> revents;//used for getting the result from epoll_wait()
-#elif M_OS == M_OS_MACOSX
-	int queue; // kqueue
-	
-	std::vector<struct kevent> revents;//used for getting the result
-#else
-#	error "Unsupported OS"
-#endif
-
-public:
-
-	/**
-	 * @brief WaitSet related exception class.
-	 */
-	class Exc : public ting::Exc{
-	public:
-		Exc(const std::string& message = std::string()) :
-				ting::Exc(message)
-		{}
-	};
-	
-	/**
-	 * @brief Constructor.
-	 * @param maxSize - maximum number of Waitable objects can be added to this wait set.
-	 */
-	WaitSet(unsigned maxSize) :
-			size(maxSize)
-#if M_OS == M_OS_WINDOWS
-			,waitables(maxSize)
-			,handles(maxSize)
-	{
-		ASSERT_INFO(maxSize <= MAXIMUM_WAIT_OBJECTS, "maxSize should be less than " << MAXIMUM_WAIT_OBJECTS)
-		if(maxSize > MAXIMUM_WAIT_OBJECTS){
-			throw Exc("WaitSet::WaitSet(): requested WaitSet size is too big");
-		}
-	}
-
-#elif M_OS == M_OS_LINUX
-			,revents(maxSize)
-	{
-		ASSERT(int(maxSize) > 0)
-		this->epollSet = epoll_create(int(maxSize));
-		if(this->epollSet < 0){
-			throw Exc("WaitSet::WaitSet(): epoll_create() failed");
-		}
-	}
-#elif M_OS == M_OS_MACOSX
-			,revents(maxSize * 2)
-	{
-		this->queue = kqueue();
-		if(this->queue == -1){
-			throw Exc("WaitSet::WaitSet(): kqueue creation failed");
-		}
-	}
-#else
-#	error "Unsupported OS"
-#endif
-
-
-
-	/**
-	 * @brief Destructor.
-	 * Note, that destructor will check if the wait set is empty. If it is not, then an assert
-	 * will be triggered.
-	 * It is user's responsibility to remove any waitable objects from the waitset
-	 * before the wait set object is destroyed.
-	 */
-	~WaitSet()NOEXCEPT{
-		//assert the wait set is empty
-		ASSERT_INFO(this->numWaitables == 0, "attempt to destroy WaitSet containig Waitables")
-#if M_OS == M_OS_WINDOWS
-		//do nothing
-#elif M_OS == M_OS_LINUX
-		close(this->epollSet);
-#elif M_OS == M_OS_MACOSX
-		close(this->queue);
-#else
-#	error "Unsupported OS"
-#endif
-	}
-
-
-
-	/**
-	 * @brief Get maximum size of the wait set.
-	 * @return maximum number of Waitables this WaitSet can hold.
-	 */
-	unsigned Size()const NOEXCEPT{
-		return this->size;
-	}
-
-	/**
-	 * @brief Get number of Waitables already added to this WaitSet.
-	 * @return number of Waitables added to this WaitSet.
-	 */
-	unsigned NumWaitables()const NOEXCEPT{
-		return this->numWaitables;
-	}
-
-
-	/**
-	 * @brief Add Waitable object to the wait set.
-	 * @param w - Waitable object to add to the WaitSet.
-	 * @param flagsToWaitFor - determine events waiting for which we are interested.
-	 * @throw ting::WaitSet::Exc - in case the wait set is full or other error occurs.
-	 */
-	void Add(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor);
-
-
-
-	/**
-	 * @brief Change wait flags for a given Waitable.
-	 * Changes wait flags for a given waitable, which is in this WaitSet.
-	 * @param w - Waitable for which the changing of wait flags is needed.
-	 * @param flagsToWaitFor - new wait flags to be set for the given Waitable.
-	 * @throw ting::WaitSet::Exc - in case the given Waitable object is not added to this wait set or
-	 *                    other error occurs.
-	 */
-	void Change(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor);
-
-
-
-	/**
-	 * @brief Remove Waitable from wait set.
-	 * @param w - Waitable object to be removed from the WaitSet.
-	 * @throw ting::WaitSet::Exc - in case the given Waitable is not added to this wait set or
-	 *                    other error occurs.
-	 */
-	void Remove(Waitable& w)NOEXCEPT;
-
-
-
-	/**
-	 * @brief wait for event.
-	 * This function blocks calling thread execution until one of the Waitable objects in the WaitSet
-	 * triggers. Upon return from the function, pointers to triggered objects are placed in the
-	 * 'out_events' buffer and the return value from the function indicates number of these objects
-	 * which have triggered.
-	 * Note, that it does not change the readiness state of non-triggered objects.
-	 * @param out_events - pointer to buffer where to put pointers to triggered Waitable objects.
-	 *                     The buffer will not be initialized to 0's by this function.
-	 *                     The buffer shall be large enough to hold maxmimum number of Waitables
-	 *                     this WaitSet can hold.
-	 *                     It is valid to pass 0 pointer, in that case this argument will not be used.
-	 * @return number of objects triggered.
-	 *         NOTE: for some reason, on Windows it can return 0 objects triggered.
-	 * @throw ting::WaitSet::Exc - in case of errors.
-	 */
-	unsigned Wait(Buffer<Waitable*> out_events){
-		return this->Wait(true, 0, &out_events);
-	}
-	
-	/**
-	 * @brief wait for event.
-	 * Same as Wait(const Buffer<Waitable*>& out_events) but does not return out_events.
-     * @return number of objects triggered.
-     */
-	unsigned Wait(){
-		return this->Wait(true, 0, 0);
-	}
-
-
-	/**
-	 * @brief wait for event with timeout.
-	 * The same as Wait() function, but takes wait timeout as parameter. Thus,
-	 * this function will wait for any event or timeout. Note, that it guarantees that
-	 * it will wait AT LEAST for specified number of milliseconds, or more. This is because of
-	 * implementation for linux, if wait is interrupted by signal it will start waiting again,
-	 * and so on.
-	 * @param timeout - maximum time in milliseconds to wait for event.
-	 * @param out_events - buffer where to put pointers to triggered Waitable objects.
-	 *                     The buffer size must be equal or greater than the number of waitables
-	 *                     currently added to the wait set.
-	 * @return number of objects triggered. If 0 then timeout was hit.
-	 *         NOTE: for some reason, on Windows it can return 0 before timeout was hit.
-	 * @throw ting::WaitSet::Exc - in case of errors.
-	 */
-	unsigned WaitWithTimeout(std::uint32_t timeout, Buffer<Waitable*> out_events){
-		return this->Wait(false, timeout, &out_events);
-	}
-	
-	/**
-	 * @brief wait for event with timeout.
-	 * Same as WaitWithTimeout(std::uint32_t timeout, const Buffer<Waitable*>& out_events) but
-	 * does not return out_events.
-     * @param timeout - maximum time in milliseconds to wait for event.
-     * @return number of objects triggered. If 0 then timeout was hit.
-	 *         NOTE: for some reason, on Windows it can return 0 before timeout was hit.
-     */
-	unsigned WaitWithTimeout(std::uint32_t timeout){
-		return this->Wait(false, timeout, 0);
-	}
-
-
-
-private:
-	unsigned Wait(bool waitInfinitly, std::uint32_t timeout, Buffer<Waitable*>* out_events);
-	
-	
-#if M_OS == M_OS_MACOSX
-	void AddFilter(Waitable& w, int16_t filter);
-	void RemoveFilter(Waitable& w, int16_t filter);
-#endif
-
-};//~class WaitSet
-
-
-
-inline Waitable::Waitable(Waitable&& w) :
-		isAdded(false),
-		userData(w.userData),
-		readinessFlags(NOT_READY)//Treat copied Waitable as NOT_READY
-{
-	//cannot move from waitable which is added to WaitSet
-	if(w.isAdded){
-		throw ting::WaitSet::Exc("Waitable::Waitable(move): cannot move Waitable which is added to WaitSet");
-	}
-
-	const_cast<Waitable&>(w).ClearAllReadinessFlags();
-	const_cast<Waitable&>(w).userData = 0;
-}
-
-
-
-inline Waitable& Waitable::operator=(Waitable&& w){
-	if(this->isAdded){
-		throw ting::WaitSet::Exc("Waitable::Waitable(move): cannot move while this Waitable is added to WaitSet");
-	}
-
-	if(w.isAdded){
-		throw ting::WaitSet::Exc("Waitable::Waitable(move): cannot move Waitable which is added to WaitSet");
-	}
-
-	ASSERT(!this->isAdded)
-
-	//Clear readiness flags on moving.
-	//Will need to wait for readiness again, using the WaitSet.
-	this->ClearAllReadinessFlags();
-	const_cast<Waitable&>(w).ClearAllReadinessFlags();
-
-	this->userData = w.userData;
-	const_cast<Waitable&>(w).userData = 0;
-	return *this;
-}
-
-
-
-}//~namespace ting
-
-
-//restore warnings state
-#if M_COMPILER == M_COMPILER_MSVC
-#	pragma warning(pop) //pop warnings state
-#endif
+/* The MIT License:
+
+Copyright (c) 2009-2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+
+
+/**
+ * @file WaitSet.hpp
+ * @author Ivan Gagis <igagis@gmail.com>
+ * @author Jose Luis Hidalgo <joseluis.hidalgo@gmail.com> - Mac OS X port
+ * @brief Wait set.
+ */
+
+#pragma once
+
+#include <vector>
+#include <sstream>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <array>
+#include <memory>
+#include <chrono>
+#include <unordered_map>
+
+#include "config.hpp"
+#include "types.hpp"
+#include "debug.hpp"
+#include "Exc.hpp"
+#include "Buffer.hpp"
+
+
+#if M_OS == M_OS_WINDOWS
+#	include "windows.hpp"
+
+#elif M_OS == M_OS_LINUX
+#	include <sys/epoll.h>
+#	include <unistd.h>
+
+#elif M_OS == M_OS_MACOSX
+#	include <sys/types.h>
+#	include <sys/event.h>
+#	include <unistd.h>
+
+#else
+#	error "Unsupported OS"
+#endif
+
+
+//disable warning about throw specification is ignored.
+#if M_COMPILER == M_COMPILER_MSVC
+#	pragma warning(push) //push warnings state
+#	pragma warning( disable : 4290)
+#endif
+
+
+
+namespace ting{
+
+namespace mt{
+class EventLoopPool;
+}
+
+
+
+/**
+ * @brief Base class for objects which can be waited for.
+ * Base class for objects which can be used in wait sets.
+ */
+class Waitable{
+	friend class WaitSet;
+	friend class ting::mt::EventLoopPool;
+
+	bool isAdded = false;
+
+	void* userData = nullptr;
+
+public:
+	enum EReadinessFlags{
+		NOT_READY = 0,      // bin: 00000000
+		READ = 1,           // bin: 00000001
+		WRITE = 2,          // bin: 00000010
+		READ_AND_WRITE = 3, // bin: 00000011
+		ERROR_CONDITION = 4 // bin: 00000100
+	};
+
+	/**
+	 * @brief Modes of reporting the readiness by WaitSet.
+	 * LEVEL_TRIGGERED is the default mode, in this mode the WaitSet::Wait() reports the
+	 * Waitable every time it is called while the Waitable is ready.
+	 * In EDGE_TRIGGERED mode the Waitable is reported only once when it becomes ready,
+	 * so the user is expected to read/write until the operation would block
+	 * (until the corresponding readiness flag is cleared) before waiting for it again.
+	 * In ONE_SHOT mode the Waitable is reported only once, after that the WaitSet stops
+	 * reporting it until WaitSet::Change() is called for this Waitable to re-arm it.
+	 * ONE_SHOT can be combined with EDGE_TRIGGERED.
+	 * NOTE: on Windows only LEVEL_TRIGGERED mode is supported.
+	 */
+	enum ETriggerMode{
+		LEVEL_TRIGGERED = 0,        // bin: 00000000
+		EDGE_TRIGGERED = 1,         // bin: 00000001
+		ONE_SHOT = 2,               // bin: 00000010
+		EDGE_TRIGGERED_ONE_SHOT = 3 // bin: 00000011
+	};
+
+	/**
+	 * @brief Readiness handler.
+	 * Called by WaitSet::Dispatch() when the Waitable has triggered.
+	 * The first argument is the triggered Waitable, the second one is its current readiness flags.
+	 */
+	typedef std::function<void(Waitable&, EReadinessFlags)> T_ReadinessHandler;
+
+private:
+	std::uint32_t triggerMode = LEVEL_TRIGGERED;
+
+	//flags the Waitable is currently waited for with in the WaitSet
+	std::uint32_t flagsToWaitFor = NOT_READY;
+
+	//Deferred registration in WaitSet, see WaitSet::AddDeferred() and WaitSet::ChangeDeferred().
+	static const unsigned DNotDeferred = unsigned(-1);
+	unsigned deferredIndex = DNotDeferred;//index in the list of deferred changes of the WaitSet
+	std::uint32_t deferredFlags = NOT_READY;
+	bool deferredAdd = false;
+
+	T_ReadinessHandler readinessHandler;
+
+protected:
+	std::uint32_t readinessFlags = NOT_READY;
+
+	Waitable() = default;
+
+
+
+	bool IsAdded()const NOEXCEPT{
+		return this->isAdded;
+	}
+
+	/**
+	 * @brief Check if the Waitable is added to WaitSet in edge-triggered mode.
+	 * In edge-triggered mode the readiness flags should only be cleared when the
+	 * corresponding operation would block, because WaitSet will not report the
+	 * Waitable again until new readiness edge happens.
+	 * @return true if the Waitable is added to WaitSet in edge-triggered mode.
+	 */
+	bool IsEdgeTriggered()const NOEXCEPT{
+		return this->isAdded && (this->triggerMode & EDGE_TRIGGERED) != 0;
+	}
+
+
+
+
+	Waitable(const Waitable& w) = delete;
+	
+	Waitable(Waitable&& w);
+
+
+	Waitable& operator=(Waitable&& w);
+
+
+
+	void SetCanReadFlag()NOEXCEPT{
+		this->readinessFlags |= READ;
+	}
+
+	void ClearCanReadFlag()NOEXCEPT{
+		this->readinessFlags &= (~READ);
+	}
+
+	void SetCanWriteFlag()NOEXCEPT{
+		this->readinessFlags |= WRITE;
+	}
+
+	void ClearCanWriteFlag()NOEXCEPT{
+		this->readinessFlags &= (~WRITE);
+	}
+
+	void SetErrorFlag()NOEXCEPT{
+		this->readinessFlags |= ERROR_CONDITION;
+	}
+
+	void ClearErrorFlag()NOEXCEPT{
+		this->readinessFlags &= (~ERROR_CONDITION);
+	}
+
+	void ClearAllReadinessFlags()NOEXCEPT{
+		this->readinessFlags = NOT_READY;
+	}
+
+public:
+	virtual ~Waitable()NOEXCEPT{
+		ASSERT(!this->isAdded)
+	}
+
+	/**
+	 * @brief Check if "Can read" flag is set.
+	 * @return true if Waitable is ready for reading.
+	 */
+	bool CanRead()const NOEXCEPT{
+		return (this->readinessFlags & READ) != 0;
+	}
+
+	/**
+	 * @brief Check if "Can write" flag is set.
+	 * @return true if Waitable is ready for writing.
+	 */
+	bool CanWrite()const NOEXCEPT{
+		return (this->readinessFlags & WRITE) != 0;
+	}
+
+	/**
+	 * @brief Check if "error" flag is set.
+	 * @return true if Waitable is in error state.
+	 */
+	bool ErrorCondition()const NOEXCEPT{
+		return (this->readinessFlags & ERROR_CONDITION) != 0;
+	}
+
+	/**
+	 * @brief Get user data associated with this Waitable.
+	 * Returns the pointer to the user data which was previously set by SetUserData() method.
+	 * @return pointer to the user data.
+	 * @return zero pointer if the user data was not set.
+	 */
+	void* GetUserData()NOEXCEPT{
+		return this->userData;
+	}
+
+	/**
+	 * @brief Set user data.
+	 * See description of GetUserData() for more details.
+	 * @param data - pointer to the user data to associate with this Waitable.
+	 */
+	void SetUserData(void* data)NOEXCEPT{
+		this->userData = data;
+	}
+
+	/**
+	 * @brief Set readiness handler.
+	 * The handler is called by WaitSet::Dispatch() methods when this Waitable triggers.
+	 * This allows dispatching events directly to their handlers instead of checking
+	 * readiness flags of all the triggered Waitables and casting user data.
+	 * NOTE: the handler must not replace itself or destroy the Waitable it was called for,
+	 *       because that destroys the handler while it is being executed.
+	 * @param handler - handler to call when this Waitable triggers. Pass empty function to clear the handler.
+	 */
+	void SetReadinessHandler(T_ReadinessHandler&& handler){
+		this->readinessHandler = std::move(handler);
+	}
+
+#if M_OS == M_OS_WINDOWS
+protected:
+	virtual HANDLE GetHandle() = 0;
+
+	virtual void SetWaitingEvents(std::uint32_t /*flagsToWaitFor*/){}
+
+	//returns true if signaled
+	virtual bool CheckSignaled(){
+		return this->readinessFlags != 0;
+	}
+
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX || M_OS == M_OS_UNIX
+public:
+	/**
+	 * @brief Get Unix file descriptor.
+	 * This method is specific to Unix-based operating systems, like Linux, MAC OS X, Unix.
+	 * This method is made public in order to ease embedding Waitables to existing epoll() sets.
+	 * Use this method only if you know what you are doing!
+	 */
+	virtual int GetHandle() = 0;
+
+#else
+#	error "Unsupported OS"
+#endif
+
+};//~class Waitable
+
+
+
+
+
+/**
+ * @brief Set of Waitable objects to wait for.
+ * The wait set is not limited in the number of Waitables which can be added to it
+ * (except on Windows, where it cannot hold more than MAXIMUM_WAIT_OBJECTS Waitables).
+ * Triggered Waitables are reported by Wait() methods in batches, the maximum size of the
+ * batch is specified in the constructor. If more Waitables have triggered than fit into
+ * the batch or into the passed output buffer, the rest of them are reported by subsequent
+ * calls to Wait(), so the cost of a single wait depends on the number of ready Waitables,
+ * not on the number of added Waitables.
+ * For latency critical applications the wait set can be switched to busy polling mode,
+ * see SetBusyPoll().
+ * If the library is built with M_ENABLE_WAITSET_STATS macro defined, the wait set collects
+ * statistics, see GetStats().
+ */
+class WaitSet{
+	unsigned numWaitables = 0;//number of Waitables added
+
+	//Waitables triggered during the last Dispatch() call, the ones which are removed
+	//from within the handlers are set to nullptr, so that their handlers are not called
+	std::vector<Waitable*> dispatchList;
+	unsigned numToDispatch = 0;
+	unsigned dispatchIndex = 0;
+
+	//Waitables with deferred changes, removed Waitables are set to nullptr
+	std::vector<Waitable*> deferred;
+
+#if M_OS == M_OS_WINDOWS
+	std::vector<Waitable*> waitables;
+	std::vector<HANDLE> handles; //used to pass array of HANDLEs to WaitForMultipleObjectsEx()
+
+	const unsigned batchSize;
+
+	unsigned nextToCheck = 0;//index of Waitable to start checking from next time, for fairness
+
+#elif M_OS == M_OS_LINUX
+	int epollSet = -1;
+
+	std::vector<epoll_event> revents;//used for getting the result from epoll_wait()
+
+	//io_uring based implementation, used instead of epoll if IO_URING backend is selected
+	struct IoUring;
+	std::unique_ptr<IoUring> ioUring;
+#elif M_OS == M_OS_MACOSX
+	int queue; // kqueue
+	
+	std::vector<struct kevent> revents;//used for getting the result
+#else
+#	error "Unsupported OS"
+#endif
+
+public:
+
+	/**
+	 * @brief WaitSet related exception class.
+	 */
+	class Exc : public ting::Exc{
+		Waitable* waitable;
+	public:
+		Exc(const std::string& message = std::string(), Waitable* waitable = nullptr) :
+				ting::Exc(message),
+				waitable(waitable)
+		{}
+
+		/**
+		 * @brief Get Waitable which caused the error.
+		 * The Waitable is known for errors of applying deferred changes,
+		 * see WaitSet::ApplyDeferredChanges().
+		 * @return pointer to the Waitable which caused the error.
+		 * @return nullptr if the error is not related to a particular Waitable.
+		 */
+		Waitable* GetWaitable()const NOEXCEPT{
+			return this->waitable;
+		}
+	};
+	
+	/**
+	 * @brief Default maximum number of Waitables reported by one call to Wait().
+	 */
+	static const unsigned DEFAULT_BATCH_SIZE = 64;
+
+	/**
+	 * @brief Kinds of WaitSet implementation.
+	 * NATIVE - the default implementation for the OS: WaitForMultipleObjectsEx() on Windows,
+	 *          epoll on Linux, kqueue on Mac OS X.
+	 * IO_URING - Linux only, readiness of Waitables is polled using io_uring. Re-arming of
+	 *            the triggered Waitables is submitted to the kernel in the same system call
+	 *            which waits for the next events. Requires Linux kernel 5.11 or later.
+	 *            Edge-triggered mode uses multishot poll requests, if the kernel does not
+	 *            support those (before 5.13) then one-shot poll requests are re-armed
+	 *            instead, so a Waitable may be reported again while it stays ready.
+	 *            If io_uring is not available (other OS, older kernel, disabled by system
+	 *            settings) then NATIVE implementation is used instead, check Backend()
+	 *            to find out which one is actually used.
+	 */
+	enum EBackend{
+		NATIVE,
+		IO_URING
+	};
+
+	/**
+	 * @brief Constructor.
+	 * @param batchSize - maximum number of triggered Waitables reported by one call to Wait().
+	 *                    The WaitSet can hold any number of Waitables regardless of this value.
+	 * @param backend - implementation to use, see EBackend.
+	 */
+	WaitSet(unsigned batchSize = DEFAULT_BATCH_SIZE, EBackend backend = NATIVE);
+
+
+
+	/**
+	 * @brief Destructor.
+	 * Note, that destructor will check if the wait set is empty. If it is not, then an assert
+	 * will be triggered.
+	 * It is user's responsibility to remove any waitable objects from the waitset
+	 * before the wait set object is destroyed.
+	 */
+	~WaitSet()NOEXCEPT;
+
+
+
+	/**
+	 * @brief Get implementation used by this WaitSet.
+	 * @return backend actually used, it can differ from the requested one, see EBackend.
+	 */
+	EBackend Backend()const NOEXCEPT{
+#if M_OS == M_OS_LINUX
+		if(this->ioUring){
+			return IO_URING;
+		}
+#endif
+		return NATIVE;
+	}
+
+	/**
+	 * @brief Get maximum number of Waitables reported by one call to Wait().
+	 * @return batch size this WaitSet was created with.
+	 */
+	unsigned BatchSize()const NOEXCEPT{
+#if M_OS == M_OS_WINDOWS
+		return this->batchSize;
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX
+		return unsigned(this->revents.size());
+#else
+#	error "Unsupported OS"
+#endif
+	}
+
+	/**
+	 * @brief Get number of Waitables already added to this WaitSet.
+	 * @return number of Waitables added to this WaitSet.
+	 */
+	unsigned NumWaitables()const NOEXCEPT{
+		return this->numWaitables;
+	}
+
+	/**
+	 * @brief Busy polling counters.
+	 * See SetBusyPoll().
+	 */
+	struct BusyPollCounters{
+		/**
+		 * @brief Number of waits which were satisfied while spinning.
+		 */
+		std::uint64_t numSpinHits = 0;
+
+		/**
+		 * @brief Number of waits which have not been satisfied while spinning and had to block.
+		 */
+		std::uint64_t numBlocks = 0;
+
+		/**
+		 * @brief Number of non-blocking polls done while spinning.
+		 */
+		std::uint64_t numPolls = 0;
+	};
+
+	/**
+	 * @brief Set busy polling mode.
+	 * In busy polling mode Wait() and Dispatch() methods do not block right away. Instead,
+	 * they spin polling the Waitables without blocking for some time (spin budget),
+	 * and only if nothing has triggered during that time they block. This avoids
+	 * the cost of putting the thread to sleep and waking it up, which can be more than
+	 * the cost of handling the event itself, for the price of burning the CPU time while spinning.
+	 * The spin budget adapts to the recent hit rate: each wait satisfied while spinning
+	 * doubles the budget, up to maxSpinBudget, and each wait which had to block halves it,
+	 * down to 1/64 of maxSpinBudget, but not lower than 1 nanosecond.
+	 * Waits with zero timeout never spin, waits with timeout never spin past the timeout.
+	 * @param maxSpinBudget - maximum time to spin before blocking. Zero disables busy polling,
+	 *                        this is the default.
+	 */
+	void SetBusyPoll(std::chrono::nanoseconds maxSpinBudget)NOEXCEPT{
+		if(maxSpinBudget < std::chrono::nanoseconds::zero()){
+			maxSpinBudget = std::chrono::nanoseconds::zero();
+		}
+		this->busyPollMaxBudget = maxSpinBudget;
+		this->busyPollBudget = maxSpinBudget;
+	}
+
+	/**
+	 * @brief Get current spin budget.
+	 * @return the time the next wait will spin before blocking.
+	 * @return zero if busy polling is disabled.
+	 */
+	std::chrono::nanoseconds BusyPollBudget()const NOEXCEPT{
+		return this->busyPollBudget;
+	}
+
+	/**
+	 * @brief Get busy polling counters.
+	 * Counters are only updated while busy polling is enabled.
+	 * @return busy polling counters accumulated since creation of the wait set or since last
+	 *         call to ResetBusyPollCounters().
+	 */
+	const BusyPollCounters& GetBusyPollCounters()const NOEXCEPT{
+		return this->busyPollCounters;
+	}
+
+	/**
+	 * @brief Reset busy polling counters to zero.
+	 */
+	void ResetBusyPollCounters()NOEXCEPT{
+		this->busyPollCounters = BusyPollCounters();
+	}
+
+	/**
+	 * @brief Wait set statistics.
+	 * See GetStats().
+	 * Histograms have logarithmic buckets: bucket 0 counts zero values, bucket i counts values
+	 * in range [2^(i-1), 2^i), the last bucket also counts all the values which do not fit into it.
+	 */
+	struct Stats{
+		static const unsigned DNumHistogramBuckets = 32;
+
+		typedef std::array<std::uint64_t, DNumHistogramBuckets> T_Histogram;
+
+		/**
+		 * @brief Number of waits done, including the ones done by Dispatch() methods.
+		 */
+		std::uint64_t numWaits = 0;
+
+		/**
+		 * @brief Total number of triggered Waitables reported by all the waits.
+		 */
+		std::uint64_t numEvents = 0;
+
+		/**
+		 * @brief Histogram of wait durations in microseconds.
+		 * Wait duration includes the time spent on busy polling.
+		 */
+		T_Histogram waitDurations;
+
+		/**
+		 * @brief Histogram of numbers of triggered Waitables reported per wait.
+		 */
+		T_Histogram eventsPerWait;
+
+		/**
+		 * @brief Number of Waitable additions made to the system wait facility.
+		 * E.g. number of epoll_ctl(EPOLL_CTL_ADD) calls in case of epoll. Deferred additions
+		 * of Waitables which were removed before the additions were applied are not counted.
+		 */
+		std::uint64_t numSystemAdds = 0;
+
+		/**
+		 * @brief Number of wait flags changes made to the system wait facility.
+		 * Changes which were skipped because flags have not actually changed are not counted.
+		 */
+		std::uint64_t numSystemChanges = 0;
+
+		/**
+		 * @brief Number of Waitable removals made from the system wait facility.
+		 */
+		std::uint64_t numSystemRemoves = 0;
+
+		/**
+		 * @brief Number of waits made on the system wait facility.
+		 * In busy polling mode it includes the non-blocking polls.
+		 */
+		std::uint64_t numSystemWaits = 0;
+
+		/**
+		 * @brief Number of times each Waitable has triggered.
+		 * Only Waitables which are currently added to the wait set and have triggered at
+		 * least once since the last statistics reset are present.
+		 */
+		std::unordered_map<const Waitable*, std::uint64_t> numTriggered;
+
+		Stats(){
+			this->waitDurations.fill(0);
+			this->eventsPerWait.fill(0);
+		}
+
+		/**
+		 * @brief Get histogram bucket index for a value.
+		 * @param value - value to get the bucket for.
+		 * @return index of the histogram bucket the value is counted in.
+		 */
+		static unsigned HistogramBucket(std::uint64_t value)NOEXCEPT{
+			unsigned i = 0;
+			for(; value != 0 && i != DNumHistogramBuckets - 1; value >>= 1){
+				++i;
+			}
+			return i;
+		}
+	};
+
+	/**
+	 * @brief Get wait set statistics.
+	 * Statistics are only collected if the library is built with M_ENABLE_WAITSET_STATS
+	 * macro defined, collecting statistics adds some overhead to every wait set operation.
+	 * @return pointer to statistics collected since creation of the wait set or since last call to ResetStats().
+	 * @return nullptr if the library is built without statistics support.
+	 */
+	const Stats* GetStats()const NOEXCEPT;
+
+	/**
+	 * @brief Reset statistics.
+	 * Does nothing if the library is built without statistics support.
+	 */
+	void ResetStats()NOEXCEPT;
+
+
+	/**
+	 * @brief Add Waitable object to the wait set.
+	 * @param w - Waitable object to add to the WaitSet.
+	 * @param flagsToWaitFor - determine events waiting for which we are interested.
+	 * @param triggerMode - mode of reporting the readiness of the Waitable, see Waitable::ETriggerMode.
+	 * @throw ting::WaitSet::Exc - in case of error, e.g. on Windows when the wait set is full.
+	 */
+	void Add(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor, Waitable::ETriggerMode triggerMode = Waitable::LEVEL_TRIGGERED);
+
+	/**
+	 * @brief Add Waitable object to the wait set on next wait.
+	 * Same as Add(), but the Waitable is actually added to the system wait set right before the
+	 * next Wait() (or Dispatch()) call or when ApplyDeferredChanges() is called. The Waitable is
+	 * considered added right after this method returns, so it can be changed or removed as usual.
+	 * Deferring allows coalescing the changes made to the Waitable before the next wait, so
+	 * that only one system call is made for all of them.
+	 * @param w - Waitable object to add to the WaitSet.
+	 * @param flagsToWaitFor - determine events waiting for which we are interested.
+	 * @param triggerMode - mode of reporting the readiness of the Waitable, see Waitable::ETriggerMode.
+	 * @throw ting::WaitSet::Exc - in case of error. Errors of adding to the system wait set
+	 *        are reported by the method which applies deferred changes, see ApplyDeferredChanges().
+	 */
+	void AddDeferred(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor, Waitable::ETriggerMode triggerMode = Waitable::LEVEL_TRIGGERED);
+
+
+
+	/**
+	 * @brief Change wait flags for a given Waitable.
+	 * Changes wait flags for a given waitable, which is in this WaitSet.
+	 * The trigger mode specified when adding the Waitable is preserved.
+	 * For Waitables added in ONE_SHOT mode this method re-arms the Waitable.
+	 * For other Waitables, if the flags are the same as current ones, then the method does nothing.
+	 * If the Waitable has deferred changes, those are applied along with this change.
+	 * @param w - Waitable for which the changing of wait flags is needed.
+	 * @param flagsToWaitFor - new wait flags to be set for the given Waitable.
+	 * @throw ting::WaitSet::Exc - in case the given Waitable object is not added to this wait set or
+	 *                    other error occurs.
+	 */
+	void Change(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor);
+
+	/**
+	 * @brief Change wait flags for a given Waitable on next wait.
+	 * Same as Change(), but the change is applied right before the next Wait() (or Dispatch())
+	 * call or when ApplyDeferredChanges() is called. Several deferred changes of the same Waitable
+	 * are coalesced into one, and if the flags end up being the same as before then nothing is done.
+	 * This is useful, for example, when toggling the WRITE flag on many sockets.
+	 * @param w - Waitable object to change the waiting events for.
+	 * @param flagsToWaitFor - new flags.
+	 * @throw ting::WaitSet::Exc - in case of error. Errors of changing the flags in the system
+	 *        wait set are reported by the method which applies deferred changes, see ApplyDeferredChanges().
+	 */
+	void ChangeDeferred(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor);
+
+	/**
+	 * @brief Apply deferred changes.
+	 * Applies changes made by AddDeferred() and ChangeDeferred(). Normally, there is no need to
+	 * call this method because Wait() and Dispatch() methods apply deferred changes before waiting.
+	 * If applying a change fails, the exception is thrown and the changes which were not applied,
+	 * including the failed one, remain deferred, so they are tried again on next apply. The Waitable
+	 * which failed is still considered added and can be changed or removed as usual, e.g. to get rid
+	 * of the failing change the Waitable can be removed.
+	 * @throw ting::WaitSet::Exc - in case of error. The failed Waitable can be obtained with Exc::GetWaitable().
+	 */
+	void ApplyDeferredChanges();
+
+
+
+	/**
+	 * @brief Remove Waitable from wait set.
+	 * The Waitable is removed immediately, its deferred changes, if any, are discarded.
+	 * The method does not throw. Removing a Waitable which is not added to this wait set
+	 * is a programming error, it is asserted in debug build. Errors reported by the system
+	 * on removal are asserted in debug build and ignored otherwise, the Waitable is
+	 * considered removed anyway.
+	 * @param w - Waitable object to be removed from the WaitSet.
+	 */
+	void Remove(Waitable& w)NOEXCEPT;
+
+
+
+	/**
+	 * @brief wait for event.
+	 * This function blocks calling thread execution until one of the Waitable objects in the WaitSet
+	 * triggers. Upon return from the function, pointers to triggered objects are placed in the
+	 * 'out_events' buffer and the return value from the function indicates number of these objects
+	 * which have triggered.
+	 * Note, that it does not change the readiness state of non-triggered objects.
+	 * At most min(out_events.size(), BatchSize()) objects are reported, the rest of triggered
+	 * objects, if any, remain pending and will be reported by subsequent calls.
+	 * @param out_events - buffer where to put pointers to triggered Waitable objects.
+	 *                     The buffer will not be initialized to 0's by this function.
+	 * @return number of objects triggered.
+	 *         NOTE: for some reason, on Windows it can return 0 objects triggered.
+	 * @throw ting::WaitSet::Exc - in case of errors.
+	 */
+	unsigned Wait(Buffer<Waitable*> out_events){
+		return this->Wait(true, T_TimePoint(), &out_events);
+	}
+	
+	/**
+	 * @brief wait for event.
+	 * Same as Wait(const Buffer<Waitable*>& out_events) but does not return out_events.
+     * @return number of objects triggered.
+     */
+	unsigned Wait(){
+		return this->Wait(true, T_TimePoint(), 0);
+	}
+
+
+	/**
+	 * @brief wait for event with timeout.
+	 * The same as Wait() function, but takes wait timeout as parameter. Thus,
+	 * this function will wait for any event or timeout. Note, that it guarantees that
+	 * it will wait AT LEAST for specified number of milliseconds, or more. If wait is
+	 * interrupted by signal it will continue waiting for the rest of the timeout.
+	 * @param timeout - maximum time in milliseconds to wait for event.
+	 * @param out_events - buffer where to put pointers to triggered Waitable objects.
+	 *                     At most min(out_events.size(), BatchSize()) objects are reported.
+	 * @return number of objects triggered. If 0 then timeout was hit.
+	 *         NOTE: for some reason, on Windows it can return 0 before timeout was hit.
+	 * @throw ting::WaitSet::Exc - in case of errors.
+	 */
+	unsigned WaitWithTimeout(std::uint32_t timeout, Buffer<Waitable*> out_events){
+		return this->Wait(false, DeadlineFromTimeout(std::chrono::milliseconds(timeout)), &out_events);
+	}
+	
+	/**
+	 * @brief wait for event with timeout.
+	 * Same as WaitWithTimeout(std::uint32_t timeout, const Buffer<Waitable*>& out_events) but
+	 * does not return out_events.
+     * @param timeout - maximum time in milliseconds to wait for event.
+     * @return number of objects triggered. If 0 then timeout was hit.
+	 *         NOTE: for some reason, on Windows it can return 0 before timeout was hit.
+     */
+	unsigned WaitWithTimeout(std::uint32_t timeout){
+		return this->Wait(false, DeadlineFromTimeout(std::chrono::milliseconds(timeout)), 0);
+	}
+
+	/**
+	 * @brief wait for event with timeout.
+	 * Same as WaitWithTimeout(std::uint32_t timeout, const Buffer<Waitable*>& out_events), but
+	 * the timeout is given as std::chrono duration which allows sub-millisecond timeouts.
+	 * The actual resolution of the timeout depends on the system: on Linux it is nanoseconds
+	 * if epoll_pwait2() is supported by the kernel (Linux 5.11 and later) or io_uring
+	 * backend is used, otherwise it is milliseconds. On Mac OS it is nanoseconds and on Windows
+	 * it is milliseconds. Timeout is always rounded up to the timer resolution.
+	 * Negative timeout is treated as zero timeout.
+	 * @param timeout - maximum time to wait for event.
+	 * @param out_events - buffer where to put pointers to triggered Waitable objects.
+	 *                     At most min(out_events.size(), BatchSize()) objects are reported.
+	 * @return number of objects triggered. If 0 then timeout was hit.
+	 * @throw ting::WaitSet::Exc - in case of errors.
+	 */
+	template <class T_Rep, class T_Period> unsigned WaitWithTimeout(const std::chrono::duration<T_Rep, T_Period>& timeout, Buffer<Waitable*> out_events){
+		return this->Wait(false, DeadlineFromTimeout(timeout), &out_events);
+	}
+
+	/**
+	 * @brief wait for event with timeout.
+	 * Same as WaitWithTimeout(const std::chrono::duration<T_Rep, T_Period>& timeout, const Buffer<Waitable*>& out_events)
+	 * but does not return out_events.
+	 * @param timeout - maximum time to wait for event.
+	 * @return number of objects triggered. If 0 then timeout was hit.
+	 */
+	template <class T_Rep, class T_Period> unsigned WaitWithTimeout(const std::chrono::duration<T_Rep, T_Period>& timeout){
+		return this->Wait(false, DeadlineFromTimeout(timeout), 0);
+	}
+
+	/**
+	 * @brief wait for event until deadline.
+	 * Same as WaitWithTimeout(), but instead of relative timeout takes an absolute point in time
+	 * until which to wait. Because the deadline is absolute, waiting in a loop until some
+	 * fixed point in time does not accumulate errors. If the deadline has already passed then
+	 * the function just polls the Waitables.
+	 * Deadlines given for clocks other than std::chrono::steady_clock are converted to
+	 * steady_clock deadlines when the function is called.
+	 * @param deadline - point in time until which to wait.
+	 * @param out_events - buffer where to put pointers to triggered Waitable objects.
+	 *                     At most min(out_events.size(), BatchSize()) objects are reported.
+	 * @return number of objects triggered. If 0 then deadline was hit.
+	 * @throw ting::WaitSet::Exc - in case of errors.
+	 */
+	template <class T_Clock, class T_Duration> unsigned WaitUntil(const std::chrono::time_point<T_Clock, T_Duration>& deadline, Buffer<Waitable*> out_events){
+		return this->Wait(false, ToSteadyDeadline(deadline), &out_events);
+	}
+
+	/**
+	 * @brief wait for event until deadline.
+	 * Same as WaitUntil(const std::chrono::time_point<T_Clock, T_Duration>& deadline, const Buffer<Waitable*>& out_events)
+	 * but does not return out_events.
+	 * @param deadline - point in time until which to wait.
+	 * @return number of objects triggered. If 0 then deadline was hit.
+	 */
+	template <class T_Clock, class T_Duration> unsigned WaitUntil(const std::chrono::time_point<T_Clock, T_Duration>& deadline){
+		return this->Wait(false, ToSteadyDeadline(deadline), 0);
+	}
+
+	/**
+	 * @brief Wait for event and call handlers of triggered Waitables.
+	 * Waits same way as Wait() does and then calls readiness handlers
+	 * (see Waitable::SetReadinessHandler()) of the triggered Waitables with their readiness flags.
+	 * Triggered Waitables which have no readiness handler set are skipped.
+	 * It is allowed to add, change and remove Waitables from within the handlers. If a Waitable
+	 * is removed from within a handler, its handler will not be called during this dispatch.
+	 * At most BatchSize() Waitables are dispatched by one call.
+	 * Calling Dispatch() recursively from within a handler is not allowed.
+	 * @return number of objects triggered.
+	 * @throw ting::WaitSet::Exc - in case of errors.
+	 * @throw any exception thrown by the readiness handler, the rest of handlers will not be
+	 *        called in that case, the corresponding Waitables stay ready.
+	 */
+	unsigned Dispatch(){
+		return this->Dispatch(true, T_TimePoint());
+	}
+
+	/**
+	 * @brief Wait for event with timeout and call handlers of triggered Waitables.
+	 * Same as Dispatch(), but waits same way as WaitWithTimeout() does.
+	 * @param timeout - maximum time in milliseconds to wait for event.
+	 * @return number of objects triggered. If 0 then timeout was hit.
+	 */
+	unsigned DispatchWithTimeout(std::uint32_t timeout){
+		return this->Dispatch(false, DeadlineFromTimeout(std::chrono::milliseconds(timeout)));
+	}
+
+	/**
+	 * @brief Wait for event with timeout and call handlers of triggered Waitables.
+	 * Same as Dispatch(), but waits same way as WaitWithTimeout(const std::chrono::duration<T_Rep, T_Period>&) does.
+	 * @param timeout - maximum time to wait for event.
+	 * @return number of objects triggered. If 0 then timeout was hit.
+	 */
+	template <class T_Rep, class T_Period> unsigned DispatchWithTimeout(const std::chrono::duration<T_Rep, T_Period>& timeout){
+		return this->Dispatch(false, DeadlineFromTimeout(timeout));
+	}
+
+	/**
+	 * @brief Wait for event until deadline and call handlers of triggered Waitables.
+	 * Same as Dispatch(), but waits same way as WaitUntil() does.
+	 * @param deadline - point in time until which to wait.
+	 * @return number of objects triggered. If 0 then deadline was hit.
+	 */
+	template <class T_Clock, class T_Duration> unsigned DispatchUntil(const std::chrono::time_point<T_Clock, T_Duration>& deadline){
+		return this->Dispatch(false, ToSteadyDeadline(deadline));
+	}
+
+
+
+private:
+	//busy polling, see SetBusyPoll()
+	std::chrono::nanoseconds busyPollMaxBudget = std::chrono::nanoseconds::zero();
+	std::chrono::nanoseconds busyPollBudget = std::chrono::nanoseconds::zero();
+	BusyPollCounters busyPollCounters;
+
+	//statistics, nullptr if statistics support is not compiled in
+	struct StatsData;
+	static StatsData* CreateStats();
+	std::unique_ptr<StatsData> stats;
+
+	void UpdateStats(std::chrono::steady_clock::time_point waitStart, Buffer<Waitable*>* out_events, unsigned numEvents);
+
+	typedef std::chrono::steady_clock::time_point T_TimePoint;
+
+	template <class T_Rep, class T_Period> static T_TimePoint DeadlineFromTimeout(const std::chrono::duration<T_Rep, T_Period>& timeout){
+		//limit the timeout to 100 years to avoid overflow of the steady_clock time point
+		const std::chrono::hours maxTimeout(24 * 365 * 100);
+
+		T_TimePoint now = std::chrono::steady_clock::now();
+		if(timeout <= std::chrono::duration<T_Rep, T_Period>::zero()){
+			return now;
+		}
+		if(timeout >= maxTimeout){
+			return now + maxTimeout;
+		}
+		//round up to nanoseconds, so that sub-nanosecond remainders do not shorten the wait
+		std::chrono::nanoseconds t = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout);
+		if(t < timeout){
+			++t;
+		}
+		return now + std::chrono::duration_cast<T_TimePoint::duration>(t);
+	}
+
+	static T_TimePoint ToSteadyDeadline(const T_TimePoint& deadline)NOEXCEPT{
+		return deadline;
+	}
+
+	template <class T_Duration> static T_TimePoint ToSteadyDeadline(const std::chrono::time_point<std::chrono::steady_clock, T_Duration>& deadline){
+		return std::chrono::time_point_cast<T_TimePoint::duration>(deadline);
+	}
+
+	template <class T_Clock, class T_Duration> static T_TimePoint ToSteadyDeadline(const std::chrono::time_point<T_Clock, T_Duration>& deadline){
+		return DeadlineFromTimeout(deadline - T_Clock::now());
+	}
+
+	unsigned Wait(bool waitInfinitly, T_TimePoint deadline, Buffer<Waitable*>* out_events);
+
+	unsigned BusyPoll(bool waitInfinitly, T_TimePoint deadline, Buffer<Waitable*>* out_events, unsigned maxEvents);
+
+	unsigned WaitInSystem(bool waitInfinitly, T_TimePoint deadline, Buffer<Waitable*>* out_events, unsigned maxEvents);
+
+	unsigned Dispatch(bool waitInfinitly, T_TimePoint deadline);
+
+	void ApplyDeferred(Waitable& w);
+
+	void AddToSystem(Waitable& w, std::uint32_t flagsToWaitFor);
+	void ChangeInSystem(Waitable& w, std::uint32_t flagsToWaitFor);
+	void RemoveFromSystem(Waitable& w)NOEXCEPT;
+	
+	
+#if M_OS == M_OS_LINUX
+	static std::uint32_t EpollEvents(std::uint32_t flagsToWaitFor, std::uint32_t triggerMode)NOEXCEPT;
+#elif M_OS == M_OS_MACOSX
+	void AddFilter(Waitable& w, int16_t filter);
+	void RemoveFilter(Waitable& w, int16_t filter);
+#endif
+
+};//~class WaitSet
+
+
+
+inline Waitable::Waitable(Waitable&& w) :
+		isAdded(false),
+		userData(w.userData),
+		readinessFlags(NOT_READY)//Treat copied Waitable as NOT_READY
+{
+	//cannot move from waitable which is added to WaitSet
+	if(w.isAdded){
+		throw ting::WaitSet::Exc("Waitable::Waitable(move): cannot move Waitable which is added to WaitSet");
+	}
+
+	const_cast<Waitable&>(w).ClearAllReadinessFlags();
+	const_cast<Waitable&>(w).userData = 0;
+
+	this->readinessHandler = std::move(w.readinessHandler);
+	w.readinessHandler = nullptr;
+}
+
+
+
+inline Waitable& Waitable::operator=(Waitable&& w){
+	if(this->isAdded){
+		throw ting::WaitSet::Exc("Waitable::Waitable(move): cannot move while this Waitable is added to WaitSet");
+	}
+
+	if(w.isAdded){
+		throw ting::WaitSet::Exc("Waitable::Waitable(move): cannot move Waitable which is added to WaitSet");
+	}
+
+	ASSERT(!this->isAdded)
+
+	//Clear readiness flags on moving.
+	//Will need to wait for readiness again, using the WaitSet.
+	this->ClearAllReadinessFlags();
+	const_cast<Waitable&>(w).ClearAllReadinessFlags();
+
+	this->userData = w.userData;
+	const_cast<Waitable&>(w).userData = 0;
+
+	this->readinessHandler = std::move(w.readinessHandler);
+	w.readinessHandler = nullptr;
+	return *this;
+}
+
+
+
+}//~namespace ting
+
+
+//restore warnings state
+#if M_COMPILER == M_COMPILER_MSVC
+#	pragma warning(pop) //pop warnings state
+#endif
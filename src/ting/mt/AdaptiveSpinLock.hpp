@@ -0,0 +1,193 @@
+/* The MIT License:
+
+Copyright (c) 2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+
+
+/**
+ * @author Ivan Gagis <igagis@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+
+#include "../config.hpp"
+#include "../util.hpp"
+#include "../debug.hpp"
+
+#include "CpuRelax.hpp"
+
+#if M_OS == M_OS_LINUX
+#	include <unistd.h>
+#	include <sys/syscall.h>
+#	include <linux/futex.h>
+#elif M_OS == M_OS_WINDOWS
+#	include "../windows.hpp"
+#	if M_COMPILER == M_COMPILER_MSVC
+#		pragma comment(lib, "Synchronization.lib")
+#	endif
+#else
+#	include <mutex>
+#	include <condition_variable>
+#endif
+
+
+namespace ting{
+namespace mt{
+
+/**
+ * @brief Adaptive spin-then-park lock.
+ * The lock is supposed to protect short critical sections. Unlike SpinLock, it does not
+ * yield the thread on every failed attempt to acquire the lock, instead, it first spins
+ * for a while executing the CPU 'pause' instruction (see CpuRelax()) with exponential backoff,
+ * and only if the lock is still not acquired it puts the thread to sleep until the lock is released.
+ * While spinning the lock is only read, and the atomic read-modify-write operation
+ * is attempted only when the lock was seen unlocked (test-and-test-and-set), so the waiting threads
+ * do not steal the cache line from the thread which holds the lock.
+ * On Linux the sleeping is done with futex and on Windows with WaitOnAddress() (Windows 8 or later,
+ * needs linking to Synchronization library), so unlocking the lock which has no sleeping
+ * waiters does not involve any system calls. On other systems the waiting thread sleeps on
+ * a condition variable, which is only touched when there are sleeping waiters.
+ * The class satisfies the Lockable requirements, so it can be used with std::lock_guard and std::unique_lock.
+ */
+class AdaptiveSpinLock{
+	enum EState{
+		UNLOCKED = 0,
+		LOCKED = 1,
+		LOCKED_WITH_WAITERS = 2 //locked and there might be sleeping threads waiting for the lock
+	};
+
+	//int to be able to use it as futex word
+	std::atomic<int> state;
+
+#if M_OS != M_OS_LINUX && M_OS != M_OS_WINDOWS
+	std::mutex parkMutex;
+	std::condition_variable parkCV;
+#endif
+
+	//Maximum number of 'pause' instructions between two attempts to acquire the lock.
+	static const unsigned DMaxBackoff = 64;
+
+	//Total number of 'pause' instructions to spin for before going to sleep.
+	static const unsigned DSpinBudget = 1024;
+
+public:
+	AdaptiveSpinLock()NOEXCEPT :
+			state(UNLOCKED)
+	{}
+
+	AdaptiveSpinLock(const AdaptiveSpinLock&) = delete;
+	AdaptiveSpinLock& operator=(const AdaptiveSpinLock&) = delete;
+
+	~AdaptiveSpinLock()NOEXCEPT{
+		ASSERT(this->state.load() == UNLOCKED)
+	}
+
+	/**
+	 * @brief Try to lock the lock without waiting.
+	 * @return true if the lock was acquired.
+	 * @return false if the lock is held by other thread.
+	 */
+	bool try_lock()NOEXCEPT{
+		if(this->state.load(std::memory_order_relaxed) != UNLOCKED){
+			return false;
+		}
+		int expected = UNLOCKED;
+		return this->state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Lock the lock.
+	 * If the lock cannot be acquired immediately, spins for a while and then sleeps
+	 * until the lock is released.
+	 */
+	void lock()NOEXCEPT{
+		int expected = UNLOCKED;
+		if(this->state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)){
+			return;
+		}
+		this->LockSlow();
+	}
+
+	/**
+	 * @brief Unlock the lock.
+	 * Wakes up one of the sleeping threads, if any.
+	 */
+	void unlock()NOEXCEPT{
+		if(this->state.exchange(UNLOCKED, std::memory_order_release) == LOCKED_WITH_WAITERS){
+			this->WakeUp();
+		}
+	}
+
+private:
+	void LockSlow()NOEXCEPT{
+		for(unsigned backoff = 1, spent = 0; spent < DSpinBudget; spent += backoff, backoff = std::min(backoff * 2, unsigned(DMaxBackoff))){
+			for(unsigned i = 0; i != backoff; ++i){
+				CpuRelax();
+			}
+			if(this->try_lock()){
+				return;
+			}
+		}
+
+		//Mark the lock as having waiters before going to sleep. If the lock was released
+		//meanwhile, then it is acquired by this exchange, but it is left marked as having waiters,
+		//which at worst results in one unnecessary wake up call on unlocking.
+		while(this->state.exchange(LOCKED_WITH_WAITERS, std::memory_order_acquire) != UNLOCKED){
+			this->Sleep();
+		}
+	}
+
+	//sleep while the lock is in LOCKED_WITH_WAITERS state
+	void Sleep()NOEXCEPT{
+#if M_OS == M_OS_LINUX
+		syscall(SYS_futex, reinterpret_cast<int*>(&this->state), FUTEX_WAIT_PRIVATE, int(LOCKED_WITH_WAITERS), nullptr, nullptr, 0);
+#elif M_OS == M_OS_WINDOWS
+		int undesired = LOCKED_WITH_WAITERS;
+		WaitOnAddress(reinterpret_cast<volatile VOID*>(&this->state), &undesired, sizeof(undesired), INFINITE);
+#else
+		//WakeUp() notifies with the mutex locked, so the wake up cannot get lost between
+		//checking the state and starting to wait
+		std::unique_lock<std::mutex> lock(this->parkMutex);
+		while(this->state.load(std::memory_order_relaxed) == LOCKED_WITH_WAITERS){
+			this->parkCV.wait(lock);
+		}
+#endif
+	}
+
+	void WakeUp()NOEXCEPT{
+#if M_OS == M_OS_LINUX
+		syscall(SYS_futex, reinterpret_cast<int*>(&this->state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#elif M_OS == M_OS_WINDOWS
+		WakeByAddressSingle(reinterpret_cast<VOID*>(&this->state));
+#else
+		std::lock_guard<std::mutex> lock(this->parkMutex);
+		this->parkCV.notify_one();
+#endif
+	}
+};
+
+}//~namespace
+}//~namespace
@@ -0,0 +1,67 @@
+/* The MIT License:
+
+Copyright (c) 2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+
+
+/**
+ * @author Ivan Gagis <igagis@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include "../config.hpp"
+#include "../util.hpp"
+
+#if M_COMPILER == M_COMPILER_MSVC
+#	include "../windows.hpp"
+#endif
+
+
+namespace ting{
+namespace mt{
+
+/**
+ * @brief Hint the CPU that the calling thread is in a busy-wait loop.
+ * Executes 'pause' instruction on x86 and 'yield' instruction on ARM, which reduces
+ * power consumption and the penalty of leaving the loop, and gives the CPU
+ * resources to the other hardware thread of the same core. Does not yield the
+ * thread to the operating system scheduler.
+ */
+inline void CpuRelax()NOEXCEPT{
+#if M_COMPILER == M_COMPILER_MSVC
+	YieldProcessor();
+#elif (M_CPU == M_CPU_X86 || M_CPU == M_CPU_X86_64) && M_COMPILER == M_COMPILER_GCC
+	__builtin_ia32_pause();
+#elif M_CPU == M_CPU_ARM && M_CPU_VERSION >= 7 && M_COMPILER == M_COMPILER_GCC
+	asm volatile("yield" ::: "memory");
+#else
+	//no special instruction, just prevent the compiler from optimizing out the busy loop
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+}//~namespace
+}//~namespace
@@ -0,0 +1,584 @@
+/* The MIT License:
+
+Copyright (c) 2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+#include "EventLoopPool.hpp"
+#include "Semaphore.hpp"
+
+#include <thread>
+#include <string>
+#include <algorithm>
+
+#if M_OS == M_OS_LINUX
+#	include <sched.h>
+#elif M_OS == M_OS_WINDOWS
+#	include "../windows.hpp"
+#endif
+
+
+using namespace ting::mt;
+
+
+
+namespace{
+#if M_OS == M_OS_WINDOWS
+//WaitSet cannot hold more than MAXIMUM_WAIT_OBJECTS on Windows, two slots are taken by the message queue and the timer queue
+const unsigned DMaxWaitablesPerLoop = MAXIMUM_WAIT_OBJECTS - 2;
+#else
+const unsigned DMaxWaitablesPerLoop = unsigned(-1);
+#endif
+
+//Get indices of the CPUs the process is allowed to run on. Under restricted cpuset or taskset
+//those are not necessarily the first hardware_concurrency() ones.
+std::vector<unsigned> AllowedCPUs(){
+	std::vector<unsigned> ret;
+
+#if M_OS == M_OS_LINUX
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	//pid 0 means the calling thread, it inherits the mask of the process unless it was changed
+	if(sched_getaffinity(0, sizeof(set), &set) == 0){
+		for(unsigned i = 0; i != CPU_SETSIZE; ++i){
+			if(CPU_ISSET(i, &set)){
+				ret.push_back(i);
+			}
+		}
+	}
+#elif M_OS == M_OS_WINDOWS
+	DWORD_PTR processMask, systemMask;
+	if(GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) != 0){
+		for(unsigned i = 0; i != sizeof(processMask) * 8; ++i){
+			if((processMask & (DWORD_PTR(1) << i)) != 0){
+				ret.push_back(i);
+			}
+		}
+	}
+#endif
+
+	if(ret.size() == 0){
+		for(unsigned i = 0, n = std::max(std::thread::hardware_concurrency(), 1u); i != n; ++i){
+			ret.push_back(i);
+		}
+	}
+	return ret;
+}
+}
+
+
+
+EventLoopPool::EventLoop::EventLoop(EventLoopPool& pool, unsigned index) :
+		pool(pool),
+		index(index),
+		numWaitables(0),
+		numEvents(0),
+		threadID(0)
+{}
+
+
+
+void EventLoopPool::EventLoop::Run(){
+	this->threadID = ting::mt::Thread::GetCurrentThreadID();
+
+	this->timerQueue.AttachToThisThread();
+
+	this->waitSet.Add(this->queue, Waitable::READ);
+	this->waitSet.Add(this->timerQueue, Waitable::READ);
+
+	std::vector<Waitable*> triggered(this->waitSet.BatchSize());
+
+	while(!this->quitFlag){
+		unsigned numTriggered = this->waitSet.Wait(triggered);
+
+		for(unsigned i = 0; i != numTriggered; ++i){
+			Waitable* w = triggered[i];
+			if(w == &this->queue){
+				continue;
+			}
+			if(w == &this->timerQueue){
+				this->timerQueue.HandleExpiredTimers();
+				continue;
+			}
+
+			//The Waitable could be removed by handler of other Waitable,
+			//so look it up instead of dereferencing.
+			auto e = this->entries.find(w);
+			if(e == this->entries.end()){
+				continue;
+			}
+
+			++e->second.numEvents;
+			++this->numEvents;
+
+			this->dispatching = w;
+			e->second.handler(*w);
+			this->dispatching = nullptr;
+
+			if(this->dispatchingRemoved){
+				this->dispatchingRemoved = false;
+				this->entries.erase(e);
+			}
+		}
+
+		if(this->queue.CanRead()){
+			for(auto& m : this->queue.PeekAllMsgs()){
+				m();
+			}
+		}
+	}
+
+	//remove Waitables which were not removed from the pool, if any
+	ASSERT_INFO(this->entries.size() == 0, "EventLoopPool: destroying event loop containing Waitables, remove all Waitables from the pool first")
+	for(auto& e : this->entries){
+		this->waitSet.Remove(*e.first);
+	}
+	this->entries.clear();
+
+	this->waitSet.Remove(this->timerQueue);
+	this->waitSet.Remove(this->queue);
+
+	this->timerQueue.DetachFromThisThread();
+}
+
+
+
+void EventLoopPool::EventLoop::AddLocal(Waitable& w){
+	Waitable::EReadinessFlags flags;
+	T_Handler handler;
+	T_FailureHandler failureHandler;
+	{
+		std::lock_guard<decltype(this->pool.mutex)> mutexGuard(this->pool.mutex);
+		auto r = this->pool.registrations.find(&w);
+		if(r == this->pool.registrations.end() || r->second.loop != this->index || !r->second.adding){
+			//the Waitable was removed from the pool before it was added to the WaitSet
+			return;
+		}
+		flags = r->second.flags;
+		r->second.adding = false;
+		handler = std::move(r->second.handler);
+		failureHandler = std::move(r->second.failureHandler);
+	}
+
+	ASSERT(this->entries.find(&w) == this->entries.end())
+
+	try{
+		this->waitSet.Add(w, flags);
+	}catch(WaitSet::Exc& e){
+		TRACE(<< "EventLoopPool: adding Waitable to WaitSet failed: " << e.What() << std::endl)
+
+		{
+			std::lock_guard<decltype(this->pool.mutex)> mutexGuard(this->pool.mutex);
+			auto r = this->pool.registrations.find(&w);
+			if(r == this->pool.registrations.end() || r->second.loop != this->index){
+				//removed from the pool in the meantime, nobody is interested in the failure
+				return;
+			}
+			this->pool.registrations.erase(r);
+			--this->numWaitables;
+		}
+
+		//the Waitable is not in the pool anymore, report the failure
+		if(failureHandler){
+			failureHandler(w, e);
+		}else if(handler){
+			w.SetErrorFlag();
+			handler(w);
+		}
+		return;
+	}
+
+	Entry& e = this->entries[&w];
+	e.handler = std::move(handler);
+	e.failureHandler = std::move(failureHandler);
+}
+
+
+
+void EventLoopPool::EventLoop::ChangeLocal(Waitable& w){
+	std::lock_guard<decltype(this->pool.mutex)> mutexGuard(this->pool.mutex);
+
+	auto r = this->pool.registrations.find(&w);
+	if(r == this->pool.registrations.end()){
+		//was removed
+		return;
+	}
+
+	if(this->entries.find(&w) == this->entries.end()){
+		if(r->second.loop != this->index){
+			//The Waitable has migrated to another event loop, forward the change there.
+			//The current flags are taken from the registration, so it is not
+			//a problem if this message is reordered with later changes.
+			EventLoop* l = this->pool.loops[r->second.loop].get();
+			Waitable* pw = &w;
+			l->PushMessage([l, pw](){l->ChangeLocal(*pw);});
+		}
+		//else the Waitable is not added yet, it will be added with actual flags
+		return;
+	}
+
+	this->waitSet.Change(w, r->second.flags);
+}
+
+
+
+bool EventLoopPool::EventLoop::RemoveLocal(Waitable& w)NOEXCEPT{
+	auto e = this->entries.find(&w);
+	if(e == this->entries.end()){
+		return false;
+	}
+
+	if(this->dispatching == &w){
+		if(this->dispatchingRemoved){
+			return false;
+		}
+
+		//Removing from within its own handler, the handler object should stay alive until it returns.
+		this->waitSet.Remove(w);
+		this->dispatchingRemoved = true;
+		return true;
+	}
+
+	this->waitSet.Remove(w);
+	this->entries.erase(e);
+	return true;
+}
+
+
+
+void EventLoopPool::EventLoop::HandOver(Waitable& w, unsigned toLoop){
+	ASSERT(toLoop != this->index)
+
+	auto r = this->pool.registrations.find(&w);
+	if(r == this->pool.registrations.end()){
+		//was removed, the removal message will follow
+		return;
+	}
+
+	ASSERT(r->second.loop == this->index)
+
+	EventLoop* l = this->pool.loops[toLoop].get();
+
+	if(l->numWaitables >= DMaxWaitablesPerLoop){
+		//destination loop is full, leave the Waitable where it is
+		return;
+	}
+
+	auto e = this->entries.find(&w);
+	ASSERT(e != this->entries.end())
+
+	this->waitSet.Remove(w);
+
+	r->second.adding = true;
+	r->second.handler = std::move(e->second.handler);
+	r->second.failureHandler = std::move(e->second.failureHandler);
+	this->entries.erase(e);
+
+	r->second.loop = toLoop;
+	--this->numWaitables;
+	++l->numWaitables;
+
+	//Message is pushed while the mutex is locked, this guarantees that any
+	//subsequent operations on the Waitable will be queued after this message.
+	Waitable* pw = &w;
+	l->PushMessage([l, pw](){l->AddLocal(*pw);});
+}
+
+
+
+void EventLoopPool::EventLoop::MigrateLocal(Waitable& w, unsigned toLoop){
+	std::lock_guard<decltype(this->pool.mutex)> mutexGuard(this->pool.mutex);
+
+	if(this->entries.find(&w) == this->entries.end()){
+		auto r = this->pool.registrations.find(&w);
+		if(r != this->pool.registrations.end() && r->second.loop != this->index && r->second.loop != toLoop){
+			//the Waitable has migrated in the meantime, forward the request
+			EventLoop* l = this->pool.loops[r->second.loop].get();
+			Waitable* pw = &w;
+			l->PushMessage([l, pw, toLoop](){l->MigrateLocal(*pw, toLoop);});
+		}
+		return;
+	}
+
+	if(toLoop == this->index){
+		return;
+	}
+
+	this->HandOver(w, toLoop);
+}
+
+
+
+void EventLoopPool::EventLoop::ShedLocal(unsigned toLoop, std::uint32_t numEventsToMove){
+	if(numEventsToMove != 0 && toLoop != this->index){
+		std::vector<std::pair<std::uint32_t, Waitable*>> candidates;
+		candidates.reserve(this->entries.size());
+		for(auto& e : this->entries){
+			if(e.second.numEvents != 0){
+				candidates.push_back(std::make_pair(e.second.numEvents, e.first));
+			}
+		}
+
+		//most active first
+		std::sort(
+				candidates.begin(),
+				candidates.end(),
+				[](const std::pair<std::uint32_t, Waitable*>& a, const std::pair<std::uint32_t, Waitable*>& b){
+					return a.first > b.first;
+				}
+			);
+
+		std::lock_guard<decltype(this->pool.mutex)> mutexGuard(this->pool.mutex);
+
+		std::uint32_t moved = 0;
+		for(auto& c : candidates){
+			if(moved + c.first > numEventsToMove){
+				continue;
+			}
+			this->HandOver(*c.second, toLoop);
+			moved += c.first;
+		}
+	}
+
+	for(auto& e : this->entries){
+		e.second.numEvents = 0;
+	}
+}
+
+
+
+EventLoopPool::EventLoopPool(unsigned numLoops, bool pinToCPUs){
+	std::vector<unsigned> cpus = AllowedCPUs();
+
+	if(numLoops == 0){
+		numLoops = unsigned(cpus.size());
+	}
+
+	for(unsigned i = 0; i != numLoops; ++i){
+		this->loops.push_back(std::unique_ptr<EventLoop>(new EventLoop(*this, i)));
+		this->loops.back()->SetName("ting.loop." + std::to_string(i));
+		if(pinToCPUs){
+			this->loops.back()->SetAffinity({cpus[i % cpus.size()]});
+		}
+	}
+
+	try{
+		for(auto& l : this->loops){
+			l->Start();
+		}
+	}catch(...){
+		for(auto& l : this->loops){
+			l->PushPreallocatedQuitMessage();
+			l->Join();
+		}
+		throw;
+	}
+}
+
+
+
+EventLoopPool::~EventLoopPool()NOEXCEPT{
+	ASSERT_INFO(this->registrations.size() == 0, "EventLoopPool: destroying pool containing Waitables, remove all Waitables from the pool first")
+
+	for(auto& l : this->loops){
+		l->PushPreallocatedQuitMessage();
+	}
+	for(auto& l : this->loops){
+		l->Join();
+	}
+}
+
+
+
+unsigned EventLoopPool::Add(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor, T_Handler&& handler, T_FailureHandler&& failureHandler){
+	std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+
+	if(this->registrations.find(&w) != this->registrations.end()){
+		throw Exc("EventLoopPool::Add(): Waitable is already added to the pool");
+	}
+
+	EventLoop* l = std::min_element(
+			this->loops.begin(),
+			this->loops.end(),
+			[](const std::unique_ptr<EventLoop>& a, const std::unique_ptr<EventLoop>& b){
+				return a->numWaitables < b->numWaitables;
+			}
+		)->get();
+
+	if(l->numWaitables >= DMaxWaitablesPerLoop){
+		throw Exc("EventLoopPool::Add(): all event loops are full");
+	}
+
+	Registration& r = this->registrations[&w];
+	r.loop = l->index;
+	r.flags = flagsToWaitFor;
+	r.adding = true;
+	r.handler = std::move(handler);
+	r.failureHandler = std::move(failureHandler);
+
+	++l->numWaitables;
+
+	Waitable* pw = &w;
+	l->PushMessage([l, pw](){l->AddLocal(*pw);});
+
+	return l->index;
+}
+
+
+
+void EventLoopPool::Change(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor){
+	std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+
+	auto r = this->registrations.find(&w);
+	if(r == this->registrations.end()){
+		throw Exc("EventLoopPool::Change(): Waitable is not added to the pool");
+	}
+
+	r->second.flags = flagsToWaitFor;
+
+	EventLoop* l = this->loops[r->second.loop].get();
+	Waitable* pw = &w;
+	l->PushMessage([l, pw](){l->ChangeLocal(*pw);});
+}
+
+
+
+EventLoopPool::EventLoop* EventLoopPool::LoopOfThisThread()NOEXCEPT{
+	ting::mt::Thread::T_ThreadID id = ting::mt::Thread::GetCurrentThreadID();
+	for(auto& l : this->loops){
+		if(l->threadID == id){
+			return l.get();
+		}
+	}
+	return nullptr;
+}
+
+
+
+bool EventLoopPool::Remove(Waitable& w, T_RemovedHandler&& removedHandler){
+	Semaphore sema;
+	bool wait = false;
+
+	{
+		std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+
+		auto r = this->registrations.find(&w);
+		if(r == this->registrations.end()){
+			return false;
+		}
+
+		EventLoop* l = this->loops[r->second.loop].get();
+
+		//After the registration is erased all pending operations on the Waitable will be ignored.
+		this->registrations.erase(r);
+		--l->numWaitables;
+
+		EventLoop* caller = this->LoopOfThisThread();
+
+		if(caller == l){
+			l->RemoveLocal(w);
+		}else if(caller){
+			//Blocking would deadlock if the owning event loop is removing a Waitable owned by
+			//the calling event loop at the same time, so remove asynchronously and notify
+			//the calling event loop when done.
+			Waitable* pw = &w;
+			T_RemovedHandler h = std::move(removedHandler);
+			l->PushMessage([l, pw, caller, h]()mutable{
+				l->RemoveLocal(*pw);
+				if(h){
+					caller->PushMessage(std::move(h));
+				}
+			});
+			return true;
+		}else{
+			Waitable* pw = &w;
+			Semaphore* ps = &sema;
+			l->PushMessage([l, pw, ps](){
+				l->RemoveLocal(*pw);
+				ps->Signal();
+			});
+			wait = true;
+		}
+	}
+
+	if(wait){
+		sema.Wait();
+	}
+
+	if(removedHandler){
+		removedHandler();
+	}
+	return true;
+}
+
+
+
+void EventLoopPool::Migrate(Waitable& w, unsigned toLoop){
+	std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+
+	if(toLoop >= this->loops.size()){
+		throw Exc("EventLoopPool::Migrate(): destination event loop index is out of range");
+	}
+
+	auto r = this->registrations.find(&w);
+	if(r == this->registrations.end()){
+		throw Exc("EventLoopPool::Migrate(): Waitable is not added to the pool");
+	}
+
+	if(r->second.loop == toLoop){
+		return;
+	}
+
+	EventLoop* l = this->loops[r->second.loop].get();
+	Waitable* pw = &w;
+	l->PushMessage([l, pw, toLoop](){l->MigrateLocal(*pw, toLoop);});
+}
+
+
+
+void EventLoopPool::Rebalance(){
+	std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+
+	if(this->loops.size() < 2){
+		return;
+	}
+
+	std::vector<std::uint32_t> load(this->loops.size());
+	for(unsigned i = 0; i != this->loops.size(); ++i){
+		load[i] = this->loops[i]->numEvents.exchange(0);
+	}
+
+	unsigned busiest = unsigned(std::max_element(load.begin(), load.end()) - load.begin());
+	unsigned idlest = unsigned(std::min_element(load.begin(), load.end()) - load.begin());
+
+	//move half of the difference, so that both loops get approximately equal load
+	std::uint32_t numEventsToMove = (load[busiest] - load[idlest]) / 2;
+
+	for(unsigned i = 0; i != this->loops.size(); ++i){
+		EventLoop* l = this->loops[i].get();
+		if(i == busiest){
+			l->PushMessage([l, idlest, numEventsToMove](){l->ShedLocal(idlest, numEventsToMove);});
+		}else{
+			//just reset the per-Waitable counters
+			l->PushMessage([l](){l->ShedLocal(0, 0);});
+		}
+	}
+}
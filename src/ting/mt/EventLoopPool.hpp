@@ -0,0 +1,291 @@
+/* The MIT License:
+
+Copyright (c) 2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+
+
+/**
+ * @author Ivan Gagis <igagis@gmail.com>
+ */
+
+#pragma once
+
+#include "../config.hpp"
+#include "../debug.hpp"
+#include "../WaitSet.hpp"
+#include "../timer.hpp"
+
+#include "MsgThread.hpp"
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <functional>
+
+
+namespace ting{
+namespace mt{
+
+
+
+/**
+ * @brief Pool of event loops.
+ * The pool runs a number of threads, each of those threads runs its own event loop,
+ * i.e. waits on its own WaitSet and calls handlers of the triggered Waitables.
+ * Each Waitable added to the pool is assigned to one of the event loops, the one which
+ * has the least number of Waitables at the moment of adding. Later, the Waitable can be
+ * migrated to another event loop, either explicitly by Migrate() or by Rebalance()
+ * which moves the most active Waitables from the busiest loop to the least busy one.
+ * All the operations on the Waitable are performed by its event loop thread, so
+ * Add(), Change(), Migrate() and Rebalance() do not wait for the operation to complete.
+ * The Waitable handler is called from the event loop thread the Waitable is currently assigned to.
+ * Because the Waitable may migrate between loops, the handler should not rely on being
+ * called from the same thread every time.
+ * Each event loop has its own timer queue attached to its thread, so timers started from within
+ * the handlers with Timer::Start(*ting::timer::TimerQueue::OfThisThread(), millisec) expire in the
+ * same event loop thread, see ting::timer::TimerQueue::AttachToThisThread(). Such timers should be
+ * stopped before destroying the pool. Timers started with ting::timer::Timer::Start(std::uint32_t)
+ * are run by the timer library as usual.
+ */
+class EventLoopPool{
+public:
+	/**
+	 * @brief Waitable handler.
+	 * Called from the event loop thread when the Waitable has triggered.
+	 */
+	typedef std::function<void(Waitable&)> T_Handler;
+
+	/**
+	 * @brief Failure handler.
+	 * Called from the event loop thread when the Waitable could not be added to the WaitSet
+	 * of the event loop, either when it is added to the pool or when it migrates to another event loop.
+	 * At that moment the Waitable is already removed from the pool.
+	 * The first argument is the Waitable, the second one is the exception thrown by WaitSet.
+	 */
+	typedef std::function<void(Waitable&, const ting::Exc&)> T_FailureHandler;
+
+	/**
+	 * @brief Removal completion handler.
+	 * Called when the Waitable has been removed from its event loop, see Remove().
+	 */
+	typedef std::function<void()> T_RemovedHandler;
+
+	/**
+	 * @brief Basic exception type thrown by EventLoopPool class.
+	 */
+	class Exc : public ting::Exc{
+	public:
+		Exc(const std::string& message = std::string()) :
+				ting::Exc(message)
+		{}
+	};
+
+private:
+	class EventLoop : public MsgThread{
+		friend class EventLoopPool;
+
+		EventLoopPool& pool;
+
+		const unsigned index;
+
+		WaitSet waitSet;
+
+		ting::timer::TimerQueue timerQueue;
+
+		struct Entry{
+			T_Handler handler;
+			T_FailureHandler failureHandler;
+			std::uint32_t numEvents = 0;//number of triggerings since last rebalancing
+		};
+
+		//accessed only from this event loop thread
+		std::map<Waitable*, Entry> entries;
+
+		//number of Waitables assigned to this loop, including the ones which are not added yet
+		std::atomic<unsigned> numWaitables;
+
+		//number of triggered Waitables since last rebalancing
+		std::atomic<std::uint32_t> numEvents;
+
+		std::atomic<T_ThreadID> threadID;
+
+		//Waitable which handler is being called at the moment
+		Waitable* dispatching = nullptr;
+
+		//set if the Waitable was removed from within its own handler,
+		//its entry is erased after the handler returns
+		bool dispatchingRemoved = false;
+
+		EventLoop(EventLoopPool& pool, unsigned index);
+
+		void Run()override;
+
+		void AddLocal(Waitable& w);
+
+		void ChangeLocal(Waitable& w);
+
+		bool RemoveLocal(Waitable& w)NOEXCEPT;
+
+		void MigrateLocal(Waitable& w, unsigned toLoop);
+
+		void ShedLocal(unsigned toLoop, std::uint32_t numEventsToMove);
+
+		//Move the Waitable to another event loop, the mutex should be locked.
+		void HandOver(Waitable& w, unsigned toLoop);
+	};
+
+	struct Registration{
+		unsigned loop;
+		Waitable::EReadinessFlags flags;
+
+		//Set while the Waitable is waiting to be added to the WaitSet of its event loop.
+		//The handlers are passed to the event loop through the registration, because
+		//they do not fit into the message.
+		bool adding = false;
+		T_Handler handler;
+		T_FailureHandler failureHandler;
+	};
+
+	//get event loop run by the calling thread, nullptr if the calling thread is not an event loop of this pool
+	EventLoop* LoopOfThisThread()NOEXCEPT;
+
+	//protects 'registrations' and ordering of messages pushed to event loops
+	std::mutex mutex;
+
+	std::map<Waitable*, Registration> registrations;
+
+	std::vector<std::unique_ptr<EventLoop>> loops;
+
+public:
+	/**
+	 * @brief Constructor.
+	 * Creates and starts the event loop threads.
+	 * @param numLoops - number of event loops to run. If 0 then the number of
+	 *                   loops will be equal to the number of CPU cores the process is allowed to run on.
+	 * @param pinToCPUs - if true then each event loop thread will be pinned to its own
+	 *                    CPU core, i.e. i-th loop will run on (i % number of cores)-th core of
+	 *                    the ones the process is allowed to run on (see sched_getaffinity() on Linux
+	 *                    and GetProcessAffinityMask() on Windows).
+	 *                    Pinning is supported on Linux and Windows, on other systems this parameter is ignored.
+	 */
+	EventLoopPool(unsigned numLoops = 0, bool pinToCPUs = true);
+
+	EventLoopPool(const EventLoopPool&) = delete;
+	EventLoopPool& operator=(const EventLoopPool&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * Stops and joins all the event loop threads.
+	 * All the Waitables should be removed from the pool before destroying the pool.
+	 */
+	~EventLoopPool()NOEXCEPT;
+
+	/**
+	 * @brief Get number of event loops.
+	 * @return number of event loops in this pool.
+	 */
+	unsigned NumLoops()const NOEXCEPT{
+		return unsigned(this->loops.size());
+	}
+
+	/**
+	 * @brief Get number of Waitables assigned to event loop.
+	 * @param loop - index of the event loop.
+	 * @return number of Waitables currently assigned to the event loop.
+	 */
+	unsigned NumWaitables(unsigned loop)const NOEXCEPT{
+		ASSERT(loop < this->loops.size())
+		return this->loops[loop]->numWaitables;
+	}
+
+	/**
+	 * @brief Add Waitable to the pool.
+	 * Assigns the Waitable to the event loop with the least number of Waitables.
+	 * The Waitable is added to the WaitSet of that event loop asynchronously.
+	 * If adding to the WaitSet fails, the Waitable is removed from the pool and the failure
+	 * handler is called. If the failure handler is not set, then the handler is called
+	 * instead, with the error flag of the Waitable set, see Waitable::ErrorCondition().
+	 * @param w - Waitable to add.
+	 * @param flagsToWaitFor - events to wait for.
+	 * @param handler - handler to call when the Waitable triggers.
+	 * @param failureHandler - handler to call if the Waitable could not be added to the event loop.
+	 * @return index of the event loop the Waitable was assigned to.
+	 * @throw ting::mt::EventLoopPool::Exc - if the Waitable is already added to the pool or,
+	 *         on Windows, all event loops are full (MAXIMUM_WAIT_OBJECTS limit).
+	 */
+	unsigned Add(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor, T_Handler&& handler, T_FailureHandler&& failureHandler = T_FailureHandler());
+
+	/**
+	 * @brief Change wait flags for a Waitable.
+	 * The change is applied asynchronously by the event loop which owns the Waitable.
+	 * @param w - Waitable added to this pool.
+	 * @param flagsToWaitFor - new wait flags.
+	 * @throw ting::mt::EventLoopPool::Exc - if the Waitable is not added to the pool.
+	 */
+	void Change(Waitable& w, Waitable::EReadinessFlags flagsToWaitFor);
+
+	/**
+	 * @brief Remove Waitable from the pool.
+	 * If called from the event loop thread which owns the Waitable (e.g. from the Waitable handler),
+	 * then the Waitable is removed immediately.
+	 * If called from a thread which is not an event loop of this pool, then this method blocks
+	 * until the owning event loop removes the Waitable from its WaitSet.
+	 * In both cases, after this method has returned the handler of the Waitable will not be
+	 * called anymore, so it is safe to destroy the Waitable, and the removal completion
+	 * handler, if set, is called before returning.
+	 * If called from another event loop of this pool, then the removal is asynchronous,
+	 * because two event loops waiting for each other would deadlock. In that case the method
+	 * returns right away and the removal completion handler is called from the calling event
+	 * loop thread once the Waitable has been removed, only after that it is safe to destroy the Waitable.
+	 * @param w - Waitable to remove.
+	 * @param removedHandler - handler to call when the Waitable has been removed.
+	 * @return true if the Waitable was removed or, in asynchronous case, its removal has been initiated.
+	 * @return false if the Waitable was not added to the pool.
+	 */
+	bool Remove(Waitable& w, T_RemovedHandler&& removedHandler = T_RemovedHandler());
+
+	/**
+	 * @brief Move Waitable to another event loop.
+	 * The migration is done asynchronously.
+	 * @param w - Waitable added to this pool.
+	 * @param toLoop - index of the destination event loop.
+	 * @throw ting::mt::EventLoopPool::Exc - if the Waitable is not added to the pool.
+	 */
+	void Migrate(Waitable& w, unsigned toLoop);
+
+	/**
+	 * @brief Rebalance the load between event loops.
+	 * Finds the busiest and the least busy event loops in terms of number of triggered
+	 * Waitables since the last rebalancing and migrates the most active Waitables
+	 * from the busiest event loop to the least busy one, so that the load gets evened out.
+	 * It is supposed that this method is called periodically, for example, from a timer.
+	 */
+	void Rebalance();
+};
+
+
+
+}//~namespace
+}//~namespace
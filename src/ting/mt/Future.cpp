@@ -0,0 +1,238 @@
+/* The MIT License:
+
+Copyright (c) 2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+#include "Future.hpp"
+
+#include <chrono>
+
+#if M_OS == M_OS_LINUX
+#	include <sys/eventfd.h>
+#elif M_OS == M_OS_MACOSX
+#	include <unistd.h>
+#endif
+
+
+using namespace ting::mt;
+
+
+
+FutureBase::StateBase::~StateBase()NOEXCEPT{
+	ASSERT(this->numWaiters.load() == 0)
+
+	if(!this->hasEvent.load(std::memory_order_relaxed)){
+		return;
+	}
+
+#if M_OS == M_OS_WINDOWS
+	CloseHandle(this->event);
+#elif M_OS == M_OS_LINUX
+	close(this->eventFD);
+#elif M_OS == M_OS_MACOSX
+	close(this->pipeEnds[0]);
+	close(this->pipeEnds[1]);
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+void FutureBase::StateBase::SetReady()NOEXCEPT{
+	//The ready flag is set before checking for waiters and the event, while the waiters
+	//and the event creator do it in the opposite order, all sequentially consistent,
+	//so either this thread sees there is something to wake up, or the other thread sees the flag.
+	this->ready.store(true, std::memory_order_seq_cst);
+
+	if(this->numWaiters.load(std::memory_order_seq_cst) == 0 && !this->hasEvent.load(std::memory_order_seq_cst)){
+		return;
+	}
+
+	std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+	this->cv.notify_all();
+	if(this->hasEvent.load(std::memory_order_relaxed)){
+		this->SignalEvent();
+	}
+}
+
+
+
+void FutureBase::StateBase::SignalEvent()NOEXCEPT{
+#if M_OS == M_OS_WINDOWS
+	if(SetEvent(this->event) == 0){
+		ASSERT(false)
+	}
+#elif M_OS == M_OS_LINUX
+	if(eventfd_write(this->eventFD, 1) < 0){
+		ASSERT(false)
+	}
+#elif M_OS == M_OS_MACOSX
+	std::uint8_t oneByteBuf[1] = {0};
+	if(write(this->pipeEnds[1], oneByteBuf, 1) != 1){
+		ASSERT(false)
+	}
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+FutureBase::StateBase::T_Handle FutureBase::StateBase::GetEvent(){
+	std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+
+	if(!this->hasEvent.load(std::memory_order_relaxed)){
+		this->CreateEventObject();
+
+		this->hasEvent.store(true, std::memory_order_seq_cst);
+
+		//the result might have been set before the event was created
+		if(this->ready.load(std::memory_order_seq_cst)){
+			this->SignalEvent();
+		}
+	}
+
+#if M_OS == M_OS_WINDOWS
+	return this->event;
+#elif M_OS == M_OS_LINUX
+	return this->eventFD;
+#elif M_OS == M_OS_MACOSX
+	return this->pipeEnds[0];
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+void FutureBase::StateBase::CreateEventObject(){
+#if M_OS == M_OS_WINDOWS
+	this->event = CreateEvent(
+			NULL, //security attributes
+			TRUE, //manual-reset
+			FALSE, //not signalled initially
+			NULL //no name
+		);
+	if(this->event == NULL){
+		throw Exc("Future: could not create event (Win32) for implementing Waitable");
+	}
+#elif M_OS == M_OS_LINUX
+	this->eventFD = eventfd(0, EFD_CLOEXEC);
+	if(this->eventFD < 0){
+		std::stringstream ss;
+		ss << "Future: could not create eventfd (*nix) for implementing Waitable,"
+				<< " error code = " << errno << ": " << strerror(errno);
+		throw Exc(ss.str());
+	}
+#elif M_OS == M_OS_MACOSX
+	if(::pipe(&this->pipeEnds[0]) < 0){
+		std::stringstream ss;
+		ss << "Future: could not create pipe (*nix) for implementing Waitable,"
+				<< " error code = " << errno << ": " << strerror(errno);
+		throw Exc(ss.str());
+	}
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+void FutureBase::Wait()const{
+	ASSERT(this->IsValid())
+	if(this->IsReady()){
+		return;
+	}
+
+	StateBase& s = *this->state;
+
+	std::unique_lock<decltype(s.mutex)> lock(s.mutex);
+	s.numWaiters.fetch_add(1, std::memory_order_seq_cst);
+	s.cv.wait(lock, [&s](){return s.ready.load(std::memory_order_seq_cst);});
+	s.numWaiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+
+
+bool FutureBase::WaitWithTimeout(std::uint32_t timeout)const{
+	ASSERT(this->IsValid())
+	if(this->IsReady()){
+		return true;
+	}
+
+	StateBase& s = *this->state;
+
+	std::unique_lock<decltype(s.mutex)> lock(s.mutex);
+	s.numWaiters.fetch_add(1, std::memory_order_seq_cst);
+	bool ret = s.cv.wait_for(
+			lock,
+			std::chrono::milliseconds(timeout),
+			[&s](){return s.ready.load(std::memory_order_seq_cst);}
+		);
+	s.numWaiters.fetch_sub(1, std::memory_order_relaxed);
+	return ret;
+}
+
+
+
+#if M_OS == M_OS_WINDOWS
+//override
+HANDLE FutureBase::GetHandle(){
+	ASSERT(this->IsValid())
+	return this->state->GetEvent();
+}
+
+
+
+//override
+void FutureBase::SetWaitingEvents(std::uint32_t flagsToWaitFor){
+	//Only possible flag values are READ and 0 (NOT_READY)
+	if(flagsToWaitFor != 0 && flagsToWaitFor != ting::Waitable::READ){
+		ASSERT_INFO(false, "flagsToWaitFor = " << flagsToWaitFor)
+		throw ting::Exc("Future::SetWaitingEvents(): flagsToWaitFor should be ting::Waitable::READ or 0, other values are not allowed");
+	}
+
+	this->flagsMask = flagsToWaitFor;
+}
+
+
+
+//returns true if signaled
+//override
+bool FutureBase::CheckSignaled(){
+	if(this->IsValid() && this->IsReady()){
+		this->SetCanReadFlag();
+	}
+	return (this->readinessFlags & this->flagsMask) != 0;
+}
+
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX
+//override
+int FutureBase::GetHandle(){
+	ASSERT(this->IsValid())
+	return this->state->GetEvent();
+}
+
+#else
+#	error "Unsupported OS"
+#endif
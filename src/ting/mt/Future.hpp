@@ -0,0 +1,433 @@
+/* The MIT License:
+
+Copyright (c) 2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+
+
+/**
+ * @author Ivan Gagis <igagis@gmail.com>
+ */
+
+#pragma once
+
+#include "../config.hpp"
+#include "../debug.hpp"
+#include "../util.hpp"
+#include "../Exc.hpp"
+#include "../WaitSet.hpp"
+
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <utility>
+#include <exception>
+#include <type_traits>
+#include <condition_variable>
+
+
+namespace ting{
+namespace mt{
+
+
+
+template <class T> class Promise;
+
+class ThreadPool;
+
+
+
+/**
+ * @brief Non-template part of Future.
+ * Contains the result readiness synchronization and implements the Waitable interface of the future.
+ */
+class FutureBase : public Waitable{
+	friend class ThreadPool;
+
+public:
+	/**
+	 * @brief Basic exception type thrown by Future and Promise classes.
+	 */
+	class Exc : public ting::Exc{
+	public:
+		Exc(const std::string& message = std::string()) :
+				ting::Exc(message)
+		{}
+	};
+
+protected:
+	struct StateBase{
+		std::atomic<bool> ready;
+
+		//used only for blocking waits
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::atomic<unsigned> numWaiters;
+
+		std::exception_ptr exception;
+
+		//Event for waiting on the future with WaitSet. It is created when the
+		//future is added to a WaitSet for the first time, see GetEvent().
+		std::atomic<bool> hasEvent;
+#if M_OS == M_OS_WINDOWS
+		HANDLE event = NULL;
+#elif M_OS == M_OS_LINUX
+		int eventFD = -1;
+#elif M_OS == M_OS_MACOSX
+		int pipeEnds[2] = {-1, -1};
+#else
+#	error "Unsupported OS"
+#endif
+
+		StateBase()NOEXCEPT :
+				ready(false),
+				numWaiters(0),
+				hasEvent(false)
+		{}
+
+		StateBase(const StateBase&) = delete;
+		StateBase& operator=(const StateBase&) = delete;
+
+		~StateBase()NOEXCEPT;
+
+		//Sets the ready flag and wakes up the waiters. Does not lock the mutex
+		//unless there are threads waiting or the event is created.
+		void SetReady()NOEXCEPT;
+
+#if M_OS == M_OS_WINDOWS
+		typedef HANDLE T_Handle;
+#else
+		typedef int T_Handle;
+#endif
+
+		//creates the event if it is not created yet
+		T_Handle GetEvent();
+
+	private:
+		void CreateEventObject();
+
+		void SignalEvent()NOEXCEPT;
+	};
+
+	std::shared_ptr<StateBase> state;
+
+	FutureBase()NOEXCEPT{}
+
+	FutureBase(std::shared_ptr<StateBase>&& state)NOEXCEPT :
+			state(std::move(state))
+	{}
+
+	FutureBase(FutureBase&&) = default;
+	FutureBase& operator=(FutureBase&&) = default;
+
+public:
+	/**
+	 * @brief Check if the future is valid.
+	 * Future is valid if it was obtained from a promise and the result was not retrieved yet.
+	 * @return true if the future is valid.
+	 */
+	bool IsValid()const NOEXCEPT{
+		return this->state.operator bool();
+	}
+
+	/**
+	 * @brief Check if the result is ready.
+	 * @return true if the result is ready, i.e. Get() will not block.
+	 */
+	bool IsReady()const NOEXCEPT{
+		ASSERT(this->IsValid())
+		return this->state->ready.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * @brief Wait until the result is ready.
+	 */
+	void Wait()const;
+
+	/**
+	 * @brief Wait until the result is ready or timeout is hit.
+	 * @param timeout - maximum time in milliseconds to wait.
+	 * @return true if the result is ready.
+	 * @return false if timeout was hit.
+	 */
+	bool WaitWithTimeout(std::uint32_t timeout)const;
+
+private:
+#if M_OS == M_OS_WINDOWS
+	std::uint32_t flagsMask = NOT_READY;//flags to wait for
+
+	HANDLE GetHandle()override;
+
+	void SetWaitingEvents(std::uint32_t flagsToWaitFor)override;
+
+	//returns true if signaled
+	bool CheckSignaled()override;
+
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX
+	int GetHandle()override;
+
+#else
+#	error "Unsupported OS"
+#endif
+};
+
+
+
+/**
+ * @brief Result of asynchronous operation.
+ * Future is a lightweight counterpart of std::future. It is obtained from a Promise and
+ * becomes ready when the promise is fulfilled, i.e. when a value or an exception is set
+ * to it. The future and its promise share a single reference counted state, setting
+ * the result does not involve any locking unless some thread is blocked waiting for it
+ * or the future has been added to a WaitSet.
+ * Future is a Waitable, so it can be waited for with WaitSet along with other Waitables.
+ * It should be added to the WaitSet with READ flag, when the result becomes ready the
+ * future becomes readable and stays readable until it is removed from the WaitSet.
+ * The future should be removed from the WaitSet before getting the result.
+ * Future is move-only, the result can be retrieved only once, see Get().
+ * @param T - type of the result value, can be void.
+ */
+template <class T> class Future : public FutureBase{
+	friend class Promise<T>;
+
+	template <class T_Value> struct ValueHolder{
+		typename std::aligned_storage<sizeof(T_Value), alignof(T_Value)>::type storage;
+		bool isSet = false;
+
+		T_Value& Get()NOEXCEPT{
+			return *reinterpret_cast<T_Value*>(&this->storage);
+		}
+
+		template <class T_Arg> void Set(T_Arg&& v){
+			new(&this->storage) T_Value(std::forward<T_Arg>(v));
+			this->isSet = true;
+		}
+
+		~ValueHolder()NOEXCEPT{
+			if(this->isSet){
+				this->Get().~T_Value();
+			}
+		}
+	};
+
+	template <class T_Value> struct ValueHolder<T_Value&>{
+		T_Value* ptr = nullptr;
+
+		T_Value& Get()NOEXCEPT{
+			return *this->ptr;
+		}
+
+		void Set(T_Value& v)NOEXCEPT{
+			this->ptr = &v;
+		}
+	};
+
+	struct Void{};
+
+	typedef typename std::conditional<std::is_void<T>::value, Void, T>::type T_Stored;
+
+	struct State : public StateBase{
+		ValueHolder<T_Stored> value;
+	};
+
+	Future(std::shared_ptr<State> state) :
+			FutureBase(std::move(state))
+	{}
+
+public:
+	/**
+	 * @brief Create invalid future.
+	 */
+	Future()NOEXCEPT{}
+
+	Future(Future&&) = default;
+	Future& operator=(Future&&) = default;
+
+	Future(const Future&) = delete;
+	Future& operator=(const Future&) = delete;
+
+	/**
+	 * @brief Get the result.
+	 * Waits until the result is ready and returns it. After that the future becomes invalid.
+	 * @return the result value.
+	 * @throw any exception which was set to the promise instead of the value.
+	 */
+	T Get(){
+		ASSERT_INFO(!this->IsAdded(), "Future::Get(): remove the future from WaitSet before getting the result")
+		this->Wait();
+
+		std::shared_ptr<StateBase> s = std::move(this->state);
+		if(s->exception){
+			std::rethrow_exception(s->exception);
+		}
+		return static_cast<T>(Cast(static_cast<State&>(*s).value));
+	}
+
+private:
+	static void Cast(ValueHolder<Void>&)NOEXCEPT{}
+
+	template <class T_Value> static T_Value&& Cast(ValueHolder<T_Value>& v)NOEXCEPT{
+		return std::move(v.Get());
+	}
+
+	template <class T_Value> static T_Value& Cast(ValueHolder<T_Value&>& v)NOEXCEPT{
+		return v.Get();
+	}
+};
+
+
+
+/**
+ * @brief Promise to provide a result of asynchronous operation.
+ * The result is delivered to the Future obtained from the promise.
+ * If the promise is destroyed without the result being set, the future
+ * gets Future<T>::Exc exception as the result.
+ * @param T - type of the result value, can be void.
+ */
+template <class T> class Promise{
+	typedef typename Future<T>::State T_State;
+
+	std::shared_ptr<T_State> state;
+
+	bool futureRetrieved = false;
+
+public:
+	/**
+	 * @brief Create promise.
+	 */
+	Promise() :
+			state(std::make_shared<T_State>())
+	{}
+
+	Promise(Promise&&) = default;
+
+	Promise(const Promise&) = delete;
+	Promise& operator=(const Promise&) = delete;
+
+	Promise& operator=(Promise&& p){
+		this->Abandon();
+		this->state = std::move(p.state);
+		this->futureRetrieved = p.futureRetrieved;
+		return *this;
+	}
+
+	~Promise()NOEXCEPT{
+		this->Abandon();
+	}
+
+	/**
+	 * @brief Get future associated with this promise.
+	 * Can be called only once.
+	 * @return future.
+	 * @throw Future<T>::Exc - if the future was already retrieved.
+	 */
+	Future<T> GetFuture(){
+		ASSERT(this->state)
+		if(this->futureRetrieved){
+			throw typename Future<T>::Exc("Promise::GetFuture(): future was already retrieved");
+		}
+		this->futureRetrieved = true;
+		return Future<T>(this->state);
+	}
+
+	/**
+	 * @brief Set the result value.
+	 * Makes the future ready.
+	 * @param v - the result value.
+	 */
+	template <class T_Arg> void SetValue(T_Arg&& v){
+		this->CheckNotSet();
+		this->state->value.Set(std::forward<T_Arg>(v));
+		this->state->SetReady();
+	}
+
+	/**
+	 * @brief Set the result of void promise.
+	 * Makes the future ready.
+	 */
+	void SetValue(){
+		static_assert(std::is_void<T>::value, "Promise::SetValue(): value should be given for non-void promise");
+		this->CheckNotSet();
+		this->state->SetReady();
+	}
+
+	/**
+	 * @brief Set exception as the result.
+	 * Makes the future ready, the exception will be thrown by Future::Get().
+	 * @param e - the exception.
+	 */
+	void SetException(std::exception_ptr e){
+		this->CheckNotSet();
+		this->state->exception = std::move(e);
+		this->state->SetReady();
+	}
+
+	/**
+	 * @brief Call a function and set its result as the result of the promise.
+	 * If the function throws, the exception is set as the result.
+	 * @param f - function to call.
+	 */
+	template <class T_Function> void SetResultOf(T_Function& f)NOEXCEPT{
+		try{
+			this->CallAndSet(f, std::is_void<T>());
+		}catch(...){
+			this->SetException(std::current_exception());
+		}
+	}
+
+private:
+	template <class T_Function> void CallAndSet(T_Function& f, std::false_type){
+		this->SetValue(f());
+	}
+
+	template <class T_Function> void CallAndSet(T_Function& f, std::true_type){
+		f();
+		this->SetValue();
+	}
+
+	void CheckNotSet(){
+		ASSERT(this->state)
+		if(this->state->ready.load(std::memory_order_relaxed)){
+			throw typename Future<T>::Exc("Promise: result is already set");
+		}
+	}
+
+	void Abandon()NOEXCEPT{
+		if(!this->state || this->state->ready.load(std::memory_order_relaxed)){
+			return;
+		}
+		if(!this->futureRetrieved){
+			return;
+		}
+		try{
+			throw typename Future<T>::Exc("Promise: promise was destroyed without setting the result");
+		}catch(...){
+			this->state->exception = std::current_exception();
+		}
+		this->state->SetReady();
+	}
+};
+
+
+
+}//~namespace
+}//~namespace
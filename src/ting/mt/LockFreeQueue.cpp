@@ -0,0 +1,269 @@
+/* The MIT License:
+
+Copyright (c) 2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+#include "LockFreeQueue.hpp"
+
+#if M_OS == M_OS_LINUX
+#	include <sys/eventfd.h>
+#elif M_OS == M_OS_MACOSX
+#	include <fcntl.h>
+#endif
+
+
+using namespace ting::mt;
+
+
+
+LockFreeQueue::LockFreeQueue(std::size_t capacity) :
+		mask([capacity](){
+			std::size_t c = 2;
+			while(c < capacity){
+				c <<= 1;
+			}
+			return c - 1;
+		}()),
+		cells(new Cell[this->mask + 1]),
+		enqueuePos(0),
+		numMessages(0)
+{
+	ASSERT(capacity != 0)
+
+	//Each cell holds the position it is ready to be written at. After writing, the sequence
+	//is set to position + 1, which means the cell is ready for reading, and after reading it
+	//is set to position + capacity, i.e. the position of the next write to the cell.
+	for(std::size_t i = 0; i != this->Capacity(); ++i){
+		this->cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+#if M_OS == M_OS_WINDOWS
+	this->eventForWaitable = CreateEvent(
+			NULL, //security attributes
+			TRUE, //manual-reset
+			FALSE, //not signalled initially
+			NULL //no name
+		);
+	if(this->eventForWaitable == NULL){
+		throw ting::Exc("LockFreeQueue::LockFreeQueue(): could not create event (Win32) for implementing Waitable");
+	}
+#elif M_OS == M_OS_MACOSX
+	if(::pipe(&this->pipeEnds[0]) < 0){
+		std::stringstream ss;
+		ss << "LockFreeQueue::LockFreeQueue(): could not create pipe (*nix) for implementing Waitable,"
+				<< " error code = " << errno << ": " << strerror(errno);
+		throw ting::Exc(ss.str().c_str());
+	}
+	//the queue can be signalled more than once, so the read end of the pipe is drained
+	//until it is empty, for that it needs to be non-blocking
+	if(fcntl(this->pipeEnds[0], F_SETFL, O_NONBLOCK) < 0 || fcntl(this->pipeEnds[1], F_SETFL, O_NONBLOCK) < 0){
+		close(this->pipeEnds[0]);
+		close(this->pipeEnds[1]);
+		throw ting::Exc("LockFreeQueue::LockFreeQueue(): could not set pipe to non-blocking mode");
+	}
+#elif M_OS == M_OS_LINUX
+	this->eventFD = eventfd(0, EFD_NONBLOCK);
+	if(this->eventFD < 0){
+		std::stringstream ss;
+		ss << "LockFreeQueue::LockFreeQueue(): could not create eventfd (linux) for implementing Waitable,"
+				<< " error code = " << errno << ": " << strerror(errno);
+		throw ting::Exc(ss.str().c_str());
+	}
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+LockFreeQueue::~LockFreeQueue()NOEXCEPT{
+#if M_OS == M_OS_WINDOWS
+	CloseHandle(this->eventForWaitable);
+#elif M_OS == M_OS_MACOSX
+	close(this->pipeEnds[0]);
+	close(this->pipeEnds[1]);
+#elif M_OS == M_OS_LINUX
+	close(this->eventFD);
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+void LockFreeQueue::Signal()NOEXCEPT{
+#if M_OS == M_OS_WINDOWS
+	if(SetEvent(this->eventForWaitable) == 0){
+		ASSERT(false)
+	}
+#elif M_OS == M_OS_MACOSX
+	{
+		std::uint8_t oneByteBuf[1] = {0};
+		if(write(this->pipeEnds[1], oneByteBuf, 1) != 1){
+			ASSERT(false)
+		}
+	}
+#elif M_OS == M_OS_LINUX
+	if(eventfd_write(this->eventFD, 1) < 0){
+		ASSERT(false)
+	}
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+void LockFreeQueue::ClearSignal()NOEXCEPT{
+#if M_OS == M_OS_WINDOWS
+	if(ResetEvent(this->eventForWaitable) == 0){
+		ASSERT(false)
+	}
+#elif M_OS == M_OS_MACOSX
+	{
+		std::uint8_t buf[16];
+		while(read(this->pipeEnds[0], buf, sizeof(buf)) > 0){}
+	}
+#elif M_OS == M_OS_LINUX
+	{
+		//reading resets eventfd counter to 0, it fails with EAGAIN if the counter is already 0
+		eventfd_t value;
+		eventfd_read(this->eventFD, &value);
+	}
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+bool LockFreeQueue::PushMessage(T_Message&& msg)NOEXCEPT{
+	Cell* cell;
+	std::size_t pos = this->enqueuePos.load(std::memory_order_relaxed);
+	for(;;){
+		cell = &this->cells[pos & this->mask];
+		std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+		std::ptrdiff_t diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+		if(diff == 0){
+			//the cell is free, try to occupy it
+			if(this->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+				break;
+			}
+			//'pos' is updated by compare_exchange_weak() in case of failure
+		}else if(diff < 0){
+			//the cell still holds the message pushed one lap ago, the queue is full
+			return false;
+		}else{
+			//other producer has occupied the cell
+			pos = this->enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->msg = std::move(msg);
+	cell->sequence.store(pos + 1, std::memory_order_release);
+
+	//signal only when the queue goes from empty to non-empty
+	if(this->numMessages.fetch_add(1, std::memory_order_acq_rel) == 0){
+		this->Signal();
+	}
+	return true;
+}
+
+
+
+LockFreeQueue::T_Message LockFreeQueue::PeekMsg(){
+	Cell* cell = &this->cells[this->dequeuePos & this->mask];
+	std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+	if(seq != this->dequeuePos + 1){
+		//no message or the message is not completely pushed yet
+		return nullptr;
+	}
+
+	T_Message ret = std::move(cell->msg);
+	cell->msg = nullptr;
+	cell->sequence.store(this->dequeuePos + this->Capacity(), std::memory_order_release);
+	++this->dequeuePos;
+
+	if(this->numMessages.fetch_sub(1, std::memory_order_acq_rel) == 1){
+		//The queue has become empty, clear the signal. Some producer could have pushed a message
+		//and signalled after the counter was decremented but before the signal was cleared,
+		//so check the counter again and signal back if needed.
+		this->ClearCanReadFlag();
+		this->ClearSignal();
+		if(this->numMessages.load(std::memory_order_acquire) > 0){
+			this->Signal();
+		}
+	}
+
+	return ret;
+}
+
+
+
+#if M_OS == M_OS_WINDOWS
+//override
+HANDLE LockFreeQueue::GetHandle(){
+	//return event handle
+	return this->eventForWaitable;
+}
+
+
+
+//override
+void LockFreeQueue::SetWaitingEvents(std::uint32_t flagsToWaitFor){
+	//Only possible flag values are READ and 0 (NOT_READY)
+	if(flagsToWaitFor != 0 && flagsToWaitFor != ting::Waitable::READ){
+		ASSERT_INFO(false, "flagsToWaitFor = " << flagsToWaitFor)
+		throw ting::Exc("LockFreeQueue::SetWaitingEvents(): flagsToWaitFor should be ting::Waitable::READ or 0, other values are not allowed");
+	}
+
+	this->flagsMask = flagsToWaitFor;
+}
+
+
+
+//returns true if signaled
+//override
+bool LockFreeQueue::CheckSignaled(){
+	//producers do not touch readiness flags, so set CanRead flag here
+	if(this->numMessages.load(std::memory_order_acquire) > 0){
+		this->SetCanReadFlag();
+	}
+	return (this->readinessFlags & this->flagsMask) != 0;
+}
+
+#elif M_OS == M_OS_MACOSX
+//override
+int LockFreeQueue::GetHandle(){
+	//return read end of pipe
+	return this->pipeEnds[0];
+}
+
+#elif M_OS == M_OS_LINUX
+//override
+int LockFreeQueue::GetHandle(){
+	return this->eventFD;
+}
+
+#else
+#	error "Unsupported OS"
+#endif
@@ -0,0 +1,192 @@
+/* The MIT License:
+
+Copyright (c) 2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+
+
+/**
+ * @author Ivan Gagis <igagis@gmail.com>
+ */
+
+#pragma once
+
+#include "../config.hpp"
+#include "../debug.hpp"
+#include "../WaitSet.hpp"
+#include "../util.hpp"
+#include "../InplaceFunction.hpp"
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+
+namespace ting{
+namespace mt{
+
+
+
+/**
+ * @brief Lock-free bounded message queue.
+ * Multi-producer/single-consumer message queue based on a ring buffer of fixed capacity.
+ * Any number of threads can push messages to the queue concurrently, but only one thread
+ * at a time is allowed to get messages from it.
+ * Unlike ting::mt::Queue, pushing a message does not take a lock and does not allocate
+ * memory, the messages are stored right in the ring buffer. Messages are InplaceFunction
+ * objects, so the captured data of the message is also stored in the ring buffer.
+ * The Waitable is signalled only when the queue goes from empty to non-empty state, so
+ * a system call is only made for the first message of a burst.
+ * NOTE: LockFreeQueue implements Waitable interface which means that it can be used in
+ * conjunction with ting::WaitSet, but it shall only be used to wait for READ.
+ * The readiness flags of the queue are only changed by the consumer thread, i.e. by the
+ * thread which waits on the WaitSet and calls PeekMsg().
+ */
+class LockFreeQueue : public ting::Waitable{
+public:
+	/**
+	 * @brief Maximum size of the message callable object, e.g. size of the lambda captures.
+	 */
+	static const std::size_t MAX_MESSAGE_SIZE = 64;
+
+	typedef InplaceFunction<void(), MAX_MESSAGE_SIZE> T_Message;
+
+	/**
+	 * @brief Default capacity of the queue.
+	 */
+	static const std::size_t DEFAULT_CAPACITY = 1024;
+
+private:
+	//size of padding used to place frequently modified variables in separate cache lines,
+	//so that producers and consumer do not invalidate each other's cache lines
+	static const std::size_t DCacheLineSize = 64;
+
+	struct Cell{
+		//sequence number of the cell, tells if the cell is ready for writing or reading
+		std::atomic<std::size_t> sequence;
+		T_Message msg;
+	};
+
+	const std::size_t mask;
+	std::unique_ptr<Cell[]> cells;
+
+	std::uint8_t padding1[DCacheLineSize];
+
+	std::atomic<std::size_t> enqueuePos;//position of the next cell to push to
+
+	std::uint8_t padding2[DCacheLineSize - sizeof(std::atomic<std::size_t>)];
+
+	//number of messages in the queue, it can become negative for a moment when consumer
+	//takes out a message whose producer has not incremented the counter yet
+	std::atomic<std::ptrdiff_t> numMessages;
+
+	std::uint8_t padding3[DCacheLineSize - sizeof(std::atomic<std::ptrdiff_t>)];
+
+	std::size_t dequeuePos = 0;//position of the next cell to get message from, accessed only by consumer
+
+#if M_OS == M_OS_WINDOWS
+	//use Event to implement Waitable on Windows
+	HANDLE eventForWaitable;
+#elif M_OS == M_OS_MACOSX
+	//use pipe to implement Waitable in *nix systems
+	int pipeEnds[2];
+#elif M_OS == M_OS_LINUX
+	//use eventfd()
+	int eventFD;
+#else
+#	error "Unsupported OS"
+#endif
+
+public:
+	/**
+	 * @brief Constructor, creates empty message queue.
+	 * @param capacity - maximum number of messages the queue can hold. It is rounded up
+	 *                   to the nearest power of 2.
+	 */
+	LockFreeQueue(std::size_t capacity = DEFAULT_CAPACITY);
+
+	LockFreeQueue(const LockFreeQueue&) = delete;
+	LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * When called, it also destroys all messages on the queue.
+	 */
+	~LockFreeQueue()NOEXCEPT;
+
+	/**
+	 * @brief Get capacity of the queue.
+	 * @return maximum number of messages the queue can hold.
+	 */
+	std::size_t Capacity()const NOEXCEPT{
+		return this->mask + 1;
+	}
+
+	/**
+	 * @brief Pushes a new message to the queue.
+	 * Can be called from any thread.
+	 * @param msg - the message to push into the queue.
+	 * @return true if the message was pushed.
+	 * @return false if the queue is full, the message is left intact in that case.
+	 */
+	bool PushMessage(T_Message&& msg)NOEXCEPT;
+
+	/**
+	 * @brief Get message from queue, does not block if no messages queued.
+	 * Shall only be called from the consumer thread.
+	 * NOTE: if a producer has started pushing a message but has not finished yet, then
+	 *       messages pushed after it will not be returned until it finishes, in that case
+	 *       the queue stays signalled.
+	 * @return the message.
+	 * @return invalid message if there are no messages in the queue.
+	 */
+	T_Message PeekMsg();
+
+private:
+	void Signal()NOEXCEPT;
+	void ClearSignal()NOEXCEPT;
+
+#if M_OS == M_OS_WINDOWS
+	HANDLE GetHandle()override;
+
+	std::uint32_t flagsMask;//flags to wait for
+
+	void SetWaitingEvents(std::uint32_t flagsToWaitFor)override;
+
+	//returns true if signaled
+	bool CheckSignaled()override;
+
+#elif M_OS == M_OS_LINUX
+	int GetHandle()override;
+
+#elif M_OS == M_OS_MACOSX
+	int GetHandle()override;
+
+#else
+#	error "Unsupported OS"
+#endif
+};//~class LockFreeQueue
+
+
+
+}//~namespace
+}//~namespace
@@ -39,13 +39,13 @@ std::mutex quitMessageMutex;
 
 
 
-void MsgThread::PushPreallocatedQuitMessage()NOEXCEPT{
+void MsgThread::PushPreallocatedQuitMessage(Queue::EPriority priority)NOEXCEPT{
 	std::lock_guard<decltype(quitMessageMutex)> mutexGuard(quitMessageMutex);
 	
 	if(!this->quitMessage){
 		return;
 	}
 	
-	this->queue.PushMessage(std::move(this->quitMessage));
+	this->queue.PushMessage(std::move(this->quitMessage), priority);
 }
 
@@ -1,122 +1,177 @@
-/* The MIT License:
-
-Copyright (c) 2008-2012 Ivan Gagis <igagis@gmail.com>
-
-Permission is hereby granted, free of charge, to any person obtaining a copy
-of this software and associated documentation files (the "Software"), to deal
-in the Software without restriction, including without limitation the rights
-to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-copies of the Software, and to permit persons to whom the Software is
-furnished to do so, subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in
-all copies or substantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
-THE SOFTWARE. */
-
-// Home page: http://ting.googlecode.com
-
-
-
-/**
- * @author Ivan Gagis <igagis@gmail.com>
- * @author Jose Luis Hidalgo <joseluis.hidalgo@gmail.com> - Mac OS X port
- */
-
-#pragma once
-
-#include "Thread.hpp"
-#include "Queue.hpp"
-
-
-
-namespace ting{
-namespace mt{
-
-
-
-class QuitMessage;
-
-
-
-/**
- * @brief a thread with message queue.
- * This is just a facility class which already contains message queue and boolean 'quit' flag.
- */
-class MsgThread : public Thread{
-protected:
-	/**
-	 * @brief Flag indicating that the thread should exit.
-	 * This is a flag used to stop thread execution. The implementor of
-	 * Thread::Run() method usually would want to use this flag as indicator
-	 * of thread exit request. If this flag is set to true then the thread is requested to exit.
-	 * The typical usage of the flag is as follows:
-	 * @code
-	 * class MyThread : public ting::MsgThread{
-	 *     ...
-	 *     void MyThread::Run(){
-	 *         while(!this->quitFlag){
-	 *             //get and handle thread messages, etc.
-	 *             ...
-	 *         }
-	 *     }
-	 *     ...
-	 * };
-	 * @endcode
-	 */
-	volatile bool quitFlag = false;//looks like it is not necessary to protect this flag by mutex, volatile will be enough
-
-	Queue queue;
-
-	Queue::T_Message quitMessage = [this](){this->quitFlag = true;};
-
-public:
-	MsgThread() = default;
-
-	~MsgThread()NOEXCEPT{}
-	
-	/**
-	 * @brief Send preallocated 'Quit' message to thread's queue.
-	 * This function throws no exceptions. It can send the quit message only once.
-	 */
-	void PushPreallocatedQuitMessage()NOEXCEPT;
-	
-	
-	
-	/**
-	 * @brief Send 'Quit' message to thread's queue.
-	 */
-	void PushQuitMessage(){
-		this->PushMessage([this](){this->quitFlag = true;});
-	}
-
-
-
-	/**
-	 * @brief Send "no operation" message to thread's queue.
-	 */
-	void PushNopMessage(){
-		this->PushMessage([](){});
-	}
-
-
-
-	/**
-	 * @brief Send a message to thread's queue.
-	 * @param msg - a message to send.
-	 */
-	void PushMessage(Queue::T_Message&& msg)NOEXCEPT{
-		this->queue.PushMessage(std::move(msg));
-	}
-};
-
-
-
-}//~namespace ting
-}//~namespace
+/* The MIT License:
+
+Copyright (c) 2008-2012 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+
+
+/**
+ * @author Ivan Gagis <igagis@gmail.com>
+ * @author Jose Luis Hidalgo <joseluis.hidalgo@gmail.com> - Mac OS X port
+ */
+
+#pragma once
+
+#include "Thread.hpp"
+#include "Queue.hpp"
+#include "Future.hpp"
+
+#include <memory>
+#include <type_traits>
+
+
+
+namespace ting{
+namespace mt{
+
+
+
+class QuitMessage;
+
+
+
+/**
+ * @brief a thread with message queue.
+ * This is just a facility class which already contains message queue and boolean 'quit' flag.
+ */
+class MsgThread : public Thread{
+protected:
+	/**
+	 * @brief Flag indicating that the thread should exit.
+	 * This is a flag used to stop thread execution. The implementor of
+	 * Thread::Run() method usually would want to use this flag as indicator
+	 * of thread exit request. If this flag is set to true then the thread is requested to exit.
+	 * The typical usage of the flag is as follows:
+	 * @code
+	 * class MyThread : public ting::MsgThread{
+	 *     ...
+	 *     void MyThread::Run(){
+	 *         while(!this->quitFlag){
+	 *             //get and handle thread messages, etc.
+	 *             ...
+	 *         }
+	 *     }
+	 *     ...
+	 * };
+	 * @endcode
+	 */
+	volatile bool quitFlag = false;//looks like it is not necessary to protect this flag by mutex, volatile will be enough
+
+	Queue queue;
+
+	Queue::T_Message quitMessage = [this](){this->quitFlag = true;};
+
+public:
+	MsgThread() = default;
+
+	~MsgThread()NOEXCEPT{}
+	
+	/**
+	 * @brief Send preallocated 'Quit' message to thread's queue.
+	 * This function throws no exceptions. It can send the quit message only once.
+	 * @param priority - priority of the message. By default, the message is queued after
+	 *                   the messages sent before it, pass Queue::HIGH to make the thread
+	 *                   quit without handling the queued messages of lower priority.
+	 */
+	void PushPreallocatedQuitMessage(Queue::EPriority priority = Queue::NORMAL)NOEXCEPT;
+	
+	
+	
+	/**
+	 * @brief Send 'Quit' message to thread's queue.
+	 * @param priority - priority of the message, see PushPreallocatedQuitMessage().
+	 */
+	void PushQuitMessage(Queue::EPriority priority = Queue::NORMAL){
+		this->PushMessage([this](){this->quitFlag = true;}, priority);
+	}
+
+
+
+	/**
+	 * @brief Send "no operation" message to thread's queue.
+	 */
+	void PushNopMessage(){
+		this->PushMessage([](){});
+	}
+
+
+
+	/**
+	 * @brief Send a message to thread's queue.
+	 * @param msg - a message to send.
+	 * @param priority - priority of the message.
+	 */
+	void PushMessage(Queue::T_Message&& msg, Queue::EPriority priority = Queue::NORMAL)NOEXCEPT{
+		this->queue.PushMessage(std::move(msg), priority);
+	}
+
+
+
+	/**
+	 * @brief Call a function on this thread.
+	 * Sends a message which calls the function and sets its result to the returned future.
+	 * Since the future is a Waitable, the calling thread can wait for the result in its WaitSet,
+	 * so there is no need to send a reply message back to the caller.
+	 * If the message is not handled by the thread, e.g. because it has exited, the future gets
+	 * Future::Exc exception when the message queue is destroyed.
+	 * @param f - function to call, it is called without arguments.
+	 * @param priority - priority of the message.
+	 * @return future of the value returned by the function. If the function throws,
+	 *         the exception is delivered through the future.
+	 */
+	template <class T_Function> Future<typename std::result_of<typename std::decay<T_Function>::type()>::type> PushCall(
+			T_Function&& f,
+			Queue::EPriority priority = Queue::NORMAL
+		)
+	{
+		typedef typename std::decay<T_Function>::type T_DecayedFunction;
+		typedef typename std::result_of<T_DecayedFunction()>::type T_Res;
+
+		struct Call{
+			T_DecayedFunction f;
+			Promise<T_Res> promise;
+
+			Call(T_Function&& f) :
+					f(std::forward<T_Function>(f))
+			{}
+		};
+
+		//the function can be of any size, while the message size is limited, so the call is held by pointer
+		struct CallMsg{
+			std::unique_ptr<Call> c;
+
+			void operator()(){
+				this->c->promise.SetResultOf(this->c->f);
+			}
+		};
+
+		CallMsg m = {std::unique_ptr<Call>(new Call(std::forward<T_Function>(f)))};
+		Future<T_Res> ret = m.c->promise.GetFuture();
+		this->PushMessage(std::move(m), priority);
+		return ret;
+	}
+};
+
+
+
+}//~namespace ting
+}//~namespace
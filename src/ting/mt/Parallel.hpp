@@ -0,0 +1,171 @@
+/* The MIT License:
+
+Copyright (c) 2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+
+
+/**
+ * @author Ivan Gagis <igagis@gmail.com>
+ */
+
+#pragma once
+
+#include "../config.hpp"
+#include "../debug.hpp"
+#include "../Buffer.hpp"
+
+#include "ThreadPool.hpp"
+
+#include <utility>
+#include <algorithm>
+#include <exception>
+
+
+namespace ting{
+namespace mt{
+
+
+
+/**
+ * @brief Calculate default grain size.
+ * The default grain splits the buffer into about 4 chunks per worker thread,
+ * so that the work stealing can even out the load if the chunks take different time to process.
+ * @param pool - thread pool which will process the buffer.
+ * @param bufSize - number of elements in the buffer.
+ * @return grain size, not less than 1.
+ */
+inline std::size_t DefaultGrain(const ThreadPool& pool, std::size_t bufSize)NOEXCEPT{
+	return std::max(bufSize / (std::size_t(pool.NumThreads()) * 4), std::size_t(1));
+}
+
+
+
+/**
+ * @brief Process buffer in parallel.
+ * Recursively splits the buffer in halves until the chunk size is not greater than the grain size
+ * and calls the function for each chunk. The chunks are processed by the thread pool workers, the calling
+ * thread helps processing them as well. The function returns when all the chunks are processed.
+ * The function may be called concurrently from several threads, so it should be thread safe.
+ * If the function throws then, after all the running chunks are done, one of the thrown exceptions
+ * is rethrown to the caller. Some of the chunks might not be processed in that case.
+ * @param pool - thread pool to use.
+ * @param buf - buffer to process.
+ * @param grain - maximum number of elements in a chunk. If 0 then DefaultGrain() is used.
+ * @param fn - function to call for each chunk, should have the signature void(ting::Buffer<T>).
+ */
+template <class T, class T_Function> void ParallelFor(ThreadPool& pool, Buffer<T> buf, std::size_t grain, T_Function&& fn){
+	if(grain == 0){
+		grain = DefaultGrain(pool, buf.size());
+	}
+
+	if(buf.size() <= grain){
+		if(buf.size() != 0){
+			fn(buf);
+		}
+		return;
+	}
+
+	std::size_t half = buf.size() / 2;
+	Buffer<T> left(buf.begin(), half);
+	Buffer<T> right(buf.begin() + half, buf.size() - half);
+
+	auto f = pool.Submit([&pool, left, grain, &fn](){
+		ParallelFor(pool, left, grain, fn);
+	});
+
+	try{
+		ParallelFor(pool, right, grain, fn);
+	}catch(...){
+		//the submitted task refers to the function, so wait for it before leaving
+		pool.Wait(f);
+		throw;
+	}
+
+	pool.Wait(f);
+	f.Get();
+}
+
+
+
+/**
+ * @brief Reduce buffer in parallel.
+ * Splits the buffer into chunks the same way as ParallelFor() does, calculates the result
+ * for each chunk using the map function and combines the results of the chunks using the combine function.
+ * The results are combined in the order of the chunks, i.e. combine(left, right), so the combine
+ * function needs to be associative, but not necessarily commutative.
+ * Both functions may be called concurrently from several threads, so they should be thread safe.
+ * Exceptions are handled the same way as in ParallelFor().
+ * @param pool - thread pool to use.
+ * @param buf - buffer to reduce.
+ * @param grain - maximum number of elements in a chunk. If 0 then DefaultGrain() is used.
+ * @param identity - result for empty buffer.
+ * @param map - function calculating the result for a chunk, should have the signature T_Res(ting::Buffer<T>).
+ * @param combine - function combining results of two adjacent chunks, should have the signature T_Res(T_Res, T_Res).
+ * @return the reduction result.
+ */
+template <class T_Res, class T, class T_MapFunction, class T_CombineFunction> T_Res ParallelReduce(
+		ThreadPool& pool,
+		Buffer<T> buf,
+		std::size_t grain,
+		T_Res identity,
+		T_MapFunction&& map,
+		T_CombineFunction&& combine
+	)
+{
+	if(grain == 0){
+		grain = DefaultGrain(pool, buf.size());
+	}
+
+	if(buf.size() <= grain){
+		if(buf.size() == 0){
+			return identity;
+		}
+		return map(buf);
+	}
+
+	std::size_t half = buf.size() / 2;
+	Buffer<T> left(buf.begin(), half);
+	Buffer<T> right(buf.begin() + half, buf.size() - half);
+
+	auto f = pool.Submit([&pool, left, grain, &identity, &map, &combine](){
+		return ParallelReduce(pool, left, grain, identity, map, combine);
+	});
+
+	T_Res r = [&](){
+		try{
+			return ParallelReduce(pool, right, grain, identity, map, combine);
+		}catch(...){
+			//the submitted task refers to the functions, so wait for it before leaving
+			pool.Wait(f);
+			throw;
+		}
+	}();
+
+	pool.Wait(f);
+	return combine(f.Get(), std::move(r));
+}
+
+
+
+}//~namespace
+}//~namespace
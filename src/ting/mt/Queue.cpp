@@ -1,6 +1,7 @@
 #include "Queue.hpp"
 
 #include <mutex>
+#include <algorithm>
 
 #if M_OS == M_OS_LINUX
 #	include <sys/eventfd.h>
@@ -20,7 +21,9 @@ using namespace ting::mt;
 
 
 
-Queue::Queue(){
+Queue::Queue(std::size_t reserve) :
+		freeNodes(reserve)
+{
 	//can write will always be set because it is always possible to post a message to the queue
 	this->SetCanWriteFlag();
 
@@ -72,11 +75,41 @@ Queue::~Queue()NOEXCEPT{
 
 
 
-void Queue::PushMessage(std::function<void()>&& msg)NOEXCEPT{
+Queue::MsgBatch::~MsgBatch()NOEXCEPT{
+	if(!this->queue || this->msgs.size() == 0){
+		return;
+	}
+
+	//destroy the messages outside of the lock
+	for(auto& m : this->msgs){
+		m = nullptr;
+	}
+	this->queue->Recycle(this->msgs);
+}
+
+
+
+void Queue::Recycle(std::list<T_Message>& nodes)NOEXCEPT{
 	std::lock_guard<decltype(this->mut)> mutexGuard(this->mut);
-	this->messages.push_back(std::move(msg));
+	this->freeNodes.splice(this->freeNodes.end(), nodes);
+}
+
+
+
+void Queue::PushMessage(T_Message&& msg, EPriority priority)NOEXCEPT{
+	ASSERT(unsigned(priority) < DNumPriorities)
+
+	std::lock_guard<decltype(this->mut)> mutexGuard(this->mut);
+	auto& lane = this->lanes[priority];
+	if(this->freeNodes.size() != 0){
+		lane.splice(lane.end(), this->freeNodes, this->freeNodes.begin());
+		lane.back() = std::move(msg);
+	}else{
+		lane.push_back(std::move(msg));
+	}
+	++this->numMessages;
 	
-	if(this->messages.size() == 1){//if it is a first message
+	if(this->numMessages == 1){//if it is a first message
 		//Set CanRead flag.
 		//NOTE: in linux implementation with epoll(), the CanRead
 		//flag will also be set in WaitSet::Wait() method.
@@ -111,51 +144,109 @@ void Queue::PushMessage(std::function<void()>&& msg)NOEXCEPT{
 
 
 
-Queue::T_Message Queue::PeekMsg(){
-	std::lock_guard<decltype(this->mut)> mutexGuard(this->mut);
-	if(this->messages.size() != 0){
-		ASSERT(this->CanRead())
-
-		if(this->messages.size() == 1){//if we are taking away the last message from the queue
+void Queue::ClearSignal(){
 #if M_OS == M_OS_WINDOWS
-			if(ResetEvent(this->eventForWaitable) == 0){
-				ASSERT(false)
-				throw ting::Exc("Queue::Wait(): ResetEvent() failed");
-			}
+	if(ResetEvent(this->eventForWaitable) == 0){
+		ASSERT(false)
+		throw ting::Exc("Queue::Wait(): ResetEvent() failed");
+	}
 #elif M_OS == M_OS_MACOSX
-			{
-				std::uint8_t oneByteBuf[1];
-				if(read(this->pipeEnds[0], oneByteBuf, 1) != 1){
-					throw ting::Exc("Queue::Wait(): read() failed");
-				}
-			}
+	{
+		std::uint8_t oneByteBuf[1];
+		if(read(this->pipeEnds[0], oneByteBuf, 1) != 1){
+			throw ting::Exc("Queue::Wait(): read() failed");
+		}
+	}
 #elif M_OS == M_OS_LINUX
-			{
-				eventfd_t value;
-				if(eventfd_read(this->eventFD, &value) < 0){
-					throw ting::Exc("Queue::Wait(): eventfd_read() failed");
-				}
-				ASSERT(value == 1)
-			}
+	{
+		eventfd_t value;
+		if(eventfd_read(this->eventFD, &value) < 0){
+			throw ting::Exc("Queue::Wait(): eventfd_read() failed");
+		}
+		ASSERT(value == 1)
+	}
 #else
 #	error "Unsupported OS"
 #endif
-			this->ClearCanReadFlag();
+	this->ClearCanReadFlag();
+}
+
+
+
+Queue::T_Message Queue::PeekMsg(){
+	std::lock_guard<decltype(this->mut)> mutexGuard(this->mut);
+	if(this->numMessages != 0){
+		ASSERT(this->CanRead())
+
+		if(this->numMessages == 1){//if we are taking away the last message from the queue
+			this->ClearSignal();
 		}else{
 			ASSERT(this->CanRead())
 		}
 		
-		T_Message ret = std::move(this->messages.front());
-		
-		this->messages.pop_front();
-		
-		return std::move(ret);
+		for(auto l = this->lanes.rbegin(); l != this->lanes.rend(); ++l){
+			if(l->size() == 0){
+				continue;
+			}
+			T_Message ret = std::move(l->front());
+
+			this->freeNodes.splice(this->freeNodes.end(), *l, l->begin());
+			--this->numMessages;
+
+			return ret;
+		}
+		ASSERT(false)
 	}
 	return nullptr;
 }
 
 
 
+Queue::MsgBatch Queue::PeekAllMsgs(){
+	MsgBatch ret(*this);
+
+	std::lock_guard<decltype(this->mut)> mutexGuard(this->mut);
+	if(this->numMessages != 0){
+		ASSERT(this->CanRead())
+		this->ClearSignal();
+		for(auto l = this->lanes.rbegin(); l != this->lanes.rend(); ++l){
+			ret.msgs.splice(ret.msgs.end(), *l);
+		}
+		this->numMessages = 0;
+	}
+	return ret;
+}
+
+
+
+std::size_t Queue::PeekMsgs(Buffer<T_Message> out_msgs){
+	std::lock_guard<decltype(this->mut)> mutexGuard(this->mut);
+	if(this->numMessages == 0 || out_msgs.size() == 0){
+		return 0;
+	}
+
+	ASSERT(this->CanRead())
+
+	std::size_t num = std::min(out_msgs.size(), this->numMessages);
+	if(num == this->numMessages){//if we are taking away all the messages from the queue
+		this->ClearSignal();
+	}
+
+	auto l = this->lanes.rbegin();
+	for(std::size_t i = 0; i != num; ++i){
+		while(l->size() == 0){
+			++l;
+			ASSERT(l != this->lanes.rend())
+		}
+		out_msgs[i] = std::move(l->front());
+		this->freeNodes.splice(this->freeNodes.end(), *l, l->begin());
+	}
+	this->numMessages -= num;
+	return num;
+}
+
+
+
 #if M_OS == M_OS_WINDOWS
 //override
 HANDLE Queue::GetHandle(){
@@ -1,144 +1,262 @@
-/* The MIT License:
-
-Copyright (c) 2008-2014 Ivan Gagis <igagis@gmail.com>
-
-Permission is hereby granted, free of charge, to any person obtaining a copy
-of this software and associated documentation files (the "Software"), to deal
-in the Software without restriction, including without limitation the rights
-to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-copies of the Software, and to permit persons to whom the Software is
-furnished to do so, subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in
-all copies or substantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
-THE SOFTWARE. */
-
-// Home page: http://ting.googlecode.com
-
-
-
-/**
- * @author Ivan Gagis <igagis@gmail.com>
- * @author Jose Luis Hidalgo <joseluis.hidalgo@gmail.com> - Mac OS X port
- */
-
-#pragma once
-
-#include "../config.hpp"
-#include "../debug.hpp"
-#include "../WaitSet.hpp"
-#include "../util.hpp"
-
-#include "SpinLock.hpp"
-
-#include <list>
-#include <functional>
-
-
-namespace ting{
-namespace mt{
-
-
-
-/**
- * @brief Message queue.
- * Message queue is used for communication of separate threads by
- * means of sending messages to each other. Thus, when one thread sends a message to another one,
- * it asks that another thread to execute some code portion - handler code of the message.
- * NOTE: Queue implements Waitable interface which means that it can be used in conjunction
- * with ting::WaitSet. But, note, that the implementation of the Waitable is that it
- * shall only be used to wait for READ. If you are trying to wait for WRITE the behavior will be
- * undefined.
- */
-class Queue : public ting::Waitable{
-	ting::mt::SpinLock mut;
-
-public:
-	typedef std::function<void()> T_Message;
-	
-private:
-	std::list<T_Message> messages;
-	
-#if M_OS == M_OS_WINDOWS
-	//use Event to implement Waitable on Windows
-	HANDLE eventForWaitable;
-#elif M_OS == M_OS_MACOSX
-	//use pipe to implement Waitable in *nix systems
-	int pipeEnds[2];
-#elif M_OS == M_OS_LINUX
-	//use eventfd()
-	int eventFD;
-#else
-#	error "Unsupported OS"
-#endif
-
-	//forbid copying
-	Queue(const Queue&);
-	Queue& operator=(const Queue&);
-
-public:
-	/**
-	 * @brief Constructor, creates empty message queue.
-	 */
-	Queue();
-
-	
-	/**
-	 * @brief Destructor.
-	 * When called, it also destroys all messages on the queue.
-	 */
-	~Queue()NOEXCEPT;
-
-
-
-	/**
-	 * @brief Pushes a new message to the queue.
-	 * @param msg - the message to push into the queue.
-	 */
-	void PushMessage(T_Message&& msg)NOEXCEPT;
-
-
-
-	/**
-	 * @brief Get message from queue, does not block if no messages queued.
-	 * This method gets a message from message queue. If there are no messages on the queue
-	 * it will return invalid auto pointer.
-	 * @return auto-pointer to Message instance.
-	 * @return invalid auto-pointer if there are no messages in the queue.
-	 */
-	T_Message PeekMsg();
-
-
-private:
-#if M_OS == M_OS_WINDOWS
-	HANDLE GetHandle()override;
-
-	std::uint32_t flagsMask;//flags to wait for
-
-	void SetWaitingEvents(std::uint32_t flagsToWaitFor)override;
-
-	//returns true if signaled
-	bool CheckSignaled()override;
-
-#elif M_OS == M_OS_LINUX
-	int GetHandle()override;
-
-#elif M_OS == M_OS_MACOSX
-	int GetHandle()override;
-
-#else
-#	error "Unsupported OS"
-#endif
-};//~class Queue
-
-
-
-}//~namespace
-}//~namespace
+/* The MIT License:
+
+Copyright (c) 2008-2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+
+
+/**
+ * @author Ivan Gagis <igagis@gmail.com>
+ * @author Jose Luis Hidalgo <joseluis.hidalgo@gmail.com> - Mac OS X port
+ */
+
+#pragma once
+
+#include "../config.hpp"
+#include "../debug.hpp"
+#include "../WaitSet.hpp"
+#include "../util.hpp"
+#include "../Buffer.hpp"
+#include "../InplaceFunction.hpp"
+
+#include "AdaptiveSpinLock.hpp"
+
+#include <list>
+#include <array>
+
+
+namespace ting{
+namespace mt{
+
+
+
+/**
+ * @brief Message queue.
+ * Message queue is used for communication of separate threads by
+ * means of sending messages to each other. Thus, when one thread sends a message to another one,
+ * it asks that another thread to execute some code portion - handler code of the message.
+ * NOTE: Queue implements Waitable interface which means that it can be used in conjunction
+ * with ting::WaitSet. But, note, that the implementation of the Waitable is that it
+ * shall only be used to wait for READ. If you are trying to wait for WRITE the behavior will be
+ * undefined.
+ * The queue has several priority lanes. Messages are taken out from the highest priority
+ * non-empty lane first, messages of the same priority are taken out in the order they were pushed.
+ * This allows control messages, like 'quit', to bypass the data messages when the queue is overloaded.
+ * Messages are InplaceFunction objects, so the captured data of the message is stored right in the
+ * queue node, and the nodes of the taken out messages are kept for reuse. Thus, pushing a message
+ * does not allocate memory as long as the number of queued messages does not exceed the number of
+ * nodes the queue has, which is the number of nodes reserved on construction or the maximum number
+ * of messages queued at once so far, whichever is bigger.
+ */
+class Queue : public ting::Waitable{
+	ting::mt::AdaptiveSpinLock mut;
+
+public:
+	/**
+	 * @brief Maximum size of the message callable object, e.g. size of the lambda captures.
+	 */
+	static const std::size_t MAX_MESSAGE_SIZE = 64;
+
+	typedef InplaceFunction<void(), MAX_MESSAGE_SIZE> T_Message;
+
+	/**
+	 * @brief Default number of message nodes to reserve on construction.
+	 */
+	static const std::size_t DEFAULT_RESERVE = 16;
+
+	/**
+	 * @brief Message priorities.
+	 */
+	enum EPriority{
+		LOW,
+		NORMAL,
+		HIGH
+	};
+	
+private:
+	static const unsigned DNumPriorities = HIGH + 1;
+
+	//message lanes, indexed by priority
+	std::array<std::list<T_Message>, DNumPriorities> lanes;
+
+	std::size_t numMessages = 0;//total number of messages in all lanes
+
+	//nodes of the taken out messages, reused for pushing new messages, all the messages in it are empty
+	std::list<T_Message> freeNodes;
+	
+#if M_OS == M_OS_WINDOWS
+	//use Event to implement Waitable on Windows
+	HANDLE eventForWaitable;
+#elif M_OS == M_OS_MACOSX
+	//use pipe to implement Waitable in *nix systems
+	int pipeEnds[2];
+#elif M_OS == M_OS_LINUX
+	//use eventfd()
+	int eventFD;
+#else
+#	error "Unsupported OS"
+#endif
+
+	//forbid copying
+	Queue(const Queue&);
+	Queue& operator=(const Queue&);
+
+public:
+	/**
+	 * @brief Batch of messages taken out from the queue.
+	 * Returned by PeekAllMsgs(). When the batch is destroyed, the messages are destroyed and
+	 * their nodes are given back to the queue for reuse, so the batch should not outlive the queue.
+	 */
+	class MsgBatch{
+		friend class Queue;
+
+		Queue* queue;
+
+		std::list<T_Message> msgs;
+
+		MsgBatch(Queue& queue) :
+				queue(&queue)
+		{}
+
+	public:
+		typedef std::list<T_Message>::iterator iterator;
+
+		MsgBatch(MsgBatch&& b) :
+				queue(b.queue),
+				msgs(std::move(b.msgs))
+		{
+			b.queue = nullptr;
+		}
+
+		MsgBatch(const MsgBatch&) = delete;
+		MsgBatch& operator=(const MsgBatch&) = delete;
+
+		~MsgBatch()NOEXCEPT;
+
+		iterator begin()NOEXCEPT{
+			return this->msgs.begin();
+		}
+
+		iterator end()NOEXCEPT{
+			return this->msgs.end();
+		}
+
+		std::size_t size()const NOEXCEPT{
+			return this->msgs.size();
+		}
+	};
+
+	/**
+	 * @brief Constructor, creates empty message queue.
+	 * @param reserve - number of message nodes to allocate beforehand.
+	 */
+	Queue(std::size_t reserve = DEFAULT_RESERVE);
+
+	
+	/**
+	 * @brief Destructor.
+	 * When called, it also destroys all messages on the queue.
+	 */
+	~Queue()NOEXCEPT;
+
+
+
+	/**
+	 * @brief Pushes a new message to the queue.
+	 * A node of previously taken out message is reused if there is one, otherwise a new node is allocated.
+	 * @param msg - the message to push into the queue.
+	 * @param priority - priority of the message.
+	 */
+	void PushMessage(T_Message&& msg, EPriority priority = NORMAL)NOEXCEPT;
+
+
+
+	/**
+	 * @brief Get message from queue, does not block if no messages queued.
+	 * This method gets a message from message queue. If there are no messages on the queue
+	 * it will return empty message. The message is taken from the highest priority non-empty lane.
+	 * @return the message.
+	 * @return empty message if there are no messages in the queue.
+	 */
+	T_Message PeekMsg();
+
+	/**
+	 * @brief Get all messages from queue, does not block if no messages queued.
+	 * Takes out all the queued messages at once, under a single lock. The messages are
+	 * not copied, the list nodes are just moved to the returned batch.
+	 * This is more efficient than getting messages one by one using PeekMsg(), and allows
+	 * handling the messages outside of the lock, so that the pushing threads are not blocked
+	 * meanwhile. Messages pushed after this call are not included in the returned list.
+	 * Typical usage:
+	 * @code
+	 * for(auto& m : queue.PeekAllMsgs()){
+	 *     m();
+	 * }
+	 * @endcode
+	 * @return batch of messages, higher priority messages go first, messages of the same
+	 *         priority are in the order they were pushed to the queue.
+	 * @return empty batch if there are no messages in the queue.
+	 */
+	MsgBatch PeekAllMsgs();
+
+	/**
+	 * @brief Get several messages from queue, does not block if no messages queued.
+	 * Takes out as many queued messages as fit into the buffer, under a single lock.
+	 * @param out_msgs - buffer where to put the messages.
+	 * @return number of messages put into the buffer, in the same order as PeekAllMsgs() returns them.
+	 */
+	std::size_t PeekMsgs(Buffer<T_Message> out_msgs);
+
+
+private:
+	//Give the nodes of the handled messages back to the free nodes list.
+	void Recycle(std::list<T_Message>& nodes)NOEXCEPT;
+
+	//Clear the Waitable signal after the last message has been taken out of the queue.
+	//Should be called with the mutex locked.
+	void ClearSignal();
+
+#if M_OS == M_OS_WINDOWS
+	HANDLE GetHandle()override;
+
+	std::uint32_t flagsMask;//flags to wait for
+
+	void SetWaitingEvents(std::uint32_t flagsToWaitFor)override;
+
+	//returns true if signaled
+	bool CheckSignaled()override;
+
+#elif M_OS == M_OS_LINUX
+	int GetHandle()override;
+
+#elif M_OS == M_OS_MACOSX
+	int GetHandle()override;
+
+#else
+#	error "Unsupported OS"
+#endif
+};//~class Queue
+
+
+
+}//~namespace
+}//~namespace
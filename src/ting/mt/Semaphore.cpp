@@ -3,6 +3,12 @@
 #if M_OS == M_OS_MACOSX
 #	include <cerrno>
 #	include <sys/time.h>
+#elif M_OS == M_OS_LINUX
+#	include <cerrno>
+#	include <chrono>
+#	include <unistd.h>
+#	include <sys/syscall.h>
+#	include <linux/futex.h>
 #endif
 
 
@@ -10,7 +16,13 @@ using namespace ting::mt;
 
 
 
-Semaphore::Semaphore(unsigned initialValue){
+Semaphore::Semaphore(unsigned initialValue)
+#if M_OS == M_OS_LINUX
+		:
+		v(initialValue),
+		numWaiters(0)
+#endif
+{
 #if M_OS == M_OS_WINDOWS
 	if( (this->s = CreateSemaphore(NULL, initialValue, 0xffffff, NULL)) == NULL)
 #elif M_OS == M_OS_SYMBIAN
@@ -24,7 +36,8 @@ Semaphore::Semaphore(unsigned initialValue){
 		pthread_mutex_destroy(&this->m);
 	}
 #elif M_OS == M_OS_LINUX
-	if(sem_init(&this->s, 0, initialValue) < 0)
+	//nothing to create, the futex exists in the kernel only while there are threads waiting on it
+	return;
 #else
 #	error "unknown OS"
 #endif
@@ -45,7 +58,7 @@ Semaphore::~Semaphore()NOEXCEPT{
 	pthread_cond_destroy(&this->c);
 	pthread_mutex_destroy(&this->m);
 #elif M_OS == M_OS_LINUX
-	sem_destroy(&this->s);
+	ASSERT(this->numWaiters.load() == 0)
 #else
 #	error "unknown OS"
 #endif
@@ -104,37 +117,69 @@ bool Semaphore::Wait(std::uint32_t timeoutMillis){
 		ASSERT(false)
 	}
 #elif M_OS == M_OS_LINUX
-	//if timeoutMillis is 0 then use sem_trywait() to avoid unnecessary time calculation for sem_timedwait()
+	//the time is only measured if the semaphore cannot be decremented right away
+	if(this->TryDecrement()){
+		return true;
+	}
 	if(timeoutMillis == 0){
-		if(sem_trywait(&this->s) == -1){
-			if(errno == EAGAIN){
-				return false;
-			}else{
-				throw ting::Exc("Semaphore::Wait(u32): error: sem_trywait() failed");
-			}
+		return false;
+	}
+	return this->WaitOnFutex(timeoutMillis, false);
+#else
+#	error "unknown OS"
+#endif
+	return true;
+}
+
+
+
+#if M_OS == M_OS_LINUX
+bool Semaphore::WaitOnFutex(std::uint32_t timeoutMillis, bool infinite){
+	//FUTEX_WAIT takes relative timeout measured against the monotonic clock, so the
+	//clock is only read to find out the time left after spurious or stolen wake ups.
+	std::chrono::steady_clock::time_point deadline;
+	if(!infinite){
+		deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+	}
+
+	timespec ts;
+	ts.tv_sec = timeoutMillis / 1000;
+	ts.tv_nsec = (timeoutMillis % 1000) * 1000 * 1000;
+
+	for(;;){
+		this->numWaiters.fetch_add(1, std::memory_order_seq_cst);
+		//the futex wait returns immediately if the value is not 0 anymore
+		long res = syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&this->v), FUTEX_WAIT_PRIVATE, 0, infinite ? nullptr : &ts, nullptr, 0);
+		int err = errno;
+		this->numWaiters.fetch_sub(1, std::memory_order_relaxed);
+
+		if(this->TryDecrement()){
+			return true;
 		}
-	}else{
-		timespec ts;
 
-		if(clock_gettime(CLOCK_REALTIME, &ts) == -1){
-			throw ting::Exc("Semaphore::Wait(): clock_gettime() returned error");
+		if(res == -1 && err != EAGAIN && err != EINTR && err != ETIMEDOUT){
+			TRACE(<< "Semaphore::Wait(): futex wait failed, errno = " << err << std::endl)
+			throw ting::Exc("Semaphore::Wait(): futex wait failed");
 		}
 
-		ts.tv_sec += timeoutMillis / 1000;
-		ts.tv_nsec += (timeoutMillis % 1000) * 1000 * 1000;
-		ts.tv_sec += ts.tv_nsec / (1000 * 1000 * 1000);
-		ts.tv_nsec = ts.tv_nsec % (1000 * 1000 * 1000);
+		if(infinite){
+			continue;
+		}
 
-		if(sem_timedwait(&this->s, &ts) == -1){
-			if(errno == ETIMEDOUT){
-				return false;
-			}else{
-				throw ting::Exc("Semaphore::Wait(u32): error: sem_timedwait() failed");
-			}
+		auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if(left <= 0){
+			return false;
 		}
+		ts.tv_sec = decltype(ts.tv_sec)(left / (1000 * 1000 * 1000));
+		ts.tv_nsec = decltype(ts.tv_nsec)(left % (1000 * 1000 * 1000));
 	}
-#else
-#	error "unknown OS"
-#endif
-	return true;
 }
+
+
+
+void Semaphore::WakeUpWaiter()NOEXCEPT{
+	if(syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&this->v), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0) == -1){
+		ASSERT(false)
+	}
+}
+#endif
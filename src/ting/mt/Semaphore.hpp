@@ -46,8 +46,7 @@ THE SOFTWARE. */
 #	include <hal.h>
 
 #elif M_OS == M_OS_LINUX || M_OS == M_OS_UNIX
-#	include <semaphore.h>
-#	include <errno.h>
+#	include <atomic>
 
 #elif M_OS == M_OS_MACOSX
 #	include <pthread.h>
@@ -85,7 +84,26 @@ class Semaphore{
 	pthread_cond_t c;
 	unsigned v; //current semaphore value
 #elif M_OS == M_OS_LINUX
-	sem_t s;
+	//Semaphore value, it is also used as futex word.
+	std::atomic<std::uint32_t> v;
+
+	//number of threads sleeping on the futex or going to sleep
+	std::atomic<std::uint32_t> numWaiters;
+
+	bool TryDecrement()NOEXCEPT{
+		std::uint32_t val = this->v.load(std::memory_order_relaxed);
+		while(val != 0){
+			if(this->v.compare_exchange_weak(val, val - 1, std::memory_order_acquire, std::memory_order_relaxed)){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//returns false if timeout was hit
+	bool WaitOnFutex(std::uint32_t timeoutMillis, bool infinite);
+
+	void WakeUpWaiter()NOEXCEPT;
 #else
 #	error "unknown OS"
 #endif
@@ -145,13 +163,10 @@ public:
 			ASSERT(false)
 		}
 #elif M_OS == M_OS_LINUX
-		int retVal;
-		do{
-			retVal = sem_wait(&this->s);
-		}while(retVal == -1 && errno == EINTR);
-		if(retVal < 0){
-			throw ting::Exc("Semaphore::Wait(): wait failed");
+		if(this->TryDecrement()){
+			return;
 		}
+		this->WaitOnFutex(0, true);
 #else
 #	error "unknown OS"
 #endif
@@ -214,8 +229,13 @@ public:
 			ASSERT(false)
 		}
 #elif M_OS == M_OS_LINUX
-		if(sem_post(&this->s) < 0){
-			ASSERT(false)
+		//If there is a thread going to sleep on the futex, then either it will see the incremented value
+		//when entering the futex wait, or this thread will see the incremented number of waiters.
+		//Both operations are sequentially consistent, which guarantees that.
+		ASSERT(this->v.load(std::memory_order_relaxed) != std::uint32_t(-1))
+		this->v.fetch_add(1, std::memory_order_seq_cst);
+		if(this->numWaiters.load(std::memory_order_seq_cst) != 0){
+			this->WakeUpWaiter();
 		}
 #else
 #	error "unknown OS"
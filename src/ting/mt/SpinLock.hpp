@@ -79,6 +79,17 @@ public:
 	
 
 
+	/**
+	 * @brief Try to lock the spinlock without waiting.
+	 * @return true if the lock was acquired.
+	 * @return false if the lock is held by other thread.
+	 */
+	bool try_lock()NOEXCEPT{
+		return !this->flag.test_and_set(std::memory_order_acquire);
+	}
+
+
+
 	/**
 	 * @brief Unlock the spinlock.
 	 * Right before releasing the lock the memory barrier is set.
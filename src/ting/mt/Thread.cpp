@@ -27,6 +27,10 @@ THE SOFTWARE. */
 
 #if M_OS == M_OS_WINDOWS
 #	include <process.h>
+#elif M_OS == M_OS_LINUX
+#	include <sched.h>
+#	include <sys/resource.h>
+#	include <sys/syscall.h>
 #endif
 
 
@@ -60,6 +64,9 @@ void* Thread::RunThread(void *data)
 #endif
 {
 	Thread *thr = reinterpret_cast<Thread*>(data);
+
+	thr->ApplySettings();
+
 	try{
 		thr->Run();
 	}catch(ting::Exc& e){
@@ -239,3 +246,208 @@ void Thread::Join() NOEXCEPT{
 
 //	TRACE(<< "Thread::Join(): exit" << std::endl)
 }
+
+
+
+void Thread::SetName(const std::string& name){
+	std::lock_guard<decltype(this->mutex1)> mutexGuard(this->mutex1);
+	if(this->state != NEW){
+		throw HasAlreadyBeenStartedExc();
+	}
+	this->name = name;
+}
+
+
+
+void Thread::SetAffinity(std::vector<unsigned> cpus){
+	std::lock_guard<decltype(this->mutex1)> mutexGuard(this->mutex1);
+	if(this->state != NEW){
+		throw HasAlreadyBeenStartedExc();
+	}
+	this->affinity = std::move(cpus);
+}
+
+
+
+void Thread::SetScheduling(ESchedulingPolicy policy, int priority){
+	std::lock_guard<decltype(this->mutex1)> mutexGuard(this->mutex1);
+	if(this->state != NEW){
+		throw HasAlreadyBeenStartedExc();
+	}
+	this->schedulingIsSet = true;
+	this->schedulingPolicy = policy;
+	this->schedulingPriority = priority;
+}
+
+
+
+void Thread::ApplySettings()NOEXCEPT{
+	if(this->name.size() != 0){
+		SetCurrentThreadName(this->name);
+	}
+
+	if(this->affinity.size() != 0){
+		try{
+			SetCurrentThreadAffinity(this->affinity);
+		}catch(ting::Exc& e){
+			TRACE(<< "Thread: setting affinity failed: " << e.What() << std::endl)
+		}
+	}
+
+	if(this->schedulingIsSet){
+		try{
+			SetCurrentThreadScheduling(this->schedulingPolicy, this->schedulingPriority);
+		}catch(ting::Exc& e){
+			TRACE(<< "Thread: setting scheduling failed: " << e.What() << std::endl)
+		}
+	}
+}
+
+
+
+//static
+void Thread::SetCurrentThreadName(const std::string& name)NOEXCEPT{
+#if M_OS == M_OS_WINDOWS
+	//SetThreadDescription() is available since Windows 10, so look it up at run time
+	typedef HRESULT (WINAPI *T_SetThreadDescription)(HANDLE, PCWSTR);
+	HMODULE kernel = GetModuleHandleW(L"kernel32.dll");
+	if(!kernel){
+		return;
+	}
+	auto setThreadDescription = reinterpret_cast<T_SetThreadDescription>(GetProcAddress(kernel, "SetThreadDescription"));
+	if(!setThreadDescription){
+		return;
+	}
+	std::wstring n(name.begin(), name.end());
+	setThreadDescription(GetCurrentThread(), n.c_str());
+#elif M_OS == M_OS_LINUX
+	//thread name length is limited to 16 bytes including terminating 0
+	if(pthread_setname_np(pthread_self(), name.substr(0, 15).c_str()) != 0){
+		TRACE(<< "Thread::SetCurrentThreadName(): pthread_setname_np() failed" << std::endl)
+	}
+#elif M_OS == M_OS_MACOSX
+	pthread_setname_np(name.c_str());
+#else
+	//not supported
+#endif
+}
+
+
+
+//static
+void Thread::SetCurrentThreadAffinity(const std::vector<unsigned>& cpus){
+#if M_OS == M_OS_LINUX
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for(auto c : cpus){
+		if(c < CPU_SETSIZE){
+			CPU_SET(c, &set);
+		}
+	}
+
+	//pid 0 means the calling thread
+	if(sched_setaffinity(0, sizeof(set), &set) != 0){
+		std::stringstream ss;
+		ss << "Thread::SetCurrentThreadAffinity(): sched_setaffinity() failed, error code = " << errno << ": " << strerror(errno);
+		throw Exc(ss.str());
+	}
+#elif M_OS == M_OS_WINDOWS
+	DWORD_PTR mask = 0;
+	for(auto c : cpus){
+		if(c < sizeof(DWORD_PTR) * 8){
+			mask |= DWORD_PTR(1) << c;
+		}
+	}
+
+	if(SetThreadAffinityMask(GetCurrentThread(), mask) == 0){
+		throw Exc("Thread::SetCurrentThreadAffinity(): SetThreadAffinityMask() failed");
+	}
+#else
+	//not supported
+#endif
+}
+
+
+
+//static
+void Thread::SetCurrentThreadScheduling(ESchedulingPolicy policy, int priority){
+#if M_OS == M_OS_WINDOWS
+	int p;
+	switch(policy){
+		case FIFO:
+		case ROUND_ROBIN:
+			p = THREAD_PRIORITY_TIME_CRITICAL;
+			break;
+		case IDLE:
+			p = THREAD_PRIORITY_IDLE;
+			break;
+		default:
+			//map nice value
+			if(priority <= -10){
+				p = THREAD_PRIORITY_HIGHEST;
+			}else if(priority < 0){
+				p = THREAD_PRIORITY_ABOVE_NORMAL;
+			}else if(priority == 0){
+				p = THREAD_PRIORITY_NORMAL;
+			}else if(priority < 10){
+				p = THREAD_PRIORITY_BELOW_NORMAL;
+			}else{
+				p = THREAD_PRIORITY_LOWEST;
+			}
+			break;
+	}
+	if(SetThreadPriority(GetCurrentThread(), p) == 0){
+		throw Exc("Thread::SetCurrentThreadScheduling(): SetThreadPriority() failed");
+	}
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX
+	int p;
+	sched_param param;
+	param.sched_priority = 0;
+	switch(policy){
+		case FIFO:
+			p = SCHED_FIFO;
+			param.sched_priority = priority;
+			break;
+		case ROUND_ROBIN:
+			p = SCHED_RR;
+			param.sched_priority = priority;
+			break;
+#	if M_OS == M_OS_LINUX
+		case BATCH:
+			p = SCHED_BATCH;
+			break;
+		case IDLE:
+			p = SCHED_IDLE;
+			break;
+#	else
+		case IDLE:
+			//no idle policy, use the lowest priority of the default policy
+			p = SCHED_OTHER;
+			param.sched_priority = sched_get_priority_min(SCHED_OTHER);
+			break;
+#	endif
+		default:
+			p = SCHED_OTHER;
+			break;
+	}
+
+	if(int res = pthread_setschedparam(pthread_self(), p, &param)){
+		std::stringstream ss;
+		ss << "Thread::SetCurrentThreadScheduling(): pthread_setschedparam() failed, error code = " << res << ": " << strerror(res);
+		throw Exc(ss.str());
+	}
+
+#	if M_OS == M_OS_LINUX
+	//On Linux the nice value is per-thread, setpriority() called with thread ID sets it for that thread.
+	if(policy == NORMAL || policy == BATCH){
+		if(setpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)), priority) != 0){
+			std::stringstream ss;
+			ss << "Thread::SetCurrentThreadScheduling(): setpriority() failed, error code = " << errno << ": " << strerror(errno);
+			throw Exc(ss.str());
+		}
+	}
+#	endif
+#else
+#	error "Unsupported OS"
+#endif
+}
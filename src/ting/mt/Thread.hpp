@@ -39,6 +39,8 @@ THE SOFTWARE. */
 #include "../Exc.hpp"
 
 #include <mutex>
+#include <string>
+#include <vector>
 
 
 
@@ -115,6 +117,55 @@ class Thread{
 	Thread(const Thread& );
 	Thread& operator=(const Thread& );
 
+public:
+	/**
+	 * @brief Thread scheduling policy.
+	 */
+	enum ESchedulingPolicy{
+		/**
+		 * @brief Default time sharing policy.
+		 * Priority is a nice value from -20 (highest) to 19 (lowest), 0 is the default.
+		 */
+		NORMAL,
+
+		/**
+		 * @brief Time sharing policy for CPU intensive non-interactive threads.
+		 * On Linux the scheduler assumes the thread is CPU bound and slightly disfavors it
+		 * in wake up decisions. On other systems it is the same as NORMAL.
+		 * Priority is a nice value, same as for NORMAL.
+		 */
+		BATCH,
+
+		/**
+		 * @brief Run the thread only when the CPU would otherwise be idle.
+		 * Priority is ignored.
+		 */
+		IDLE,
+
+		/**
+		 * @brief Real-time first in, first out policy.
+		 * Priority is a real-time priority, on Linux it is from 1 (lowest) to 99 (highest).
+		 * Usually, requires special privileges.
+		 */
+		FIFO,
+
+		/**
+		 * @brief Real-time round robin policy.
+		 * Same as FIFO, but threads of the same priority are time sliced.
+		 */
+		ROUND_ROBIN
+	};
+
+private:
+	//settings applied by the thread itself before calling Run()
+	std::string name;
+	std::vector<unsigned> affinity;
+	bool schedulingIsSet = false;
+	ESchedulingPolicy schedulingPolicy = NORMAL;
+	int schedulingPriority = 0;
+
+	void ApplySettings()NOEXCEPT;
+
 public:
 	
 	/**
@@ -150,6 +201,79 @@ public:
 
 
 
+	/**
+	 * @brief Set thread name.
+	 * The name is visible in system tools, like 'top' or debuggers.
+	 * The name is set by the thread itself when it starts, before calling Run().
+	 * See SetCurrentThreadName() for limitations.
+	 * @param name - name of the thread.
+	 * @throw HasAlreadyBeenStartedExc - if the thread has already been started.
+	 */
+	void SetName(const std::string& name);
+
+
+
+	/**
+	 * @brief Set CPU affinity.
+	 * The affinity is set by the thread itself when it starts, before calling Run().
+	 * See SetCurrentThreadAffinity() for details.
+	 * If setting the affinity fails, the thread runs anyway. To handle the failure use
+	 * SetCurrentThreadAffinity() from within Run() instead.
+	 * @param cpus - indices of the CPUs the thread is allowed to run on.
+	 * @throw HasAlreadyBeenStartedExc - if the thread has already been started.
+	 */
+	void SetAffinity(std::vector<unsigned> cpus);
+
+
+
+	/**
+	 * @brief Set scheduling policy and priority.
+	 * The scheduling is set by the thread itself when it starts, before calling Run().
+	 * See SetCurrentThreadScheduling() for details.
+	 * If setting the scheduling fails, e.g. because of insufficient privileges, the thread runs anyway.
+	 * To handle the failure use SetCurrentThreadScheduling() from within Run() instead.
+	 * @param policy - scheduling policy.
+	 * @param priority - priority, its meaning depends on the policy.
+	 * @throw HasAlreadyBeenStartedExc - if the thread has already been started.
+	 */
+	void SetScheduling(ESchedulingPolicy policy, int priority = 0);
+
+
+
+	/**
+	 * @brief Set name of the calling thread.
+	 * On Linux the name is truncated to 15 characters.
+	 * On Windows the name is set only if the system supports thread descriptions (Windows 10 and later).
+	 * @param name - name of the thread.
+	 */
+	static void SetCurrentThreadName(const std::string& name)NOEXCEPT;
+
+
+
+	/**
+	 * @brief Set CPU affinity of the calling thread.
+	 * Restricts the calling thread to run only on the given CPUs.
+	 * Supported on Linux and Windows, on other systems it does nothing.
+	 * On Windows only the first 64 CPUs (32 on 32bit systems) can be used.
+	 * @param cpus - indices of the CPUs the thread is allowed to run on.
+	 * @throw ting::mt::Thread::Exc - if setting the affinity has failed, e.g. if there are no valid CPUs in the list.
+	 */
+	static void SetCurrentThreadAffinity(const std::vector<unsigned>& cpus);
+
+
+
+	/**
+	 * @brief Set scheduling policy and priority of the calling thread.
+	 * On Windows the policy and priority are mapped to the closest thread priority level.
+	 * On Mac OS X the nice value of NORMAL and BATCH policies is ignored.
+	 * @param policy - scheduling policy.
+	 * @param priority - priority, its meaning depends on the policy, see ESchedulingPolicy.
+	 * @throw ting::mt::Thread::Exc - if setting the scheduling has failed, e.g. because of insufficient privileges.
+	 */
+	static void SetCurrentThreadScheduling(ESchedulingPolicy policy, int priority = 0);
+
+
+
 	/**
 	 * @brief Start thread execution.
 	 * Starts execution of the thread. Thread's Thread::Run() method will
@@ -0,0 +1,436 @@
+/* The MIT License:
+
+Copyright (c) 2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+#include "ThreadPool.hpp"
+#include "Thread.hpp"
+
+#include <thread>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+
+
+using namespace ting::mt;
+
+
+
+namespace{
+
+//Pool which worker thread is the calling thread and the index of that worker, so that looking up
+//the worker on submission does not require going through all the workers of the pool.
+#if M_COMPILER == M_COMPILER_MSVC
+__declspec(thread)
+#else
+thread_local
+#endif
+ThreadPool* currentPool = nullptr;
+
+#if M_COMPILER == M_COMPILER_MSVC
+__declspec(thread)
+#else
+thread_local
+#endif
+unsigned currentWorkerIndex = 0;
+
+}//~namespace
+
+
+
+//Chase-Lev work stealing deque, see "Dynamic Circular Work-Stealing Deque" by D. Chase and Y. Lev
+//and "Correct and Efficient Work-Stealing for Weak Memory Models" by N.M. Le et al.
+//The owner thread pushes and pops tasks at the bottom, other threads steal tasks from the top.
+class ThreadPool::Deque{
+	struct Array{
+		const std::int64_t size;//power of 2
+		std::unique_ptr<std::atomic<Task*>[]> buffer;
+
+		Array(std::int64_t size) :
+				size(size),
+				buffer(new std::atomic<Task*>[std::size_t(size)])
+		{}
+
+		Task* Get(std::int64_t i)const NOEXCEPT{
+			return this->buffer[std::size_t(i & (this->size - 1))].load(std::memory_order_relaxed);
+		}
+
+		void Put(std::int64_t i, Task* t)NOEXCEPT{
+			this->buffer[std::size_t(i & (this->size - 1))].store(t, std::memory_order_relaxed);
+		}
+	};
+
+	std::atomic<std::int64_t> top;
+	std::atomic<std::int64_t> bottom;
+	std::atomic<Array*> array;
+
+	//Arrays which were replaced by bigger ones. Thieves may still be reading from those, so they
+	//are kept until the deque is destroyed. The total size of the old arrays is less than the size
+	//of the current one. Accessed only by the owner thread.
+	std::vector<std::unique_ptr<Array>> arrays;
+
+public:
+	Deque() :
+			top(0),
+			bottom(0)
+	{
+		this->arrays.push_back(std::unique_ptr<Array>(new Array(64)));
+		this->array.store(this->arrays.back().get(), std::memory_order_relaxed);
+	}
+
+	~Deque()NOEXCEPT{
+		ASSERT(this->bottom.load() <= this->top.load())
+	}
+
+	//called only by the owner thread
+	void Push(Task* t){
+		std::int64_t b = this->bottom.load(std::memory_order_relaxed);
+		std::int64_t tp = this->top.load(std::memory_order_acquire);
+		Array* a = this->array.load(std::memory_order_relaxed);
+		if(b - tp > a->size - 1){
+			a = this->Grow(a, tp, b);
+		}
+		a->Put(b, t);
+		this->bottom.store(b + 1, std::memory_order_release);
+	}
+
+	//called only by the owner thread
+	Task* Pop()NOEXCEPT{
+		std::int64_t b = this->bottom.load(std::memory_order_relaxed) - 1;
+		Array* a = this->array.load(std::memory_order_relaxed);
+		this->bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::int64_t t = this->top.load(std::memory_order_relaxed);
+
+		if(t > b){
+			//deque is empty
+			this->bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Task* ret = a->Get(b);
+		if(t == b){
+			//the last task in the deque, race with thieves for it
+			if(!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)){
+				ret = nullptr;//lost the race
+			}
+			this->bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return ret;
+	}
+
+	//can be called by any thread
+	Task* Steal()NOEXCEPT{
+		std::int64_t t = this->top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::int64_t b = this->bottom.load(std::memory_order_acquire);
+
+		if(t >= b){
+			return nullptr;//deque is empty
+		}
+
+		Array* a = this->array.load(std::memory_order_acquire);
+		Task* ret = a->Get(t);
+		if(!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)){
+			return nullptr;//lost the race to other thief or to the owner
+		}
+		return ret;
+	}
+
+private:
+	Array* Grow(Array* a, std::int64_t t, std::int64_t b){
+		std::unique_ptr<Array> newArray(new Array(a->size * 2));
+		for(std::int64_t i = t; i != b; ++i){
+			newArray->Put(i, a->Get(i));
+		}
+		this->arrays.push_back(std::move(newArray));
+		Array* ret = this->arrays.back().get();
+		this->array.store(ret, std::memory_order_release);
+		return ret;
+	}
+};
+
+
+
+class ThreadPool::Worker : public Thread{
+public:
+	ThreadPool& pool;
+
+	const unsigned index;
+
+	Deque deque;
+
+	Worker(ThreadPool& pool, unsigned index) :
+			pool(pool),
+			index(index)
+	{}
+
+	void Run()override;
+};
+
+
+
+void ThreadPool::Worker::Run(){
+	currentPool = &this->pool;
+	currentWorkerIndex = this->index;
+
+	for(;;){
+		Task* t = this->deque.Pop();
+
+		if(!t && this->pool.numInjected.load(std::memory_order_relaxed) != 0){
+			std::lock_guard<decltype(this->pool.mutex)> mutexGuard(this->pool.mutex);
+			t = this->pool.TakeInjected();
+		}
+
+		if(!t){
+			t = this->pool.Steal(this->index + 1);
+		}
+
+		if(!t){
+			//No tasks found, go to sleep. Before sleeping check for tasks again, after
+			//announcing that this worker is going to sleep, so that the task pushed
+			//meanwhile is not missed: the pushing thread will see the sleeping worker and wake it up.
+			std::unique_lock<decltype(this->pool.mutex)> lock(this->pool.mutex);
+			this->pool.numSleeping.fetch_add(1, std::memory_order_seq_cst);
+			for(;;){
+				t = this->pool.TakeInjected();
+				if(t){
+					break;
+				}
+				t = this->pool.Steal(this->index + 1);
+				if(t){
+					break;
+				}
+				if(this->pool.quit){
+					break;
+				}
+				this->pool.cv.wait(lock);
+			}
+			this->pool.numSleeping.fetch_sub(1, std::memory_order_relaxed);
+
+			if(!t){
+				ASSERT(this->pool.quit)
+				break;
+			}
+		}
+
+		t->Run();
+		delete t;
+	}
+}
+
+
+
+ThreadPool::ThreadPool(unsigned numThreads) :
+		numInjected(0),
+		numSleeping(0),
+		numWaiters(0),
+		numPushed(0)
+{
+	if(numThreads == 0){
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	for(unsigned i = 0; i != numThreads; ++i){
+		this->workers.push_back(std::unique_ptr<Worker>(new Worker(*this, i)));
+		this->workers.back()->SetName("ting.pool." + std::to_string(i));
+	}
+
+	try{
+		for(auto& w : this->workers){
+			w->Start();
+		}
+	}catch(...){
+		{
+			std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+			this->quit = true;
+			this->cv.notify_all();
+		}
+		for(auto& w : this->workers){
+			w->Join();
+		}
+		throw;
+	}
+}
+
+
+
+ThreadPool::~ThreadPool()NOEXCEPT{
+	{
+		std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+		this->quit = true;
+		this->cv.notify_all();
+	}
+	for(auto& w : this->workers){
+		w->Join();
+	}
+	ASSERT(this->injected.size() == 0)
+	ASSERT(this->waiters.size() == 0)
+}
+
+
+
+ThreadPool::Worker* ThreadPool::CurrentWorker()NOEXCEPT{
+	if(currentPool != this){
+		return nullptr;
+	}
+	ASSERT(currentWorkerIndex < this->workers.size())
+	return this->workers[currentWorkerIndex].get();
+}
+
+
+
+void ThreadPool::Push(Task* t){
+	if(Worker* w = this->CurrentWorker()){
+		w->deque.Push(t);
+		this->numPushed.fetch_add(1, std::memory_order_seq_cst);
+
+		//pair to the fetch_add() of numSleeping by the worker going to sleep
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(this->numSleeping.load(std::memory_order_relaxed) != 0){
+			this->WakeUpWorker();
+		}
+		//pair to the fetch_add() of numWaiters in Wait()
+		if(this->numWaiters.load(std::memory_order_seq_cst) != 0){
+			std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+			this->WakeUpWaiters();
+		}
+		return;
+	}
+
+	std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+	this->injected.push_back(t);
+	this->numInjected.fetch_add(1, std::memory_order_relaxed);
+	this->numPushed.fetch_add(1, std::memory_order_seq_cst);
+	if(this->numSleeping.load(std::memory_order_relaxed) != 0){
+		this->cv.notify_one();
+	}
+	if(this->numWaiters.load(std::memory_order_seq_cst) != 0){
+		this->WakeUpWaiters();
+	}
+}
+
+
+
+void ThreadPool::WakeUpWaiters()NOEXCEPT{
+	for(auto s : this->waiters){
+		//lock the mutex of the future state to make sure the waiter is either already
+		//waiting on the condition variable or will see the new tasks counter before waiting
+		std::lock_guard<decltype(s->mutex)> mutexGuard(s->mutex);
+		s->cv.notify_all();
+	}
+}
+
+
+
+void ThreadPool::Wait(const FutureBase& f){
+	ASSERT(f.IsValid())
+	FutureBase::StateBase& s = *f.state;
+
+	while(!f.IsReady()){
+		std::uint64_t numPushed = this->numPushed.load(std::memory_order_seq_cst);
+
+		if(this->RunPendingTask()){
+			continue;
+		}
+
+		//The task is being run by other thread. Block until it is done, but wake up if new tasks
+		//are pushed meanwhile, because that task can submit more tasks which this thread could help with.
+		{
+			std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+			this->waiters.push_back(&s);
+		}
+		this->numWaiters.fetch_add(1, std::memory_order_seq_cst);
+
+		{
+			std::unique_lock<decltype(s.mutex)> lock(s.mutex);
+			s.numWaiters.fetch_add(1, std::memory_order_seq_cst);
+			s.cv.wait(lock, [this, &s, numPushed](){
+				return s.ready.load(std::memory_order_seq_cst) || this->numPushed.load(std::memory_order_seq_cst) != numPushed;
+			});
+			s.numWaiters.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		this->numWaiters.fetch_sub(1, std::memory_order_relaxed);
+		{
+			std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+			this->waiters.erase(std::find(this->waiters.begin(), this->waiters.end(), &s));
+		}
+	}
+}
+
+
+
+void ThreadPool::WakeUpWorker()NOEXCEPT{
+	//lock the mutex to make sure the worker which is going to sleep is either
+	//already waiting on the condition variable or will find the task before waiting
+	std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+	this->cv.notify_one();
+}
+
+
+
+ThreadPool::Task* ThreadPool::TakeInjected()NOEXCEPT{
+	if(this->injected.size() == 0){
+		return nullptr;
+	}
+	Task* ret = this->injected.front();
+	this->injected.pop_front();
+	this->numInjected.fetch_sub(1, std::memory_order_relaxed);
+	return ret;
+}
+
+
+
+ThreadPool::Task* ThreadPool::Steal(unsigned startIndex)NOEXCEPT{
+	for(unsigned i = 0; i != this->workers.size(); ++i){
+		if(Task* t = this->workers[(startIndex + i) % this->workers.size()]->deque.Steal()){
+			return t;
+		}
+	}
+	return nullptr;
+}
+
+
+
+bool ThreadPool::RunPendingTask(){
+	Worker* w = this->CurrentWorker();
+
+	Task* t = w ? w->deque.Pop() : nullptr;
+
+	if(!t && this->numInjected.load(std::memory_order_relaxed) != 0){
+		std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+		t = this->TakeInjected();
+	}
+
+	if(!t){
+		t = this->Steal(w ? w->index + 1 : 0);
+	}
+
+	if(!t){
+		return false;
+	}
+
+	t->Run();
+	delete t;
+	return true;
+}
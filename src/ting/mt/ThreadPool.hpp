@@ -0,0 +1,211 @@
+/* The MIT License:
+
+Copyright (c) 2014 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE. */
+
+// Home page: http://ting.googlecode.com
+
+
+
+/**
+ * @author Ivan Gagis <igagis@gmail.com>
+ */
+
+#pragma once
+
+#include "../config.hpp"
+#include "../debug.hpp"
+#include "../util.hpp"
+#include "../Exc.hpp"
+
+#include "Future.hpp"
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <condition_variable>
+
+
+namespace ting{
+namespace mt{
+
+
+
+/**
+ * @brief Work stealing thread pool.
+ * The pool runs a number of worker threads which execute submitted tasks.
+ * Each worker has its own double-ended task queue (Chase-Lev work stealing deque).
+ * Tasks submitted from within a task running on a worker are pushed to that worker's
+ * deque, the worker takes the tasks from its deque in LIFO order, which is cache friendly
+ * for divide-and-conquer algorithms. Tasks submitted from other threads are put to a shared
+ * queue. A worker which has run out of tasks takes tasks from the shared queue, and if it is
+ * empty, steals the oldest tasks from other workers' deques, so that the load is balanced
+ * between the workers automatically. Idle workers sleep until new tasks are submitted.
+ * Submitting a task from a worker does not involve any locking, unless there are sleeping workers
+ * to wake up.
+ */
+class ThreadPool{
+public:
+	/**
+	 * @brief Basic exception type thrown by ThreadPool class.
+	 */
+	class Exc : public ting::Exc{
+	public:
+		Exc(const std::string& message = std::string()) :
+				ting::Exc(message)
+		{}
+	};
+
+private:
+	struct Task{
+		virtual ~Task()NOEXCEPT{}
+
+		virtual void Run()NOEXCEPT = 0;
+	};
+
+	template <class T_Res, class T_Function> struct FutureTask : public Task{
+		T_Function f;
+		Promise<T_Res> promise;
+
+		template <class T_Arg> FutureTask(T_Arg&& f) :
+				f(std::forward<T_Arg>(f))
+		{}
+
+		void Run()NOEXCEPT override{
+			this->promise.SetResultOf(this->f);
+		}
+	};
+
+	class Deque;
+	class Worker;
+
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	//protects 'injected' and 'quit', also used for putting idle workers to sleep
+	std::mutex mutex;
+	std::condition_variable cv;
+
+	//tasks submitted from threads which are not workers of this pool
+	std::deque<Task*> injected;
+	std::atomic<std::size_t> numInjected;
+
+	std::atomic<unsigned> numSleeping;
+
+	bool quit = false;
+
+	//Threads blocked in Wait() because there were no pending tasks to run. Those are blocked on the
+	//states of the futures they wait for and are woken up when new tasks are pushed.
+	//The list is protected by the mutex.
+	std::vector<FutureBase::StateBase*> waiters;
+	std::atomic<unsigned> numWaiters;
+
+	//incremented each time a task is pushed, used by Wait() to find out whether there are new tasks
+	std::atomic<std::uint64_t> numPushed;
+
+public:
+	/**
+	 * @brief Constructor.
+	 * Creates and starts the worker threads.
+	 * @param numThreads - number of worker threads. If 0 then the number of
+	 *                     threads will be equal to the number of CPU cores in the system.
+	 */
+	ThreadPool(unsigned numThreads = 0);
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * Waits until all the submitted tasks are done and joins the worker threads.
+	 * Submitting tasks from other threads while destroying the pool is not allowed,
+	 * but tasks are allowed to submit more tasks.
+	 */
+	~ThreadPool()NOEXCEPT;
+
+	/**
+	 * @brief Get number of worker threads.
+	 * @return number of worker threads in this pool.
+	 */
+	unsigned NumThreads()const NOEXCEPT{
+		return unsigned(this->workers.size());
+	}
+
+	/**
+	 * @brief Submit a task.
+	 * Can be called from any thread, including the worker threads of this pool.
+	 * @param f - task function, it is called without arguments on one of the worker threads.
+	 * @return future of the value returned by the task function. If the task function throws,
+	 *         the exception is delivered through the future.
+	 */
+	template <class T_Function> Future<typename std::result_of<typename std::decay<T_Function>::type()>::type> Submit(T_Function&& f){
+		typedef typename std::decay<T_Function>::type T_DecayedFunction;
+		typedef typename std::result_of<T_DecayedFunction()>::type T_Res;
+
+		std::unique_ptr<FutureTask<T_Res, T_DecayedFunction>> t(new FutureTask<T_Res, T_DecayedFunction>(std::forward<T_Function>(f)));
+		Future<T_Res> ret = t->promise.GetFuture();
+		this->Push(t.get());
+		t.release();
+		return ret;
+	}
+
+	/**
+	 * @brief Run one of the pending tasks on the calling thread.
+	 * Allows the thread which waits for some tasks to complete to help the pool.
+	 * If called from a worker thread, it takes a task from the worker's own deque first.
+	 * @return true if a task was run.
+	 * @return false if there were no pending tasks.
+	 */
+	bool RunPendingTask();
+
+	/**
+	 * @brief Wait for the future, running pending tasks meanwhile.
+	 * Unlike Future::Wait(), the calling thread does not just block while the result is not ready,
+	 * but runs pending tasks of the pool. Waiting for a task from within another task should be
+	 * done with this method, otherwise the pool can run out of workers which are not blocked.
+	 * When there are no pending tasks, the calling thread blocks until either the result
+	 * is ready or new tasks are submitted to the pool.
+	 * @param f - future to wait for.
+	 */
+	void Wait(const FutureBase& f);
+
+private:
+	//wake up the threads blocked in Wait(), should be called with the mutex locked
+	void WakeUpWaiters()NOEXCEPT;
+
+	void Push(Task* t);
+
+	Worker* CurrentWorker()NOEXCEPT;
+
+	//should be called with the mutex locked
+	Task* TakeInjected()NOEXCEPT;
+
+	Task* Steal(unsigned startIndex)NOEXCEPT;
+
+	void WakeUpWorker()NOEXCEPT;
+};
+
+
+
+}//~namespace
+}//~namespace
@@ -913,7 +913,7 @@ private:
 			}
 			
 			if(this->queue.CanRead()){
-				while(auto m = std::move(this->queue.PeekMsg())){
+				for(auto& m : this->queue.PeekAllMsgs()){
 					m();
 				}
 			}			
@@ -194,6 +194,13 @@ TCPSocket TCPServerSocket::Accept(){
 		return sock;//no connections to be accepted, return invalid socket
 	}
 
+	//In edge-triggered mode the WaitSet will not report the socket as readable again
+	//until new connection arrives, so keep the 'can read' flag, there may be more
+	//connections pending.
+	if(this->IsEdgeTriggered()){
+		this->SetCanReadFlag();
+	}
+
 #if M_OS == M_OS_WINDOWS
 	sock.CreateEventForWaitable();
 
@@ -199,6 +199,12 @@ size_t TCPSocket::Send(ting::Buffer<const std::uint8_t> buf){
 		break;
 	}//~while
 
+	//In edge-triggered mode the WaitSet will not report the socket as writable again
+	//until send() would block, so keep the 'can write' flag if everything was sent.
+	if(len != 0 && size_t(len) == buf.size() && this->IsEdgeTriggered()){
+		this->SetCanWriteFlag();
+	}
+
 	ASSERT(len >= 0)
 	return size_t(len);
 }
@@ -260,6 +266,13 @@ size_t TCPSocket::Recv(ting::Buffer<std::uint8_t> buf){
 		break;
 	}//~while
 
+	//In edge-triggered mode the WaitSet will not report the socket as readable again
+	//until new data arrives, so keep the 'can read' flag if the buffer was filled
+	//completely, because there may be more data pending.
+	if(len != 0 && size_t(len) == buf.size() && this->IsEdgeTriggered()){
+		this->SetCanReadFlag();
+	}
+
 	ASSERT(len >= 0)
 	return size_t(len);
 }
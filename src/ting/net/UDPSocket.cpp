@@ -262,6 +262,12 @@ size_t UDPSocket::Send(ting::Buffer<const std::uint8_t> buf, const IPAddress& de
 	ASSERT_INFO(len <= int(buf.size()), "res = " << len)
 	ASSERT_INFO((len == int(buf.size())) || (len == 0), "res = " << len)
 
+	//In edge-triggered mode the WaitSet will not report the socket as writable again
+	//until sendto() would block, so keep the 'can write' flag if the datagram was sent.
+	if(len != 0 && this->IsEdgeTriggered()){
+		this->SetCanWriteFlag();
+	}
+
 	ASSERT(len >= 0)
 	return size_t(len);
 }
@@ -365,6 +371,13 @@ size_t UDPSocket::Recv(ting::Buffer<std::uint8_t> buf, IPAddress &out_SenderIP){
 			);
 	}
 	
+	//In edge-triggered mode the WaitSet will not report the socket as readable again
+	//until new datagram arrives, so keep the 'can read' flag while datagrams are received,
+	//there may be more datagrams pending.
+	if(this->IsEdgeTriggered()){
+		this->SetCanReadFlag();
+	}
+
 	ASSERT(len >= 0)
 	return size_t(len);
 }
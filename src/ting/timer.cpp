@@ -26,6 +26,22 @@ THE SOFTWARE. */
 
 #include "timer.hpp"
 
+#include <sstream>
+#include <cstring>
+
+#if M_OS == M_OS_LINUX
+#	include <sys/timerfd.h>
+#	include <unistd.h>
+#elif M_OS == M_OS_MACOSX
+#	include <sys/types.h>
+#	include <sys/event.h>
+#	include <unistd.h>
+#endif
+
+#if M_COMPILER == M_COMPILER_MSVC
+#	include <intrin.h>
+#endif
+
 
 
 using namespace ting::timer;
@@ -36,29 +52,331 @@ ting::IntrusiveSingleton<Lib>::T_Instance Lib::instance;
 
 
 
+namespace{
+
+unsigned CountTrailingZeros(std::uint64_t x)NOEXCEPT{
+	ASSERT(x != 0)
+#if M_COMPILER == M_COMPILER_MSVC
+	unsigned long ret;
+#	if M_CPU == M_CPU_X86_64
+	_BitScanForward64(&ret, x);
+#	else
+	if(_BitScanForward(&ret, std::uint32_t(x)) == 0){
+		_BitScanForward(&ret, std::uint32_t(x >> 32));
+		ret += 32;
+	}
+#	endif
+	return unsigned(ret);
+#else
+	return unsigned(__builtin_ctzll(x));
+#endif
+}
+
+//Choose the deadline within [deadline, deadline + slack] which has as many low bits cleared as possible,
+//so that the timers with close deadlines and overlapping slack intervals get the same deadline.
+std::uint64_t ApplySlack(std::uint64_t deadline, std::uint32_t slack)NOEXCEPT{
+	std::uint64_t limit = deadline + slack;
+
+	//all bits below the highest bit which differs in the interval bounds can be cleared
+	std::uint64_t mask = deadline ^ limit;
+	mask |= mask >> 1;
+	mask |= mask >> 2;
+	mask |= mask >> 4;
+	mask |= mask >> 8;
+	mask |= mask >> 16;
+	mask |= mask >> 32;
+
+	return limit & ~(mask >> 1);
+}
+
+}//~namespace
+
+
+
+TimerWheel::TimerWheel(std::uint64_t ticks)NOEXCEPT :
+		current(ticks)
+{
+	this->occupied.fill(0);
+}
+
+
+
+void TimerWheel::Link(Timer& t)NOEXCEPT{
+	unsigned level = 0;
+	unsigned index = 0;
+
+	if(t.deadline < this->current){
+		//The tick of the deadline has been processed already. Putting the timer to the slot of the
+		//current tick would delay it till the next tick, e.g. catching up periodic timers would
+		//expire once per tick, so it goes to the slot of overdue timers instead.
+		t.slot = DOverdueSlot;
+	}else{
+		std::uint64_t delta = t.deadline - this->current;
+
+		while(level != DNumLevels - 1 && (delta >> (DSlotBits * (level + 1))) != 0){
+			++level;
+		}
+
+		index = unsigned(t.deadline >> (DSlotBits * level)) & (DNumSlots - 1);
+
+		t.slot = level * DNumSlots + index;
+	}
+
+	Slot& s = this->slots[t.slot];
+	t.prev = s.last;
+	t.next = nullptr;
+	if(s.last){
+		s.last->next = &t;
+	}else{
+		s.first = &t;
+	}
+	s.last = &t;
+
+	if(t.slot != DOverdueSlot){
+		this->occupied[level] |= (std::uint64_t(1) << index);
+	}
+}
+
+
+
+void TimerWheel::Insert(Timer& t, std::uint64_t deadline)NOEXCEPT{
+	t.deadline = deadline;
+	this->Link(t);
+	++this->size;
+}
+
+
+
+void TimerWheel::Erase(Timer& t)NOEXCEPT{
+	ASSERT(this->size != 0)
+	ASSERT(t.slot < this->slots.size())
+
+	Slot& s = this->slots[t.slot];
+
+	if(t.prev){
+		t.prev->next = t.next;
+	}else{
+		ASSERT(s.first == &t)
+		s.first = t.next;
+	}
+
+	if(t.next){
+		t.next->prev = t.prev;
+	}else{
+		ASSERT(s.last == &t)
+		s.last = t.prev;
+	}
+
+	if(!s.first && t.slot != DOverdueSlot){
+		this->occupied[t.slot / DNumSlots] &= ~(std::uint64_t(1) << (t.slot % DNumSlots));
+	}
+
+	--this->size;
+}
+
+
+
+void TimerWheel::Cascade(unsigned level)NOEXCEPT{
+	ASSERT(level != 0)
+
+	unsigned index = unsigned(this->current >> (DSlotBits * level)) & (DNumSlots - 1);
+
+	Slot& s = this->slots[level * DNumSlots + index];
+
+	Timer* t = s.first;
+	s.first = nullptr;
+	s.last = nullptr;
+	this->occupied[level] &= ~(std::uint64_t(1) << index);
+
+	//All the timers of the slot expire within the span of one slot of this level,
+	//so they go to the lower levels, except the timers beyond the wheel span which go back to the top level.
+	while(t){
+		Timer* next = t->next;
+		this->Link(*t);
+		t = next;
+	}
+}
+
+
+
+std::uint64_t TimerWheel::NextTick()const NOEXCEPT{
+	if(this->slots[DOverdueSlot].first){
+		ASSERT(this->current != 0)
+		return this->current - 1;
+	}
+
+	std::uint64_t ret = std::uint64_t(-1);
+
+	for(unsigned level = 0; level != DNumLevels; ++level){
+		std::uint64_t mask = this->occupied[level];
+		if(mask == 0){
+			continue;
+		}
+
+		unsigned shift = DSlotBits * level;
+
+		//number of the first slot span of this level which starts at the current tick or later
+		std::uint64_t span = (this->current + (std::uint64_t(1) << shift) - 1) >> shift;
+
+		//rotate the mask so that the slot of that span becomes the lowest bit
+		unsigned index = unsigned(span) & (DNumSlots - 1);
+		if(index != 0){
+			mask = (mask >> index) | (mask << (DNumSlots - index));
+		}
+
+		std::uint64_t tick = (span + CountTrailingZeros(mask)) << shift;
+		if(tick < ret){
+			ret = tick;
+		}
+	}
+
+	return ret;
+}
+
+
+
+void TimerWheel::PopExpired(std::uint64_t ticks, std::vector<Timer*>& expired){
+	{
+		Slot& s = this->slots[DOverdueSlot];
+		for(Timer* t = s.first; t; t = t->next){
+			expired.push_back(t);
+			--this->size;
+		}
+		s.first = nullptr;
+		s.last = nullptr;
+	}
+
+	while(this->size != 0){
+		//jump to the next tick having something to do, skipping empty slots
+		std::uint64_t tick = this->NextTick();
+		if(tick > ticks){
+			break;
+		}
+
+		this->current = tick;
+
+		for(unsigned level = DNumLevels - 1; level != 0; --level){
+			if((tick & ((std::uint64_t(1) << (DSlotBits * level)) - 1)) == 0){
+				this->Cascade(level);
+			}
+		}
+
+		unsigned index = unsigned(tick) & (DNumSlots - 1);
+		Slot& s = this->slots[index];
+		for(Timer* t = s.first; t; t = t->next){
+			ASSERT(t->deadline <= tick)
+			expired.push_back(t);
+			--this->size;
+		}
+		s.first = nullptr;
+		s.last = nullptr;
+		this->occupied[0] &= ~(std::uint64_t(1) << index);
+
+		this->current = tick + 1;
+	}
+
+	if(ticks >= this->current){
+		this->current = ticks + 1;
+	}
+}
+
+
+
+void TimerStorage::Insert(Timer& t, std::uint64_t deadline){
+	ASSERT(!t.isStored)
+
+	t.due = deadline;
+	deadline = ApplySlack(deadline, t.slack);
+
+	if(this->storage == WHEEL){
+		this->wheel.Insert(t, deadline);
+	}else{
+		t.deadline = deadline;
+		t.i = this->map.insert(std::make_pair(deadline, &t));
+	}
+	t.isStored = true;
+}
+
+
+
+void TimerStorage::Erase(Timer& t)NOEXCEPT{
+	ASSERT(t.isStored)
+
+	if(this->storage == WHEEL){
+		this->wheel.Erase(t);
+	}else{
+		this->map.erase(t.i);
+	}
+	t.isStored = false;
+}
+
+
+
+std::uint64_t TimerStorage::NextDeadline()const NOEXCEPT{
+	if(this->storage == WHEEL){
+		return this->wheel.NextTick();
+	}
+	return this->map.size() == 0 ? std::uint64_t(-1) : this->map.begin()->first;
+}
+
+
+
+void TimerStorage::PopExpired(std::uint64_t ticks, std::vector<Timer*>& expired){
+	size_t first = expired.size();
+
+	if(this->storage == WHEEL){
+		this->wheel.PopExpired(ticks, expired);
+	}else{
+		for(Timer::T_TimerIter b = this->map.begin(); b != this->map.end() && b->first <= ticks; b = this->map.begin()){
+			ASSERT(b->second)
+			expired.push_back(b->second);
+			this->map.erase(b);
+		}
+	}
+
+	for(size_t i = first; i != expired.size(); ++i){
+		expired[i]->isStored = false;
+	}
+}
+
+
+
 bool Lib::TimerThread::RemoveTimer_ts(Timer* timer)NOEXCEPT{
 	ASSERT(timer)
-	std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+	{
+		std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
+
+		if(!timer->isRunning){
+			//lock and unlock the 'expired' mutex to make sure that the timer's callback
+			//has been called if the timer has expired and is awaiting the notification callback to be called.
+			std::lock_guard<decltype(this->expiredTimersNotifyMutex)> mutexGuard(this->expiredTimersNotifyMutex);
+			return false;
+		}
 
-	if(!timer->isRunning){
-		//lock and unlock the 'expired' mutex to make sure that the timer's callback
-		//has been called if the timer has expired and is awaiting the notification callback to be called.
-		std::lock_guard<decltype(this->expiredTimersNotifyMutex)> mutexGuard(this->expiredTimersNotifyMutex);
-		return false;
-	}
+		//if isStarted flag is set then the timer will be stopped now, so
+		//change the flag
+		timer->isRunning = false;
 
-	//if isStarted flag is set then the timer will be stopped now, so
-	//change the flag
-	timer->isRunning = false;
+		std::uint64_t nextDeadline = this->timers.NextDeadline();
 
-	ASSERT(timer->i != this->timers.end())
+		this->timers.Erase(*timer);
+
+		//If that was the first timer, signal the semaphore about timer deletion in order to recalculate the waiting time.
+		//NOTE: with WHEEL storage the next deadline is the next tick the wheel has to process, which is not necessarily
+		//      the deadline of a timer, so compare the next deadlines before and after the removal instead.
+		if(this->timers.NextDeadline() != nextDeadline){
+			this->sema.Signal();
+		}
 
-	//if that was the first timer, signal the semaphore about timer deletion in order to recalculate the waiting time
-	if(this->timers.begin() == timer->i){
-		this->sema.Signal();
+		if(timer->period == 0 || this->threadID == ting::mt::Thread::GetCurrentThreadID()){
+			//was running
+			return true;
+		}
 	}
 
-	this->timers.erase(timer->i);
+	//Periodic timer is rescheduled before its callback is called, so the callback can be in progress
+	//at the moment, make sure it has finished. The mutex is unlocked, so that the callback can use other timers.
+	std::lock_guard<decltype(this->expiredTimersNotifyMutex)> mutexGuard(this->expiredTimersNotifyMutex);
 
 	//was running
 	return true;
@@ -66,24 +384,24 @@ bool Lib::TimerThread::RemoveTimer_ts(Timer* timer)NOEXCEPT{
 
 
 
-void Lib::TimerThread::AddTimer_ts(Timer* timer, std::uint32_t timeout){
+void Lib::TimerThread::AddTimer_ts(Timer* timer, std::uint32_t timeout, std::uint32_t period, Timer::EMissedTicks missedTicks){
 	ASSERT(timer)
+	timer->WaitReleased();
+
 	std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
 
-	if(timer->isRunning){
+	if(timer->isRunning || timer->state != Timer::STOPPED){
 		throw ting::Exc("Lib::TimerThread::AddTimer(): timer is already running!");
 	}
 
-	timer->isRunning = true;
+	std::uint64_t stopTicks = GetTicks64() + std::uint64_t(timeout);
 
-	std::uint64_t stopTicks = this->GetTicks() + std::uint64_t(timeout);
+	timer->period = period;
+	timer->missedTicks = missedTicks;
 
-	timer->i = this->timers.insert(
-			std::pair<std::uint64_t, Timer*>(stopTicks, timer)
-		);
+	this->timers.Insert(*timer, stopTicks);
 
-	ASSERT(timer->i != this->timers.end())
-	ASSERT(timer->i->second)
+	timer->isRunning = true;
 
 	//signal the semaphore about new timer addition in order to recalculate the waiting time
 	this->sema.Signal();
@@ -95,8 +413,10 @@ void Lib::TimerThread::AddTimer_ts(Timer* timer, std::uint32_t timeout){
 void Lib::TimerThread::Run(){
 	M_TIMER_TRACE(<< "Lib::TimerThread::Run(): enter" << std::endl)
 
+	this->threadID = ting::mt::Thread::GetCurrentThreadID();
+
 	while(!this->quitFlag){
-		std::uint32_t millis;
+		std::uint64_t deadline;
 
 		while(true){
 			std::vector<Timer*> expiredTimers;
@@ -104,32 +424,27 @@ void Lib::TimerThread::Run(){
 			{
 				std::lock_guard<decltype(this->mutex)> mutexGuard(this->mutex);
 
-				std::uint64_t ticks = this->GetTicks();
+				std::uint64_t ticks = GetTicks64();
 
-				for(Timer::T_TimerIter b = this->timers.begin(); b != this->timers.end(); b = this->timers.begin()){
-					if(b->first > ticks){
-						break;//~for
-					}
+				this->timers.PopExpired(ticks, expiredTimers);
 
-					Timer *timer = b->second;
-					//add the timer to list of expired timers
+				for(Timer* timer : expiredTimers){
 					ASSERT(timer)
-					expiredTimers.push_back(timer);
-
-					//Change the expired timer state to not running.
-					//This should be done before the expired signal of the timer will be emitted.
-					timer->isRunning = false;
-
-					this->timers.erase(b);
+					if(timer->period != 0){
+						//Periodic timer stays running, it is rescheduled relative to the moment
+						//it was scheduled to expire rather than current ticks, so it does not drift.
+						this->timers.Insert(*timer, timer->NextDue(ticks));
+					}else{
+						//Change the expired timer state to not running.
+						//This should be done before the expired signal of the timer will be emitted.
+						timer->isRunning = false;
+					}
 				}
 
 				if(expiredTimers.size() == 0){
-					ASSERT(this->timers.size() > 0) //if we have no expired timers here, then at least one timer should be running (the half-max-ticks timer).
-
-					//calculate new waiting time
-					ASSERT(this->timers.begin()->first > ticks)
-					ASSERT(this->timers.begin()->first - ticks <= std::uint64_t(std::uint32_t(-1)))
-					millis = std::uint32_t(this->timers.begin()->first - ticks);
+					//calculate new waiting time, std::uint64_t(-1) if there are no timers
+					deadline = this->timers.NextDeadline();
+					ASSERT(deadline > ticks)
 
 					//zero out the semaphore for optimization purposes
 					while(this->sema.Wait(0)){}
@@ -155,8 +470,441 @@ void Lib::TimerThread::Run(){
 			this->expiredTimersNotifyMutex.unlock();
 		}
 
-		this->sema.Wait(millis);
+		if(deadline == std::uint64_t(-1)){
+			this->sema.Wait();
+		}else{
+			std::uint64_t ticks = GetTicks64();
+			if(deadline > ticks){
+				//In case the deadline is too far, wake up earlier and calculate the waiting time again.
+				//std::uint32_t(-1) is not used as it means infinite wait on Windows.
+				this->sema.Wait(std::uint32_t(std::min(deadline - ticks, std::uint64_t(std::uint32_t(-1) - 1))));
+			}
+		}
 	}//~while(!this->quitFlag)
 
 	M_TIMER_TRACE(<< "Lib::TimerThread::Run(): exit" << std::endl)
 }//~Run()
+
+
+
+namespace{
+
+#if M_COMPILER == M_COMPILER_MSVC
+__declspec(thread)
+#else
+thread_local
+#endif
+TimerQueue* threadTimerQueue = nullptr;
+
+}//~namespace
+
+
+
+TimerQueue::TimerQueue(EStorage storage) :
+		timers(storage, GetTicks64()),
+		ownerThread(ting::mt::Thread::GetCurrentThreadID())
+{
+#if M_OS == M_OS_WINDOWS
+	this->timer = CreateWaitableTimer(
+			NULL, //security attributes
+			TRUE, //manual-reset
+			NULL //no name
+		);
+	if(this->timer == NULL){
+		throw ting::Exc("TimerQueue::TimerQueue(): could not create waitable timer (Win32)");
+	}
+#elif M_OS == M_OS_LINUX
+	this->timerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if(this->timerFD < 0){
+		std::stringstream ss;
+		ss << "TimerQueue::TimerQueue(): could not create timerfd (linux),"
+				<< " error code = " << errno << ": " << strerror(errno);
+		throw ting::Exc(ss.str().c_str());
+	}
+#elif M_OS == M_OS_MACOSX
+	this->queue = kqueue();
+	if(this->queue < 0){
+		std::stringstream ss;
+		ss << "TimerQueue::TimerQueue(): could not create kqueue (Mac OS X),"
+				<< " error code = " << errno << ": " << strerror(errno);
+		throw ting::Exc(ss.str().c_str());
+	}
+#else
+#	error "Unsupported OS"
+#endif
+
+	this->SetReadinessHandler([this](Waitable&, Waitable::EReadinessFlags){
+		this->HandleExpiredTimers();
+	});
+}
+
+
+
+TimerQueue::~TimerQueue()NOEXCEPT{
+	this->DetachFromThisThread();
+
+	//the owner thread might have exited already, the destroying thread takes care of the stopped timers
+	this->ownerThread = ting::mt::Thread::GetCurrentThreadID();
+	this->ReleaseStoppedTimers();
+
+	ASSERT_INFO(this->timers.Size() == 0, "TimerQueue::~TimerQueue(): destroying timer queue with running timers, stop the timers first")
+
+#if M_OS == M_OS_WINDOWS
+	CloseHandle(this->timer);
+#elif M_OS == M_OS_LINUX
+	close(this->timerFD);
+#elif M_OS == M_OS_MACOSX
+	close(this->queue);
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+void TimerQueue::AttachToThisThread()NOEXCEPT{
+	this->ownerThread = ting::mt::Thread::GetCurrentThreadID();
+	threadTimerQueue = this;
+}
+
+
+
+void TimerQueue::DetachFromThisThread()NOEXCEPT{
+	if(threadTimerQueue == this){
+		threadTimerQueue = nullptr;
+	}
+}
+
+
+
+TimerQueue* TimerQueue::OfThisThread()NOEXCEPT{
+	return threadTimerQueue;
+}
+
+
+
+void TimerQueue::StartTimer(Timer& t, std::uint32_t millisec, std::uint32_t period, Timer::EMissedTicks missedTicks){
+	ASSERT_INFO(this->IsOwnedByThisThread(), "TimerQueue::StartTimer(): timers can only be started from the thread which owns the queue")
+
+	t.WaitReleased();
+
+	//NOTE: if called from within OnExpired() of the periodic timer, the timer is still EXPIRING
+	if(t.isRunning || t.state != Timer::STOPPED){
+		throw ting::Exc("TimerQueue::StartTimer(): timer is already running!");
+	}
+
+	std::uint64_t stopTicks = GetTicks64() + std::uint64_t(millisec);
+
+	t.period = period;
+	t.missedTicks = missedTicks;
+
+	this->timers.Insert(t, stopTicks);
+	t.queue = this;
+
+	//the timer is in the storage at this moment, so it can be stopped from other threads
+	t.state.store(Timer::RUNNING, std::memory_order_release);
+
+	if(!this->handlingExpired){
+		try{
+			this->Arm(false);
+		}catch(...){
+			this->StopTimer(t);
+			throw;
+		}
+	}
+}
+
+
+
+bool TimerQueue::StopTimer(Timer& t)NOEXCEPT{
+	if(!this->IsOwnedByThisThread()){
+		for(Timer::EState expected = Timer::RUNNING; !t.state.compare_exchange_weak(expected, Timer::STOPPING); expected = Timer::RUNNING){
+			if(expected == Timer::RUNNING){
+				//spurious failure
+				continue;
+			}
+			if(expected != Timer::EXPIRING){
+				//either expired or is being stopped from another thread
+				return false;
+			}
+			//OnExpired() is being called, wait until it returns, periodic timer stays running after that
+			ting::mt::Thread::Sleep(0);
+		}
+
+		//The timer cannot be removed from the storage by this thread, so pass it to the owner thread.
+		Timer* head = this->stoppedTimers.load(std::memory_order_relaxed);
+		do{
+			t.nextStopped = head;
+		}while(!this->stoppedTimers.compare_exchange_weak(head, &t));
+
+		//wake up the owner thread, see Arm()
+		try{
+			this->SetSystemTimer(0);
+		}catch(...){
+			ASSERT(false)
+		}
+		return true;
+	}
+
+	if(t.state == Timer::EXPIRING){
+		//called from within OnExpired() of this timer, periodic timer is rescheduled already
+		if(!t.isStored){
+			return false;
+		}
+		//the timer is switched to STOPPED state once OnExpired() returns
+		this->timers.Erase(t);
+		return true;
+	}
+
+	Timer::EState expected = Timer::RUNNING;
+	if(!t.state.compare_exchange_strong(expected, Timer::STOPPED)){
+		//either expired or is being stopped from another thread
+		return false;
+	}
+
+	ASSERT(t.queue == this)
+
+	this->RemoveTimer(t);
+
+	//NOTE: the system timer is not re-armed, if the stopped timer was the first one then
+	//      the queue will trigger earlier and HandleExpiredTimers() will re-arm the system timer.
+	t.queue = nullptr;
+	return true;
+}
+
+
+
+void TimerQueue::RemoveTimer(Timer& t)NOEXCEPT{
+	if(!t.isStored){
+		//the timer has expired, but its handler has not been called yet, make sure it will not be called
+		for(auto& e : this->expiredTimers){
+			if(e == &t){
+				e = nullptr;
+			}
+		}
+	}else{
+		this->timers.Erase(t);
+	}
+}
+
+
+
+void TimerQueue::ReleaseStoppedTimers()NOEXCEPT{
+	ASSERT(this->IsOwnedByThisThread())
+
+	Timer* t = this->stoppedTimers.exchange(nullptr, std::memory_order_acquire);
+	while(t){
+		ASSERT(t->state == Timer::STOPPING)
+		ASSERT(t->queue == this)
+
+		//the timer can be destroyed right after its state is changed, so get the next one before that
+		Timer* next = t->nextStopped;
+
+		this->RemoveTimer(*t);
+		t->queue = nullptr;
+		t->state.store(Timer::STOPPED, std::memory_order_release);
+
+		t = next;
+	}
+}
+
+
+
+void TimerQueue::ReleaseExpiringTimer(Timer& t)NOEXCEPT{
+	ASSERT(this->IsOwnedByThisThread())
+	ASSERT(this->expiringTimer == &t)
+	ASSERT(t.state == Timer::EXPIRING)
+	ASSERT(!t.isStored)
+
+	this->expiringTimer = nullptr;
+	t.queue = nullptr;
+	t.state.store(Timer::STOPPED, std::memory_order_release);
+}
+
+
+
+void TimerQueue::Arm(bool force){
+	this->ReleaseStoppedTimers();
+
+	std::uint64_t deadline = this->timers.NextDeadline();
+
+	if(!force && deadline == this->armedFor){
+		return;
+	}
+
+	this->armedFor = deadline;
+
+	this->SetSystemTimer(deadline);
+
+	//Other thread could stop a timer and set the system timer to trigger right away after the stopped
+	//timers were released above, then that setting has just been overwritten. Check for such timers
+	//after setting the system timer and trigger it again, so that the stopped timers are released soon.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(this->stoppedTimers.load(std::memory_order_relaxed)){
+		this->armedFor = 0;
+		this->SetSystemTimer(0);
+	}
+}
+
+
+
+void TimerQueue::SetSystemTimer(std::uint64_t deadline){
+#if M_OS == M_OS_WINDOWS
+	LARGE_INTEGER dueTime;
+	if(deadline == std::uint64_t(-1)){
+		//setting the timer also resets its signaled state, so set it to far future instead of cancelling
+		dueTime.QuadPart = -(LONGLONG(1) << 62);
+	}else{
+		std::uint64_t ticks = GetTicks64();
+		//relative time in 100 nanosecond intervals
+		dueTime.QuadPart = deadline > ticks ? -LONGLONG(deadline - ticks) * 10000 : -1;
+	}
+	if(SetWaitableTimer(this->timer, &dueTime, 0, NULL, NULL, FALSE) == 0){
+		throw ting::Exc("TimerQueue::SetSystemTimer(): SetWaitableTimer() failed");
+	}
+#elif M_OS == M_OS_LINUX
+	itimerspec spec;
+	memset(&spec, 0, sizeof(spec));
+	if(deadline != std::uint64_t(-1)){
+		spec.it_value.tv_sec = time_t(deadline / 1000);
+		spec.it_value.tv_nsec = long((deadline % 1000) * 1000000);
+		if(spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0){
+			spec.it_value.tv_nsec = 1;//zero value would disarm the timer
+		}
+	}
+	if(timerfd_settime(this->timerFD, TFD_TIMER_ABSTIME, &spec, 0) < 0){
+		std::stringstream ss;
+		ss << "TimerQueue::SetSystemTimer(): timerfd_settime() failed, error code = " << errno << ": " << strerror(errno);
+		throw ting::Exc(ss.str().c_str());
+	}
+#elif M_OS == M_OS_MACOSX
+	struct kevent e;
+	if(deadline == std::uint64_t(-1)){
+		EV_SET(&e, 0, EVFILT_TIMER, EV_DELETE, 0, 0, 0);
+	}else{
+		std::uint64_t ticks = GetTicks64();
+		EV_SET(&e, 0, EVFILT_TIMER, EV_ADD | EV_ONESHOT, 0, deadline > ticks ? intptr_t(deadline - ticks) : 0, 0);
+	}
+	const timespec timeout = {0, 0};
+	if(kevent(this->queue, &e, 1, 0, 0, &timeout) < 0 && deadline != std::uint64_t(-1)){
+		//deleting the timer fails if it has already fired, ignore that
+		throw ting::Exc("TimerQueue::SetSystemTimer(): kevent() failed");
+	}
+#else
+#	error "Unsupported OS"
+#endif
+}
+
+
+
+void TimerQueue::HandleExpiredTimers(){
+	ASSERT_INFO(!this->handlingExpired, "TimerQueue::HandleExpiredTimers(): recursive call")
+
+	//clear the readiness of the system timer
+#if M_OS == M_OS_WINDOWS
+	//signaled state of the waitable timer is reset when it is set again by Arm()
+#elif M_OS == M_OS_LINUX
+	{
+		std::uint64_t numExpirations;
+		if(read(this->timerFD, &numExpirations, sizeof(numExpirations)) < 0){
+			//EAGAIN is possible if the timer was re-armed after it has triggered, ignore errors
+		}
+	}
+#elif M_OS == M_OS_MACOSX
+	{
+		struct kevent e;
+		const timespec timeout = {0, 0};
+		kevent(this->queue, 0, 0, &e, 1, &timeout);
+	}
+#else
+#	error "Unsupported OS"
+#endif
+	this->ClearCanReadFlag();
+
+	this->ReleaseStoppedTimers();
+
+	std::uint64_t ticks = GetTicks64();
+
+	//Expired timers are collected before calling handlers, so that timers restarted from
+	//within the handlers with zero timeout do not make this loop infinite.
+	//Expired timers are not stored anymore, but they are still running until their handlers are called.
+	ASSERT(this->expiredTimers.size() == 0)
+	this->timers.PopExpired(ticks, this->expiredTimers);
+
+	this->handlingExpired = true;
+	for(Timer* t : this->expiredTimers){
+		if(!t){
+			//stopped by one of the previous handlers
+			continue;
+		}
+		ASSERT(t->queue == this)
+
+		//The timer stays EXPIRING until OnExpired() returns, so that Stop() called from other
+		//threads waits for that and the timer is not destroyed while its handler is running.
+		Timer::EState expected = Timer::RUNNING;
+		if(!t->state.compare_exchange_strong(expected, Timer::EXPIRING)){
+			//stopped from another thread, it will be released by ReleaseStoppedTimers()
+			ASSERT(expected == Timer::STOPPING)
+			continue;
+		}
+
+		if(t->period != 0){
+			//Periodic timer stays running, it is rescheduled relative to the moment
+			//it was scheduled to expire rather than current ticks, so it does not drift.
+			this->timers.Insert(*t, t->NextDue(ticks));
+		}
+
+		this->expiringTimer = t;
+		t->OnExpired();
+		if(!this->expiringTimer){
+			//restarted elsewhere or destroyed from within the handler
+			continue;
+		}
+		ASSERT(this->expiringTimer == t)
+		this->expiringTimer = nullptr;
+
+		//periodic timer is stored, unless it was stopped from within the handler
+		if(t->isStored){
+			t->state.store(Timer::RUNNING, std::memory_order_release);
+		}else{
+			t->queue = nullptr;
+			t->state.store(Timer::STOPPED, std::memory_order_release);
+		}
+	}
+	this->handlingExpired = false;
+	this->expiredTimers.clear();
+
+	this->Arm(true);
+}
+
+
+
+#if M_OS == M_OS_WINDOWS
+//override
+HANDLE TimerQueue::GetHandle(){
+	return this->timer;
+}
+
+
+
+//override
+bool TimerQueue::CheckSignaled(){
+	if(WaitForSingleObject(this->timer, 0) == WAIT_OBJECT_0){
+		this->SetCanReadFlag();
+	}
+	return this->CanRead();
+}
+
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX
+//override
+int TimerQueue::GetHandle(){
+#	if M_OS == M_OS_LINUX
+	return this->timerFD;
+#	else
+	return this->queue;
+#	endif
+}
+
+#else
+#	error "Unsupported OS"
+#endif
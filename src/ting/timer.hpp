@@ -53,7 +53,7 @@ THE SOFTWARE. */
 #	include "windows.hpp"
 
 #elif M_OS == M_OS_MACOSX
-#	include<sys/time.h>
+#	include <mach/mach_time.h>
 
 #elif M_OS == M_OS_LINUX
 #include <ctime>
@@ -63,6 +63,8 @@ THE SOFTWARE. */
 #endif
 
 
+#include <array>
+#include <atomic>
 #include <vector>
 #include <map>
 #include <algorithm>
@@ -71,6 +73,7 @@ THE SOFTWARE. */
 #include "types.hpp"
 #include "Singleton.hpp"
 #include "math.hpp"
+#include "WaitSet.hpp"
 
 #include "mt/Thread.hpp"
 #include "mt/Semaphore.hpp"
@@ -82,37 +85,49 @@ namespace timer{
 
 
 /**
- * @brief Get constantly increasing millisecond ticks.
+ * @brief Get monotonic nanosecond ticks.
+ * High resolution monotonic clock suitable for measuring latencies.
+ * On Linux it is clock_gettime(CLOCK_MONOTONIC), which is served by vDSO without entering the kernel,
+ * on Windows it is QueryPerformanceCounter() and on Mac OS X it is mach_absolute_time().
+ * The ticks are 64 bit, so they do not wrap around in practice (it takes about 584 years).
  * It is not guaranteed that the ticks counting started at the system start.
- * @return constantly increasing millisecond ticks.
+ * @return constantly increasing nanosecond ticks.
  */
-inline std::uint32_t GetTicks(){
+inline std::uint64_t GetNanoTicks(){
 #if M_OS == M_OS_WINDOWS
 	static LARGE_INTEGER perfCounterFreq = {{0, 0}};
 	if(perfCounterFreq.QuadPart == 0){
 		if(QueryPerformanceFrequency(&perfCounterFreq) == FALSE){
 			//looks like the system does not support high resolution tick counter
-			return GetTickCount();
+			return std::uint64_t(GetTickCount64()) * 1000000;
 		}
 	}
 	LARGE_INTEGER ticks;
 	if(QueryPerformanceCounter(&ticks) == FALSE){
-		return GetTickCount();
+		return std::uint64_t(GetTickCount64()) * 1000000;
 	}
 
-	return std::uint32_t((ticks.QuadPart * 1000) / perfCounterFreq.QuadPart);
+	//convert whole seconds and the remainder separately to avoid overflow
+	return std::uint64_t(ticks.QuadPart / perfCounterFreq.QuadPart) * 1000000000
+			+ std::uint64_t((ticks.QuadPart % perfCounterFreq.QuadPart) * 1000000000 / perfCounterFreq.QuadPart);
 #elif M_OS == M_OS_MACOSX
-	//Mac os X doesn't support clock_gettime
-	timeval t;
-	gettimeofday(&t, 0);
-	return std::uint32_t(t.tv_sec * 1000 + (t.tv_usec / 1000));
+	static mach_timebase_info_data_t timebase = {0, 0};
+	if(timebase.denom == 0){
+		mach_timebase_info(&timebase);
+	}
+
+	std::uint64_t ticks = mach_absolute_time();
+	if(timebase.numer == timebase.denom){
+		return ticks;
+	}
+	return ticks / timebase.denom * timebase.numer + ticks % timebase.denom * timebase.numer / timebase.denom;
 #elif M_OS == M_OS_LINUX
 	timespec ts;
 	if(clock_gettime(CLOCK_MONOTONIC, &ts) == -1){
-		throw ting::Exc("GetTicks(): clock_gettime() returned error");
+		throw ting::Exc("GetNanoTicks(): clock_gettime() returned error");
 	}
 
-	return std::uint32_t(std::uint32_t(ts.tv_sec) * 1000 + std::uint32_t(ts.tv_nsec / 1000000));
+	return std::uint64_t(ts.tv_sec) * 1000000000 + std::uint64_t(ts.tv_nsec);
 #else
 #	error "Unsupported OS"
 #endif
@@ -120,6 +135,52 @@ inline std::uint32_t GetTicks(){
 
 
 
+/**
+ * @brief Get 64 bit millisecond ticks.
+ * Same clock as GetNanoTicks(), but in milliseconds. Timers use these ticks for their deadlines.
+ * @return constantly increasing millisecond ticks.
+ */
+inline std::uint64_t GetTicks64(){
+	return GetNanoTicks() / 1000000;
+}
+
+
+
+/**
+ * @brief Get constantly increasing millisecond ticks.
+ * Lower 32 bits of GetTicks64(), i.e. the value wraps around every 49.7 days, so only the
+ * differences of the close enough values are meaningful. Use GetTicks64() to avoid that.
+ * It is not guaranteed that the ticks counting started at the system start.
+ * @return constantly increasing millisecond ticks.
+ */
+inline std::uint32_t GetTicks(){
+	return std::uint32_t(GetTicks64());
+}
+
+
+
+class TimerQueue;
+
+
+
+/**
+ * @brief Kinds of storage of running timers.
+ * ORDERED_MAP - running timers are kept in std::multimap sorted by expiration time.
+ *               Starting and stopping the timer takes O(log n) time and starting allocates
+ *               a map node. Timers expiring at the same millisecond are handled in the
+ *               order they were started.
+ * WHEEL - hierarchical timing wheel. Starting and stopping the timer takes constant time
+ *         and does not allocate memory, which makes a difference when there are lots of timers
+ *         which are restarted or stopped before they expire, like network timeouts.
+ *         Order of handling timers expiring at the same millisecond is not guaranteed.
+ */
+enum EStorage{
+	ORDERED_MAP,
+	WHEEL
+};
+
+
+
 /**
  * @brief General purpose timer.
  * This is a class representing a timer. Its accuracy is not expected to be high,
@@ -129,28 +190,99 @@ inline std::uint32_t GetTicks(){
  */
 class Timer{
 	friend class Lib;
+	friend class TimerQueue;
+	friend class TimerWheel;
+	friend class TimerStorage;
 
-	//This constant is for testing purposes.
-	//Should be set to std::uint32_t(-1) in release.
-	inline static std::uint32_t DMaxTicks(){
-		return std::uint32_t(-1);
-	}
-	
-	bool isRunning = false;//true if timer has been started and has not stopped yet
+	bool isRunning = false;//true if timer has been started in timer library and has not stopped yet
+
+	//states of the timer started in TimerQueue
+	enum EState{
+		STOPPED,
+		RUNNING,
+		STOPPING,//stopped from another thread, the timer is still referenced by the queue until the queue thread releases it
+		EXPIRING//OnExpired() is being called by the queue thread, the timer cannot be stopped from other threads until it returns
+	};
+
+	std::atomic<EState> state{STOPPED};
+
+public:
+	/**
+	 * @brief Policies of handling missed ticks of periodic timer.
+	 * Tick is missed when the timer expiration was handled so late that one or more of
+	 * the next expiration moments have passed already, for example, because the thread
+	 * handling the timers was busy or the system was suspended.
+	 * SKIP - the missed ticks are skipped, the next expiration is the first moment of the
+	 *        original schedule which is still ahead.
+	 * CATCH_UP - OnExpired() is called for every missed tick, one call right after another,
+	 *            until the timer catches up with its original schedule.
+	 * RESTART - the schedule starts over, the next expiration is one period after the
+	 *           moment the late expiration was handled.
+	 */
+	enum EMissedTicks{
+		SKIP,
+		CATCH_UP,
+		RESTART
+	};
 
 private:
 	typedef std::multimap<std::uint64_t, Timer*> T_TimerList;
 	typedef T_TimerList::iterator T_TimerIter;
 
-	T_TimerIter i;//if timer is running, this is the iterator into the map of timers
+	std::uint64_t due;//ticks when the timer is scheduled to expire
+
+	std::uint64_t deadline;//ticks when the timer expires, this is 'due' adjusted by slack
+
+	std::uint32_t period = 0;//0 for one-shot timers
+
+	EMissedTicks missedTicks = SKIP;
+
+	std::uint32_t slack = 0;//how late the timer is allowed to expire, in milliseconds
+
+	bool isStored = false;//true if the timer is in timer storage, i.e. it is running and has not expired yet
+
+	T_TimerIter i;//if timer is stored in the map, this is the iterator into the map of timers
+
+	//if timer is stored in the timing wheel, these are the links of the list of timers in the wheel slot
+	Timer* prev;
+	Timer* next;
+	unsigned slot;
+
+	std::atomic<TimerQueue*> queue{nullptr};//if timer is running in TimerQueue, this is the pointer to that queue
+
+	Timer* nextStopped;//link of the list of timers stopped from other threads, see TimerQueue
+
+	//Wait until the queue releases the timer if it was stopped from another thread
+	//and until the queue returns from OnExpired() of the timer if it is being called.
+	inline void WaitReleased()NOEXCEPT;
+
+	//Calculate next due ticks of the periodic timer which has expired at the given ticks.
+	std::uint64_t NextDue(std::uint64_t ticks)const NOEXCEPT{
+		ASSERT(this->period != 0)
+		std::uint64_t ret = this->due + this->period;
+		if(ret > ticks){
+			return ret;
+		}
+		switch(this->missedTicks){
+			case CATCH_UP:
+				return ret;
+			case RESTART:
+				return ticks + this->period;
+			default:
+				ASSERT(this->missedTicks == SKIP)
+				return ret + ((ticks - ret) / this->period + 1) * this->period;
+		}
+	}
 
 public:
 
 	/**
 	 * @brief Timer expiration handler.
 	 * This method is called when timer expires.
-	 * Note, that the method is called from a separate thread, so user should
-	 * do all the necessary synchronization when implementing this method.
+	 * Note, that if the timer was started in timer library then the method is called
+	 * from a separate thread, so user should do all the necessary synchronization when implementing this method.
+	 * If the timer was started in a TimerQueue then the method is called from
+	 * the thread which handles the expired timers of that TimerQueue.
 	 * Also, note that expired methods from different timers are called sequentially,
 	 * that means that, for example, if two timers have expired simultaneously then
 	 * the expired method of the first timer is called first, and only after it returns
@@ -174,6 +306,31 @@ public:
 
 	virtual ~Timer()NOEXCEPT;
 
+	/**
+	 * @brief Set timer slack.
+	 * Slack is the amount of time by which the timer expiration is allowed to be delayed.
+	 * The timers are expected to expire within the [timeout, timeout + slack] interval.
+	 * Within that interval the expiration moment is chosen so that the timers having
+	 * close expiration moments expire at the same moment, i.e. the expirations of many timers
+	 * are handled in one wake up of the timer thread (or the TimerQueue thread), which saves
+	 * CPU time and power when there are lots of timers which do not need to be precise, like
+	 * timeouts of idle connections.
+	 * Setting slack takes effect on the next start of the timer.
+	 * By default, the slack is 0, i.e. the timer expires as soon as possible.
+	 * @param millisec - slack in milliseconds.
+	 */
+	void SetSlack(std::uint32_t millisec)NOEXCEPT{
+		this->slack = millisec;
+	}
+
+	/**
+	 * @brief Get timer slack.
+	 * @return timer slack in milliseconds.
+	 */
+	std::uint32_t Slack()const NOEXCEPT{
+		return this->slack;
+	}
+
 	/**
 	 * @brief Start timer.
 	 * After calling this method one can be sure that the timer state has been
@@ -182,11 +339,52 @@ public:
 	 * It is allowed to call the Start() method from within the handler of the timer expired signal.
 	 * If the timer is already running (i.e. it was already started before and has not expired yet)
 	 * the ting::Exc exception will be thrown.
+	 * The timer is started in the timer library, which should be initialized. To start the timer
+	 * in the timer queue attached to the calling thread use
+	 * Start(*TimerQueue::OfThisThread(), millisec), see TimerQueue::AttachToThisThread().
 	 * This method is thread-safe.
 	 * @param millisec - timer timeout in milliseconds.
 	 */
 	inline void Start(std::uint32_t millisec);
 
+	/**
+	 * @brief Start timer in the timer queue.
+	 * Same as Start(std::uint32_t), but the timer is run by the given TimerQueue instead of the
+	 * timer library thread, so its OnExpired() method is called from the thread which handles
+	 * the expired timers of that queue, see TimerQueue for details.
+	 * The timer library does not need to be initialized to use timer queues.
+	 * This method is not thread-safe, it should be called from the thread which handles the queue.
+	 * @param queue - timer queue to run the timer in.
+	 * @param millisec - timer timeout in milliseconds.
+	 */
+	inline void Start(TimerQueue& queue, std::uint32_t millisec);
+
+	/**
+	 * @brief Start periodic timer.
+	 * The timer expires every given period until it is stopped, the first expiration happens
+	 * one period after starting. The timer is rescheduled right when it expires, relative to
+	 * the moment it was scheduled to expire rather than the moment the expiration was handled,
+	 * so the timer does not drift. The timer stays running all the time, so
+	 * Stop() returns true for the running periodic timer, also when it is called from
+	 * within the OnExpired() handler.
+	 * Otherwise, same as Start(std::uint32_t).
+	 * @param period - timer period in milliseconds, should not be 0.
+	 * @param missedTicks - how to handle the expirations which were missed, see EMissedTicks.
+	 * @throw ting::Exc - if the timer is already running or period is 0.
+	 */
+	inline void StartPeriodic(std::uint32_t period, EMissedTicks missedTicks = SKIP);
+
+	/**
+	 * @brief Start periodic timer in the timer queue.
+	 * Same as StartPeriodic(std::uint32_t, EMissedTicks), but the timer is run by the given TimerQueue,
+	 * see Start(TimerQueue&, std::uint32_t).
+	 * @param queue - timer queue to run the timer in.
+	 * @param period - timer period in milliseconds, should not be 0.
+	 * @param missedTicks - how to handle the expirations which were missed, see EMissedTicks.
+	 * @throw ting::Exc - if the timer is already running or period is 0.
+	 */
+	inline void StartPeriodic(TimerQueue& queue, std::uint32_t period, EMissedTicks missedTicks = SKIP);
+
 	/**
 	 * @brief Stop the timer.
 	 * Stops the timer if it was started before. In case it was not started
@@ -196,6 +394,11 @@ public:
 	 * will not be called anymore, unless the timer was not started again from within the callback
 	 * if the callback was called before returning from Stop() method.
 	 * Such case can be caught by checking the return value of the method.
+	 * Timers running in TimerQueue can be stopped from any thread without locking. When stopped
+	 * from a thread other than the one handling the queue, the queue thread is woken up to
+	 * release the timer, and until then restarting or destroying the timer waits for that.
+	 * If the OnExpired() callback is being called by the queue thread at that moment, then
+	 * this method waits until the callback returns, same as for the timers run by the timer library.
 	 * @return true if timer was running and was stopped.
 	 * @return false if timer was not running already when the Stop() method was called. I.e.
 	 *         the timer has expired already or was not started.
@@ -205,6 +408,235 @@ public:
 
 
 
+//Hierarchical timing wheel, see "Hashed and Hierarchical Timing Wheels" by G. Varghese and T. Lauck.
+//The wheel consists of several levels of slots, one slot of level L spans DNumSlots^L ticks.
+//Timer is put to the level according to how far its deadline is, as the time goes the timers
+//of upper level slots are moved (cascaded) to the lower levels. Each slot is an intrusive
+//doubly linked list of timers, so adding and removing a timer takes constant time.
+//Timers which are inserted already overdue are kept in a separate slot which is emptied by the next
+//PopExpired() call, even if it is for the same tick, like the ordered map does.
+class TimerWheel{
+	static const unsigned DSlotBits = 6;
+	static const unsigned DNumSlots = 1 << DSlotBits;//64, so that occupancy of a level fits into one std::uint64_t
+	static const unsigned DNumLevels = 6;//wheel spans 2^36 ticks (about 2 years), farther timers are kept in the top level
+
+	struct Slot{
+		Timer* first = nullptr;
+		Timer* last = nullptr;
+	};
+
+	static const unsigned DOverdueSlot = DNumSlots * DNumLevels;//index of the slot of overdue timers
+
+	std::array<Slot, DNumSlots * DNumLevels + 1> slots;
+
+	std::array<std::uint64_t, DNumLevels> occupied;//bit masks of non-empty slots of each level
+
+	std::uint64_t current;//next tick to process, all the earlier ticks have been processed
+
+	size_t size = 0;
+
+	void Link(Timer& t)NOEXCEPT;
+
+	//move timers from the slot of the level which starts at current tick to lower levels
+	void Cascade(unsigned level)NOEXCEPT;
+
+public:
+	TimerWheel(std::uint64_t ticks)NOEXCEPT;
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+
+	size_t Size()const NOEXCEPT{
+		return this->size;
+	}
+
+	void Insert(Timer& t, std::uint64_t deadline)NOEXCEPT;
+
+	void Erase(Timer& t)NOEXCEPT;
+
+	//Get tick at which the wheel has to be processed next time, std::uint64_t(-1) if the wheel is empty.
+	//It can be earlier than the deadline of the first timer, in case timers need to be cascaded at that tick.
+	//If there are overdue timers, it is the last processed tick.
+	std::uint64_t NextTick()const NOEXCEPT;
+
+	//Process all the ticks up to the given one, timers which have expired are appended to the vector.
+	void PopExpired(std::uint64_t ticks, std::vector<Timer*>& expired);
+};
+
+
+
+//Running timers, either in ordered map or in timing wheel, see EStorage.
+class TimerStorage{
+	const EStorage storage;
+
+	//map requires key uniqueness, but in our case the key is a stop ticks,
+	//so, use std::multimap to allow similar keys.
+	Timer::T_TimerList map;
+
+	TimerWheel wheel;
+
+public:
+	TimerStorage(EStorage storage, std::uint64_t ticks) :
+			storage(storage),
+			wheel(ticks)
+	{}
+
+	size_t Size()const NOEXCEPT{
+		return this->storage == WHEEL ? this->wheel.Size() : this->map.size();
+	}
+
+	//NOTE: the actual deadline of the timer can be later than the given one, by the timer slack.
+	void Insert(Timer& t, std::uint64_t deadline);
+
+	void Erase(Timer& t)NOEXCEPT;
+
+	//Get ticks at which the storage should be checked for expired timers, std::uint64_t(-1) if there are no timers.
+	//With WHEEL storage it can be earlier than the deadline of the first timer, see TimerWheel::NextTick().
+	std::uint64_t NextDeadline()const NOEXCEPT;
+
+	//Remove timers which have expired by the given ticks and append them to the vector.
+	void PopExpired(std::uint64_t ticks, std::vector<Timer*>& expired);
+};
+
+
+
+/**
+ * @brief Queue of timers which can be waited for with WaitSet.
+ * The timer queue allows handling timer expirations in the thread which runs the event loop
+ * based on WaitSet, without involving the timer library thread and the synchronization with it.
+ * The queue is a Waitable which becomes ready for reading when one of its timers expires.
+ * At that moment the owning thread should call HandleExpiredTimers() which calls
+ * OnExpired() of all the expired timers. The queue sets its own readiness handler which does
+ * exactly that, so when WaitSet::Dispatch() is used no extra actions are needed.
+ * All the operations on the timer queue and on the timers running in it should be done
+ * from the same thread, the owner thread of the queue, except for stopping the timers, which
+ * can be done from any thread. The owner thread is the one which has created the queue or
+ * the one which has attached the queue to itself with AttachToThisThread().
+ * The queue is implemented using timerfd on Linux, kqueue timer on Mac OS X and waitable timer on Windows.
+ * The queue should only be waited for READ.
+ */
+class TimerQueue : public Waitable{
+	friend class Timer;
+
+	TimerStorage timers;
+
+	std::atomic<ting::mt::Thread::T_ThreadID> ownerThread;
+
+	//lock-free list of timers stopped from other threads which are to be released by the owner thread
+	std::atomic<Timer*> stoppedTimers{nullptr};
+
+	//timers which have expired and which OnExpired() methods are being called at the moment
+	std::vector<Timer*> expiredTimers;
+
+	//timer which OnExpired() is being called at the moment, nullptr if the timer was restarted
+	//elsewhere or destroyed from within the handler, so it should not be touched after that
+	Timer* expiringTimer = nullptr;
+
+	bool handlingExpired = false;
+
+	//ticks for which the system timer is currently set
+	std::uint64_t armedFor = std::uint64_t(-1);
+
+#if M_OS == M_OS_WINDOWS
+	HANDLE timer;
+#elif M_OS == M_OS_LINUX
+	int timerFD;
+#elif M_OS == M_OS_MACOSX
+	int queue;//kqueue with the timer event
+#else
+#	error "Unsupported OS"
+#endif
+
+	//period is 0 for one-shot timers
+	void StartTimer(Timer& t, std::uint32_t millisec, std::uint32_t period = 0, Timer::EMissedTicks missedTicks = Timer::SKIP);
+
+	bool StopTimer(Timer& t)NOEXCEPT;
+
+	//remove the timer from the timers storage or from the list of expired timers
+	void RemoveTimer(Timer& t)NOEXCEPT;
+
+	//release the timers stopped from other threads, should be called from the owner thread
+	void ReleaseStoppedTimers()NOEXCEPT;
+
+	//Called from within OnExpired() of the timer which is not going to be run by this queue anymore,
+	//i.e. it is restarted elsewhere or destroyed. The timer is switched to STOPPED state right away.
+	void ReleaseExpiringTimer(Timer& t)NOEXCEPT;
+
+	bool IsOwnedByThisThread()const NOEXCEPT{
+		return this->ownerThread == ting::mt::Thread::GetCurrentThreadID();
+	}
+
+	//set the system timer to the expiration time of the first timer in the queue
+	void Arm(bool force);
+
+	//set the system timer to expire at given ticks, 0 means right away
+	void SetSystemTimer(std::uint64_t deadline);
+
+public:
+	/**
+	 * @brief Constructor.
+	 * Creates empty timer queue.
+	 * @param storage - how to store running timers, see EStorage.
+	 * @throw ting::Exc - if creating the system timer failed.
+	 */
+	TimerQueue(EStorage storage = ORDERED_MAP);
+
+	TimerQueue(const TimerQueue&) = delete;
+	TimerQueue& operator=(const TimerQueue&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * All the timers should be stopped before destroying the queue.
+	 */
+	~TimerQueue()NOEXCEPT;
+
+	/**
+	 * @brief Attach the queue to the calling thread.
+	 * After that OfThisThread() called from the calling thread returns this queue, so the code
+	 * running in that thread can start timers in it with Timer::Start(*TimerQueue::OfThisThread(), millisec),
+	 * those timers expire in the calling thread instead of the timer library thread.
+	 * The calling thread becomes the owner of the queue. At most one queue can be attached to a thread,
+	 * the previously attached queue, if any, gets detached.
+	 * The queue should be detached before it is destroyed or before the thread exits.
+	 */
+	void AttachToThisThread()NOEXCEPT;
+
+	/**
+	 * @brief Detach the queue from the calling thread.
+	 * Does nothing if the queue is not attached to the calling thread.
+	 */
+	void DetachFromThisThread()NOEXCEPT;
+
+	/**
+	 * @brief Get timer queue attached to the calling thread.
+	 * @return pointer to the timer queue attached to the calling thread.
+	 * @return nullptr if there is no timer queue attached to the calling thread.
+	 */
+	static TimerQueue* OfThisThread()NOEXCEPT;
+
+	/**
+	 * @brief Call expiration handlers of the expired timers.
+	 * This method should be called when the queue is reported by WaitSet as ready for reading.
+	 * It is allowed to start and stop timers from within the expiration handlers.
+	 */
+	void HandleExpiredTimers();
+
+private:
+#if M_OS == M_OS_WINDOWS
+	HANDLE GetHandle()override;
+
+	bool CheckSignaled()override;
+
+#elif M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX
+	int GetHandle()override;
+
+#else
+#	error "Unsupported OS"
+#endif
+};
+
+
+
 /**
  * @brief Timer library singleton class.
  * This is a singleton class which represents timer library which allows using
@@ -228,34 +660,26 @@ class Lib : public IntrusiveSingleton<Lib>{
 		//mutex used to make sure that after Timer::Stop() method is called the
 		//expired notification callback will not be called
 		std::mutex expiredTimersNotifyMutex;
-		
-		//map requires key uniqueness, but in our case the key is a stop ticks,
-		//so, use std::multimap to allow similar keys.
-		Timer::T_TimerList timers;
 
+		std::atomic<ting::mt::Thread::T_ThreadID> threadID{0};
 
+		TimerStorage timers;
 
-		std::uint64_t ticks = 0;
-		bool incTicks = false;//flag indicates that high word of ticks needs increment
 
-		//This function should be called at least once in 16 days (half of std::uint32_t(-1) milliseconds)
-		//in order to function properly.
-		//This is achieved by having a repeating timer set to 16 days, which will do nothing but
-		//calling this function.
-		inline std::uint64_t GetTicks();
 
-
-
-		TimerThread(){
+		TimerThread(EStorage storage) :
+				timers(storage, GetTicks64())
+		{
 			ASSERT(!this->quitFlag)
 		}
 
 		~TimerThread()NOEXCEPT{
 			//at the time of TimerLib destroying there should be no active timers
-			ASSERT(this->timers.size() == 0)
+			ASSERT(this->timers.Size() == 0)
 		}
 
-		void AddTimer_ts(Timer* timer, std::uint32_t timeout);
+		//period is 0 for one-shot timers
+		void AddTimer_ts(Timer* timer, std::uint32_t timeout, std::uint32_t period = 0, Timer::EMissedTicks missedTicks = Timer::SKIP);
 
 		bool RemoveTimer_ts(Timer* timer)NOEXCEPT;
 
@@ -269,24 +693,15 @@ class Lib : public IntrusiveSingleton<Lib>{
 
 	} thread;
 
-	class HalfMaxTicksTimer : public Timer{
-	public:
-		//override
-		void OnExpired()NOEXCEPT{
-			try{
-				this->Start(Timer::DMaxTicks() / 2);
-			}catch(...){
-				ASSERT(false)
-			}
-		}
-	} halfMaxTicksTimer;
-
 public:
-	inline Lib(){
+	/**
+	 * @brief Constructor.
+	 * @param storage - how to store running timers, see EStorage.
+	 */
+	inline Lib(EStorage storage = ORDERED_MAP) :
+			thread(storage)
+	{
 		this->thread.Start();
-
-		//start timer for half of the max ticks
-		this->halfMaxTicksTimer.OnExpired();
 	}
 
 	/**
@@ -295,14 +710,10 @@ public:
 	 * timers should be stopped. Otherwise, in debug mode it will result in assertion failure.
 	 */
 	~Lib()NOEXCEPT{
-		//stop half max ticks timer
-		while(!this->halfMaxTicksTimer.Stop()){
-			ting::mt::Thread::Sleep(10);
-		}
 #ifdef DEBUG
 		{
 			std::lock_guard<decltype(this->thread.mutex)> mutexGuard(this->thread.mutex);
-			ASSERT(this->thread.timers.size() == 0)
+			ASSERT(this->thread.timers.Size() == 0)
 		}
 #endif
 		this->thread.SetQuitFlagAndSignalSemaphore();
@@ -312,8 +723,30 @@ public:
 
 
 
+inline void Timer::WaitReleased()NOEXCEPT{
+	for(EState s = this->state.load(std::memory_order_acquire); s == STOPPING || s == EXPIRING; s = this->state.load(std::memory_order_acquire)){
+		TimerQueue* q = this->queue.load();
+		if(!q || !q->IsOwnedByThisThread()){
+			ting::mt::Thread::Sleep(0);
+			continue;
+		}
+		if(s == STOPPING){
+			q->ReleaseStoppedTimers();
+			continue;
+		}
+		//called from within OnExpired() of this timer
+		if(!this->isStored){
+			q->ReleaseExpiringTimer(*this);
+		}
+		return;
+	}
+}
+
+
+
 inline Timer::~Timer()NOEXCEPT{
-	ASSERT_INFO(!this->isRunning, "trying to destroy running timer. Stop the timer first and make sure its OnExpired() method will not be called, then destroy the timer object.")
+	this->WaitReleased();
+	ASSERT_INFO(!this->isRunning && this->state == STOPPED, "trying to destroy running timer. Stop the timer first and make sure its OnExpired() method will not be called, then destroy the timer object.")
 }
 
 
@@ -326,28 +759,43 @@ inline void Timer::Start(std::uint32_t millisec){
 
 
 
-inline bool Timer::Stop()NOEXCEPT{
-	ASSERT(Lib::IsCreated())
-	return Lib::Inst().thread.RemoveTimer_ts(this);
+inline void Timer::Start(TimerQueue& queue, std::uint32_t millisec){
+	queue.StartTimer(*this, millisec);
 }
 
 
 
-inline std::uint64_t Lib::TimerThread::GetTicks(){
-	std::uint32_t ticks = ting::timer::GetTicks() % Timer::DMaxTicks();
+inline void Timer::StartPeriodic(std::uint32_t period, EMissedTicks missedTicks){
+	if(period == 0){
+		throw ting::Exc("Timer::StartPeriodic(): period cannot be 0");
+	}
 
-	if(this->incTicks){
-		if(ticks < Timer::DMaxTicks() / 2){
-			this->incTicks = false;
-			this->ticks += (std::uint64_t(Timer::DMaxTicks()) + 1); //update 64 bit ticks counter
-		}
-	}else{
-		if(ticks > Timer::DMaxTicks() / 2){
-			this->incTicks = true;
-		}
+	ASSERT_INFO(Lib::IsCreated(), "Timer library is not initialized, you need to create TimerLib singletone object first")
+
+	Lib::Inst().thread.AddTimer_ts(this, period, period, missedTicks);
+}
+
+
+
+inline void Timer::StartPeriodic(TimerQueue& queue, std::uint32_t period, EMissedTicks missedTicks){
+	if(period == 0){
+		throw ting::Exc("Timer::StartPeriodic(): period cannot be 0");
 	}
 
-	return this->ticks + std::uint64_t(ticks);
+	queue.StartTimer(*this, period, period, missedTicks);
+}
+
+
+
+inline bool Timer::Stop()NOEXCEPT{
+	if(TimerQueue* q = this->queue.load()){
+		return q->StopTimer(*this);
+	}
+	if(!Lib::IsCreated()){
+		//the timer library is not initialized, so the timer was never started in it
+		return false;
+	}
+	return Lib::Inst().thread.RemoveTimer_ts(this);
 }
 
 
@@ -0,0 +1,9 @@
+#include "main.hpp"
+
+
+
+int main(int argc, char *argv[]){
+	TestTingEventLoopPool();
+
+	return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "../../src/ting/debug.hpp"
+
+#include "tests.hpp"
+
+
+
+inline void TestTingEventLoopPool(){
+	test_basic::Run();
+	test_migration::Run();
+	test_remove_from_handler::Run();
+	test_add_failure::Run();
+	test_cross_loop_remove::Run();
+
+	TRACE_ALWAYS(<< "[PASSED]: EventLoopPool test" << std::endl)
+}
@@ -0,0 +1,314 @@
+#include <vector>
+#include <atomic>
+
+#include "../../src/ting/debug.hpp"
+#include "../../src/ting/mt/EventLoopPool.hpp"
+
+#include "tests.hpp"
+
+
+
+namespace{
+
+//Queue with the counter of handled messages
+struct TestQueue : public ting::mt::Queue{
+	std::atomic<unsigned> numHandled;
+
+	TestQueue() :
+			numHandled(0)
+	{}
+
+	void Handle(){
+		while(auto m = this->PeekMsg()){
+			m();
+			++this->numHandled;
+		}
+	}
+};
+
+void WaitForCount(const std::atomic<unsigned>& cnt, unsigned expected){
+	for(unsigned i = 0; cnt != expected; ++i){
+		ASSERT_INFO_ALWAYS(i != 300, "cnt = " << cnt << ", expected = " << expected)
+		ting::mt::Thread::Sleep(10);
+	}
+}
+
+}//~namespace
+
+
+
+namespace test_basic{
+void Run(){
+	ting::mt::EventLoopPool pool(4);
+
+	ASSERT_ALWAYS(pool.NumLoops() == 4)
+
+	std::array<TestQueue, 8> queues;
+
+	for(auto& q : queues){
+		TestQueue* pq = &q;
+		pool.Add(q, ting::Waitable::READ, [pq](ting::Waitable& w){
+			ASSERT_ALWAYS(&w == pq)
+			pq->Handle();
+		});
+	}
+
+	//Waitables are spread evenly among loops
+	for(unsigned i = 0; i != pool.NumLoops(); ++i){
+		ASSERT_INFO_ALWAYS(pool.NumWaitables(i) == 2, "i = " << i << " NumWaitables = " << pool.NumWaitables(i))
+	}
+
+	for(unsigned i = 0; i != 10; ++i){
+		for(auto& q : queues){
+			q.PushMessage([](){});
+		}
+	}
+
+	for(auto& q : queues){
+		WaitForCount(q.numHandled, 10);
+	}
+
+	for(auto& q : queues){
+		ASSERT_ALWAYS(pool.Remove(q))
+		ASSERT_ALWAYS(!pool.Remove(q))
+	}
+
+	for(unsigned i = 0; i != pool.NumLoops(); ++i){
+		ASSERT_ALWAYS(pool.NumWaitables(i) == 0)
+	}
+}
+}//~namespace
+
+
+
+namespace test_migration{
+
+struct BusyQueue : public TestQueue{
+	std::atomic<ting::mt::Thread::T_ThreadID> thread;
+
+	BusyQueue() :
+			thread(0)
+	{}
+};
+
+void Run(){
+	ting::mt::EventLoopPool pool(2, false);
+
+	BusyQueue a, b;
+
+	auto handler = [](ting::Waitable& w){
+		BusyQueue& q = static_cast<BusyQueue&>(w);
+		q.thread = ting::mt::Thread::GetCurrentThreadID();
+		q.Handle();
+	};
+
+	unsigned loopA = pool.Add(a, ting::Waitable::READ, handler);
+	unsigned loopB = pool.Add(b, ting::Waitable::READ, handler);
+
+	ASSERT_ALWAYS(loopA != loopB)
+
+	a.PushMessage([](){});
+	b.PushMessage([](){});
+	WaitForCount(a.numHandled, 1);
+	WaitForCount(b.numHandled, 1);
+
+	ASSERT_ALWAYS(a.thread != b.thread)
+	ting::mt::Thread::T_ThreadID threadB = b.thread;
+
+	//explicit migration
+	pool.Migrate(b, loopA);
+
+	for(unsigned i = 0; pool.NumWaitables(loopA) != 2; ++i){
+		ASSERT_ALWAYS(i != 300)
+		ting::mt::Thread::Sleep(10);
+	}
+	ASSERT_ALWAYS(pool.NumWaitables(loopB) == 0)
+
+	//make both queues busy while they are in the same loop
+	for(unsigned i = 0; i != 10; ++i){
+		a.PushMessage([](){});
+		b.PushMessage([](){});
+		WaitForCount(a.numHandled, 2 + i);
+		WaitForCount(b.numHandled, 2 + i);
+	}
+	ASSERT_ALWAYS(a.thread == b.thread)
+
+	//one of the queues should move to the idle loop
+	pool.Rebalance();
+
+	for(unsigned i = 0; pool.NumWaitables(loopB) != 1; ++i){
+		ASSERT_ALWAYS(i != 300)
+		ting::mt::Thread::Sleep(10);
+	}
+	ASSERT_ALWAYS(pool.NumWaitables(loopA) == 1)
+
+	a.PushMessage([](){});
+	b.PushMessage([](){});
+	WaitForCount(a.numHandled, 12);
+	WaitForCount(b.numHandled, 12);
+	ASSERT_ALWAYS(a.thread != b.thread)
+	ASSERT_ALWAYS(a.thread == threadB || b.thread == threadB)
+
+	//changing flags to not wait for anything, messages should not be handled
+	pool.Change(a, ting::Waitable::NOT_READY);
+	ting::mt::Thread::Sleep(50);
+	a.PushMessage([](){});
+	ting::mt::Thread::Sleep(100);
+	ASSERT_ALWAYS(a.numHandled == 12)
+
+	pool.Change(a, ting::Waitable::READ);
+	WaitForCount(a.numHandled, 13);
+
+	ASSERT_ALWAYS(pool.Remove(a))
+	ASSERT_ALWAYS(pool.Remove(b))
+}
+}//~namespace
+
+
+
+namespace test_remove_from_handler{
+void Run(){
+	ting::mt::EventLoopPool pool(1);
+
+	TestQueue q;
+
+	std::atomic<bool> removed(false);
+
+	TestQueue* pq = &q;
+	ting::mt::EventLoopPool* pp = &pool;
+	std::atomic<bool>* pr = &removed;
+	pool.Add(q, ting::Waitable::READ, [pq, pp, pr](ting::Waitable& w){
+		pq->Handle();
+		ASSERT_ALWAYS(pp->Remove(w))
+		*pr = true;
+	});
+
+	q.PushMessage([](){});
+
+	for(unsigned i = 0; !removed; ++i){
+		ASSERT_ALWAYS(i != 300)
+		ting::mt::Thread::Sleep(10);
+	}
+
+	ASSERT_ALWAYS(!pool.Remove(q))
+	ASSERT_ALWAYS(pool.NumWaitables(0) == 0)
+
+	//message is not handled since the queue was removed
+	q.PushMessage([](){});
+	ting::mt::Thread::Sleep(100);
+	ASSERT_ALWAYS(q.numHandled == 1)
+}
+}//~namespace
+
+
+
+namespace test_add_failure{
+
+#if M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX
+//Waitable which cannot be added to WaitSet
+struct BadWaitable : public ting::Waitable{
+	int GetHandle()override{
+		return -1;
+	}
+};
+#endif
+
+void Run(){
+#if M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX
+	ting::mt::EventLoopPool pool(1);
+
+	//failure handler is called
+	{
+		BadWaitable w;
+		std::atomic<bool> failed(false);
+
+		std::atomic<bool>* pf = &failed;
+		pool.Add(
+				w,
+				ting::Waitable::READ,
+				[](ting::Waitable&){
+					ASSERT_ALWAYS(false)
+				},
+				[&w, pf](ting::Waitable& fw, const ting::Exc&){
+					ASSERT_ALWAYS(&fw == &w)
+					*pf = true;
+				}
+			);
+
+		for(unsigned i = 0; !failed; ++i){
+			ASSERT_ALWAYS(i != 300)
+			ting::mt::Thread::Sleep(10);
+		}
+
+		ASSERT_ALWAYS(pool.NumWaitables(0) == 0)
+		ASSERT_ALWAYS(!pool.Remove(w))
+	}
+
+	//without failure handler the handler is called with error flag set
+	{
+		BadWaitable w;
+		std::atomic<bool> failed(false);
+
+		std::atomic<bool>* pf = &failed;
+		pool.Add(w, ting::Waitable::READ, [pf](ting::Waitable& fw){
+			ASSERT_ALWAYS(fw.ErrorCondition())
+			*pf = true;
+		});
+
+		for(unsigned i = 0; !failed; ++i){
+			ASSERT_ALWAYS(i != 300)
+			ting::mt::Thread::Sleep(10);
+		}
+
+		ASSERT_ALWAYS(pool.NumWaitables(0) == 0)
+		ASSERT_ALWAYS(!pool.Remove(w))
+	}
+#endif
+}
+}//~namespace
+
+
+
+namespace test_cross_loop_remove{
+void Run(){
+	ting::mt::EventLoopPool pool(2);
+
+	std::array<TestQueue, 2> queues;
+
+	std::atomic<unsigned> numRemoved(0);
+	std::atomic<unsigned> numCompleted(0);
+
+	//each queue handler removes the other queue which is owned by the other event loop, blocking removal would deadlock
+	for(unsigned i = 0; i != queues.size(); ++i){
+		TestQueue* pq = &queues[i];
+		TestQueue* other = &queues[(i + 1) % queues.size()];
+		ting::mt::EventLoopPool* pp = &pool;
+		std::atomic<unsigned>* pr = &numRemoved;
+		std::atomic<unsigned>* pc = &numCompleted;
+		pool.Add(*pq, ting::Waitable::READ, [pq, other, pp, pr, pc](ting::Waitable&){
+			pq->Handle();
+			//wait until both handlers are running
+			++*pr;
+			while(*pr < 2){
+				ting::mt::Thread::Sleep(1);
+			}
+			pp->Remove(*other, [pc](){
+				++*pc;
+			});
+		});
+	}
+
+	ASSERT_ALWAYS(pool.NumWaitables(0) == 1)
+	ASSERT_ALWAYS(pool.NumWaitables(1) == 1)
+
+	for(auto& q : queues){
+		q.PushMessage([](){});
+	}
+
+	WaitForCount(numCompleted, 2);
+
+	for(auto& q : queues){
+		ASSERT_ALWAYS(!pool.Remove(q))
+	}
+}
+}//~namespace
@@ -0,0 +1,23 @@
+#pragma once
+
+
+
+namespace test_basic{
+void Run();
+}//~namespace
+
+namespace test_migration{
+void Run();
+}//~namespace
+
+namespace test_remove_from_handler{
+void Run();
+}//~namespace
+
+namespace test_add_failure{
+void Run();
+}//~namespace
+
+namespace test_cross_loop_remove{
+void Run();
+}//~namespace
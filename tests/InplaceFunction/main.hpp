@@ -0,0 +1,15 @@
+#pragma once
+
+#include "../../src/ting/debug.hpp"
+
+#include "tests.hpp"
+
+
+
+inline void TestTingInplaceFunction(){
+	test_basic::Run();
+	test_move::Run();
+	test_captured_objects_lifetime::Run();
+
+	TRACE_ALWAYS(<< "[PASSED]: InplaceFunction test" << std::endl)
+}
@@ -0,0 +1,176 @@
+#include <array>
+#include <memory>
+#include <string>
+#include <functional>
+
+#include "../../src/ting/debug.hpp"
+#include "../../src/ting/InplaceFunction.hpp"
+
+#include "tests.hpp"
+
+
+
+namespace test_basic{
+int Increment(int a){
+	return a + 1;
+}
+
+void Run(){
+	typedef ting::InplaceFunction<int(int), 32> T_Func;
+
+	{
+		T_Func f;
+		ASSERT_ALWAYS(!f)
+		ASSERT_ALWAYS(f == nullptr)
+
+		bool thrown = false;
+		try{
+			f(1);
+		}catch(std::bad_function_call&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+	}
+
+	//lambda
+	{
+		int b = 10;
+		T_Func f = [b](int a){return a + b;};
+		ASSERT_ALWAYS(f)
+		ASSERT_ALWAYS(f != nullptr)
+		ASSERT_ALWAYS(f(3) == 13)
+
+		f = nullptr;
+		ASSERT_ALWAYS(!f)
+	}
+
+	//function pointer
+	{
+		T_Func f = &Increment;
+		ASSERT_ALWAYS(f(3) == 4)
+	}
+
+	//std::function
+	{
+		std::function<int(int)> sf = [](int a){return a * 2;};
+		T_Func f = sf;
+		ASSERT_ALWAYS(f(3) == 6)
+	}
+
+	//null function pointer and empty std::function make empty function
+	{
+		int (*fp)(int) = nullptr;
+		T_Func f = fp;
+		ASSERT_ALWAYS(!f)
+
+		std::function<int(int)> sf;
+		T_Func g = sf;
+		ASSERT_ALWAYS(!g)
+
+		g = std::move(sf);
+		ASSERT_ALWAYS(!g)
+
+		bool thrown = false;
+		try{
+			f(1);
+		}catch(std::bad_function_call&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+
+		//non-null function assigned to empty one
+		f = &Increment;
+		ASSERT_ALWAYS(f)
+		ASSERT_ALWAYS(f(1) == 2)
+		f = Increment;
+		ASSERT_ALWAYS(f(2) == 3)
+	}
+
+	//mutable lambda with captured data which takes the whole storage
+	{
+		std::array<std::uint8_t, 32> data;
+		data.fill(1);
+		ting::InplaceFunction<unsigned(), 32> f = [data]()mutable{
+			unsigned sum = 0;
+			for(auto& d : data){
+				sum += d;
+				++d;
+			}
+			return sum;
+		};
+		ASSERT_ALWAYS(f() == 32)
+		ASSERT_ALWAYS(f() == 64)
+	}
+
+	//reference arguments
+	{
+		ting::InplaceFunction<void(std::string&), 16> f = [](std::string& s){s += "a";};
+		std::string s;
+		f(s);
+		f(s);
+		ASSERT_ALWAYS(s == "aa")
+	}
+}
+}//~namespace
+
+
+
+namespace test_move{
+void Run(){
+	typedef ting::InplaceFunction<int(), 32> T_Func;
+
+	T_Func f1 = [](){return 1;};
+	T_Func f2 = std::move(f1);
+	ASSERT_ALWAYS(!f1)
+	ASSERT_ALWAYS(f2() == 1)
+
+	f1 = [](){return 2;};
+	f2 = std::move(f1);
+	ASSERT_ALWAYS(!f1)
+	ASSERT_ALWAYS(f2() == 2)
+
+	//move-only captures and arguments
+	{
+		std::unique_ptr<int> p(new int(5));
+		struct Callable{
+			std::unique_ptr<int> p;
+			int operator()(){
+				return *this->p;
+			}
+		};
+		T_Func f = Callable{std::move(p)};
+		T_Func g = std::move(f);
+		ASSERT_ALWAYS(g() == 5)
+
+		ting::InplaceFunction<int*(std::unique_ptr<int>), 16> h = [](std::unique_ptr<int> p){return p.get();};
+		std::unique_ptr<int> p2(new int(3));
+		int* raw2 = p2.get();
+		ASSERT_ALWAYS(h(std::move(p2)) == raw2)
+		ASSERT_ALWAYS(!p2)
+	}
+}
+}//~namespace
+
+
+
+namespace test_captured_objects_lifetime{
+void Run(){
+	std::shared_ptr<int> p = std::make_shared<int>(1);
+	ASSERT_ALWAYS(p.use_count() == 1)
+
+	{
+		ting::InplaceFunction<void(), 32> f = [p](){};
+		ASSERT_ALWAYS(p.use_count() == 2)
+
+		ting::InplaceFunction<void(), 32> g = std::move(f);
+		ASSERT_ALWAYS(p.use_count() == 2)
+
+		g = [](){};
+		ASSERT_ALWAYS(p.use_count() == 1)
+
+		g = [p](){};
+		ASSERT_ALWAYS(p.use_count() == 2)
+	}
+	ASSERT_ALWAYS(p.use_count() == 1)
+}
+}//~namespace
@@ -0,0 +1,15 @@
+#pragma once
+
+
+
+namespace test_basic{
+void Run();
+}//~namespace
+
+namespace test_move{
+void Run();
+}//~namespace
+
+namespace test_captured_objects_lifetime{
+void Run();
+}//~namespace
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "../../src/ting/debug.hpp"
+
+#include "tests.hpp"
+
+
+
+inline void TestTingLockFreeQueue(){
+	test_basic::Run();
+	test_full::Run();
+	test_many_producers::Run();
+
+	TRACE_ALWAYS(<< "[PASSED]: LockFreeQueue test" << std::endl)
+}
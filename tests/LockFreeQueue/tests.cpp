@@ -0,0 +1,159 @@
+#include <array>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include "../../src/ting/debug.hpp"
+#include "../../src/ting/WaitSet.hpp"
+#include "../../src/ting/mt/Thread.hpp"
+#include "../../src/ting/mt/LockFreeQueue.hpp"
+
+#include "tests.hpp"
+
+
+
+namespace test_basic{
+void Run(){
+	ting::mt::LockFreeQueue q(5);
+	ASSERT_ALWAYS(q.Capacity() == 8)
+
+	ting::WaitSet ws(1);
+	ws.Add(q, ting::Waitable::READ);
+
+	ASSERT_ALWAYS(!q.PeekMsg())
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 0)
+
+	std::vector<unsigned> handled;
+	for(unsigned i = 0; i != 3; ++i){
+		ASSERT_ALWAYS(q.PushMessage([&handled, i](){handled.push_back(i);}))
+	}
+
+	std::array<ting::Waitable*, 1> buf;
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0, buf) == 1)
+	ASSERT_ALWAYS(buf[0] == &q)
+	ASSERT_ALWAYS(q.CanRead())
+
+	//messages are taken out in the order they were pushed
+	while(auto m = q.PeekMsg()){
+		m();
+	}
+	ASSERT_ALWAYS(handled.size() == 3)
+	for(unsigned i = 0; i != handled.size(); ++i){
+		ASSERT_ALWAYS(handled[i] == i)
+	}
+
+	//queue is not signalled when empty
+	ASSERT_ALWAYS(!q.CanRead())
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 0)
+
+	//wrap around the ring buffer several times
+	for(unsigned i = 0; i != 20; ++i){
+		ASSERT_ALWAYS(q.PushMessage([](){}))
+		ASSERT_ALWAYS(q.PushMessage([](){}))
+		ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 1)
+		ASSERT_ALWAYS(q.PeekMsg())
+		ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 1)
+		ASSERT_ALWAYS(q.PeekMsg())
+		ASSERT_ALWAYS(!q.PeekMsg())
+		ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 0)
+	}
+
+	ws.Remove(q);
+}
+}//~namespace
+
+
+
+namespace test_full{
+void Run(){
+	ting::mt::LockFreeQueue q(4);
+	ASSERT_ALWAYS(q.Capacity() == 4)
+
+	for(unsigned i = 0; i != q.Capacity(); ++i){
+		ASSERT_ALWAYS(q.PushMessage([](){}))
+	}
+
+	//the message is left intact if the queue is full
+	unsigned numCalls = 0;
+	ting::mt::LockFreeQueue::T_Message msg = [&numCalls](){++numCalls;};
+	ASSERT_ALWAYS(!q.PushMessage(std::move(msg)))
+	ASSERT_ALWAYS(msg)
+
+	ASSERT_ALWAYS(q.PeekMsg())
+	ASSERT_ALWAYS(q.PushMessage(std::move(msg)))
+
+	for(unsigned i = 0; i != q.Capacity(); ++i){
+		auto m = q.PeekMsg();
+		ASSERT_ALWAYS(m)
+		m();
+	}
+	ASSERT_ALWAYS(numCalls == 1)
+	ASSERT_ALWAYS(!q.PeekMsg())
+}
+}//~namespace
+
+
+
+namespace test_many_producers{
+
+class Producer : public ting::mt::Thread{
+	ting::mt::LockFreeQueue& q;
+	std::atomic<unsigned>& sum;
+	const unsigned numMessages;
+public:
+	Producer(ting::mt::LockFreeQueue& q, std::atomic<unsigned>& sum, unsigned numMessages) :
+			q(q),
+			sum(sum),
+			numMessages(numMessages)
+	{}
+
+	void Run()override{
+		for(unsigned i = 0; i != this->numMessages; ++i){
+			std::atomic<unsigned>& sum = this->sum;
+			ting::mt::LockFreeQueue::T_Message m = [&sum](){++sum;};
+			while(!this->q.PushMessage(std::move(m))){
+				//queue is full, let the consumer handle some messages
+				ting::mt::Thread::Sleep(0);
+			}
+		}
+	}
+};
+
+void Run(){
+	const unsigned numProducers = 8;
+	const unsigned numMessages = 20000;
+
+	ting::mt::LockFreeQueue q(256);
+
+	ting::WaitSet ws(1);
+	ws.Add(q, ting::Waitable::READ);
+
+	std::atomic<unsigned> sum(0);
+
+	std::vector<std::unique_ptr<Producer>> producers;
+	for(unsigned i = 0; i != numProducers; ++i){
+		producers.push_back(std::unique_ptr<Producer>(new Producer(q, sum, numMessages)));
+		producers.back()->Start();
+	}
+
+	//consume all the messages, waiting on the WaitSet, the consumer should never hang
+	unsigned numHandled = 0;
+	while(numHandled != numProducers * numMessages){
+		ASSERT_ALWAYS(ws.WaitWithTimeout(5000) == 1)
+		while(auto m = q.PeekMsg()){
+			m();
+			++numHandled;
+		}
+	}
+	ASSERT_ALWAYS(sum == numProducers * numMessages)
+
+	for(auto& p : producers){
+		p->Join();
+	}
+
+	ASSERT_ALWAYS(!q.PeekMsg())
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 0)
+
+	ws.Remove(q);
+}
+}//~namespace
@@ -0,0 +1,15 @@
+#pragma once
+
+
+
+namespace test_basic{
+void Run();
+}//~namespace
+
+namespace test_full{
+void Run();
+}//~namespace
+
+namespace test_many_producers{
+void Run();
+}//~namespace
@@ -0,0 +1,9 @@
+#include "main.hpp"
+
+
+
+int main(int argc, char *argv[]){
+	TestTingSpinLock();
+
+	return 0;
+}
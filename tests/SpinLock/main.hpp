@@ -0,0 +1,14 @@
+#pragma once
+
+#include "../../src/ting/debug.hpp"
+
+#include "tests.hpp"
+
+
+
+inline void TestTingSpinLock(){
+	test_try_lock::Run();
+	test_contention::Run();
+
+	TRACE_ALWAYS(<< "[PASSED]: SpinLock test" << std::endl)
+}
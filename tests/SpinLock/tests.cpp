@@ -0,0 +1,93 @@
+#include <mutex>
+#include <vector>
+#include <memory>
+
+#include "../../src/ting/debug.hpp"
+#include "../../src/ting/mt/Thread.hpp"
+#include "../../src/ting/mt/SpinLock.hpp"
+#include "../../src/ting/mt/AdaptiveSpinLock.hpp"
+
+#include "tests.hpp"
+
+
+
+namespace test_try_lock{
+
+template <class T_Lock> void TestLock(){
+	T_Lock l;
+
+	ASSERT_ALWAYS(l.try_lock())
+	ASSERT_ALWAYS(!l.try_lock())
+	l.unlock();
+
+	{
+		std::lock_guard<T_Lock> guard(l);
+		ASSERT_ALWAYS(!l.try_lock())
+	}
+
+	ASSERT_ALWAYS(l.try_lock())
+	l.unlock();
+}
+
+void Run(){
+	TestLock<ting::mt::SpinLock>();
+	TestLock<ting::mt::AdaptiveSpinLock>();
+}
+}//~namespace
+
+
+
+namespace test_contention{
+
+template <class T_Lock> void TestLock(unsigned numThreads, unsigned numIterations, unsigned sleepEvery){
+	T_Lock l;
+	unsigned counter = 0;//protected by the lock
+
+	class TestThread : public ting::mt::Thread{
+	public:
+		T_Lock& l;
+		unsigned& counter;
+		unsigned numIterations;
+		unsigned sleepEvery;
+
+		TestThread(T_Lock& l, unsigned& counter, unsigned numIterations, unsigned sleepEvery) :
+				l(l),
+				counter(counter),
+				numIterations(numIterations),
+				sleepEvery(sleepEvery)
+		{}
+
+		void Run()override{
+			for(unsigned i = 0; i != this->numIterations; ++i){
+				std::lock_guard<T_Lock> guard(this->l);
+				++this->counter;
+				if(this->sleepEvery != 0 && i % this->sleepEvery == 0){
+					//hold the lock long enough for the other threads to go to sleep
+					ting::mt::Thread::Sleep(1);
+				}
+			}
+		}
+	};
+
+	std::vector<std::unique_ptr<TestThread>> threads;
+	for(unsigned i = 0; i != numThreads; ++i){
+		threads.push_back(std::unique_ptr<TestThread>(new TestThread(l, counter, numIterations, sleepEvery)));
+		threads.back()->Start();
+	}
+
+	for(auto& t : threads){
+		t->Join();
+	}
+
+	ASSERT_ALWAYS(counter == numThreads * numIterations)
+}
+
+void Run(){
+	TestLock<ting::mt::AdaptiveSpinLock>(8, 100000, 0);
+
+	//long critical sections, waiting threads should go to sleep
+	TestLock<ting::mt::AdaptiveSpinLock>(8, 1000, 50);
+
+	TestLock<ting::mt::SpinLock>(8, 20000, 0);
+}
+}//~namespace
@@ -0,0 +1,11 @@
+#pragma once
+
+
+
+namespace test_try_lock{
+void Run();
+}//~namespace
+
+namespace test_contention{
+void Run();
+}//~namespace
@@ -19,5 +19,11 @@ inline void TestTingThread(){
 //	TRACE(<< "running TestNestedJoin" << std::endl)
 	TestNestedJoin::Run();
 
+//	TRACE(<< "running TestSemaphore" << std::endl)
+	TestSemaphore::Run();
+
+//	TRACE(<< "running TestSettings" << std::endl)
+	TestSettings::Run();
+
 	TRACE_ALWAYS(<< "[PASSED]: Thread test" << std::endl)
 }
@@ -1,6 +1,19 @@
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <string>
+
+#include "../../src/ting/config.hpp"
+
+#if M_OS == M_OS_LINUX
+#	include <sched.h>
+#	include <pthread.h>
+#endif
+
 #include "../../src/ting/debug.hpp"
 #include "../../src/ting/mt/Thread.hpp"
 #include "../../src/ting/mt/MsgThread.hpp"
+#include "../../src/ting/mt/Semaphore.hpp"
 #include "../../src/ting/Buffer.hpp"
 #include "../../src/ting/types.hpp"
 #include "../../src/ting/config.hpp"
@@ -190,3 +203,154 @@ void Run(){
 
 
 }//~namespace
+
+
+
+namespace TestSemaphore{
+
+class PingPongThread : public ting::mt::Thread{
+public:
+	ting::mt::Semaphore& in;
+	ting::mt::Semaphore& out;
+	unsigned numIterations;
+
+	PingPongThread(ting::mt::Semaphore& in, ting::mt::Semaphore& out, unsigned numIterations) :
+			in(in),
+			out(out),
+			numIterations(numIterations)
+	{}
+
+	//override
+	void Run(){
+		for(unsigned i = 0; i != this->numIterations; ++i){
+			this->in.Wait();
+			this->out.Signal();
+		}
+	}
+};
+
+
+
+void Run(){
+	//initial value and timeouts
+	{
+		ting::mt::Semaphore sema(2);
+		ASSERT_ALWAYS(sema.Wait(0))
+		ASSERT_ALWAYS(sema.Wait(100))
+		ASSERT_ALWAYS(!sema.Wait(0))
+
+		auto start = std::chrono::steady_clock::now();
+		ASSERT_ALWAYS(!sema.Wait(100))
+		ASSERT_ALWAYS(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(100))
+
+		sema.Signal();
+		sema.Wait();
+	}
+
+	//waking up threads sleeping on the semaphore
+	{
+		const unsigned DNumIterations = 20000;
+
+		ting::mt::Semaphore ping, pong;
+		PingPongThread t(ping, pong, DNumIterations);
+		t.Start();
+
+		for(unsigned i = 0; i != DNumIterations; ++i){
+			ping.Signal();
+			if(i % 2 == 0){
+				pong.Wait();
+			}else{
+				ASSERT_ALWAYS(pong.Wait(10000))
+			}
+		}
+
+		t.Join();
+		ASSERT_ALWAYS(!ping.Wait(0))
+		ASSERT_ALWAYS(!pong.Wait(0))
+	}
+
+	//many waiters
+	{
+		const unsigned DNumThreads = 8;
+		const unsigned DNumIterations = 2000;
+
+		ting::mt::Semaphore in, out;
+
+		std::vector<std::unique_ptr<PingPongThread>> threads;
+		for(unsigned i = 0; i != DNumThreads; ++i){
+			threads.push_back(std::unique_ptr<PingPongThread>(new PingPongThread(in, out, DNumIterations)));
+			threads.back()->Start();
+		}
+
+		for(unsigned i = 0; i != DNumThreads * DNumIterations; ++i){
+			in.Signal();
+		}
+		for(unsigned i = 0; i != DNumThreads * DNumIterations; ++i){
+			out.Wait();
+		}
+
+		for(auto& t : threads){
+			t->Join();
+		}
+	}
+}
+
+}//~namespace
+
+
+
+namespace TestSettings{
+
+class TestThread : public ting::mt::Thread{
+public:
+	volatile bool success = false;
+
+	//override
+	void Run(){
+#if M_OS == M_OS_LINUX
+		char name[16];
+		ASSERT_ALWAYS(pthread_getname_np(pthread_self(), name, sizeof(name)) == 0)
+		//name is truncated to 15 characters
+		ASSERT_ALWAYS(std::string(name) == "ting.test.threa")
+
+		cpu_set_t set;
+		ASSERT_ALWAYS(sched_getaffinity(0, sizeof(set), &set) == 0)
+		ASSERT_ALWAYS(CPU_COUNT(&set) == 1)
+		ASSERT_ALWAYS(CPU_ISSET(0, &set))
+
+		ASSERT_ALWAYS(sched_getscheduler(0) == SCHED_BATCH)
+#endif
+
+		//settings can be changed from within the thread
+		ting::mt::Thread::SetCurrentThreadName("renamed");
+		ting::mt::Thread::SetCurrentThreadScheduling(ting::mt::Thread::NORMAL);
+#if M_OS == M_OS_LINUX
+		ASSERT_ALWAYS(sched_getscheduler(0) == SCHED_OTHER)
+#endif
+
+		this->success = true;
+	}
+};
+
+
+
+void Run(){
+	TestThread t;
+	t.SetName("ting.test.thread");
+	t.SetAffinity({0});
+	t.SetScheduling(ting::mt::Thread::BATCH, 1);
+	t.Start();
+
+	bool thrown = false;
+	try{
+		t.SetName("other");
+	}catch(ting::mt::Thread::HasAlreadyBeenStartedExc&){
+		thrown = true;
+	}
+	ASSERT_ALWAYS(thrown)
+
+	t.Join();
+	ASSERT_ALWAYS(t.success)
+}
+
+}//~namespace
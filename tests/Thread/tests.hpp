@@ -23,3 +23,11 @@ void Run();
 namespace TestNestedJoin{
 void Run();
 }//~namespace
+
+namespace TestSemaphore{
+void Run();
+}//~namespace
+
+namespace TestSettings{
+void Run();
+}//~namespace
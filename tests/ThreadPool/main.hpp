@@ -0,0 +1,19 @@
+#pragma once
+
+#include "../../src/ting/debug.hpp"
+
+#include "tests.hpp"
+
+
+
+inline void TestTingThreadPool(){
+	test_promise_future::Run();
+	test_future_waitable::Run();
+	test_basic::Run();
+	test_fork_join::Run();
+	test_many_submitters::Run();
+	test_parallel_for::Run();
+	test_parallel_reduce::Run();
+
+	TRACE_ALWAYS(<< "[PASSED]: ThreadPool test" << std::endl)
+}
@@ -0,0 +1,478 @@
+#include <array>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+
+#include "../../src/ting/debug.hpp"
+#include "../../src/ting/WaitSet.hpp"
+#include "../../src/ting/mt/Thread.hpp"
+#include "../../src/ting/mt/MsgThread.hpp"
+#include "../../src/ting/mt/ThreadPool.hpp"
+#include "../../src/ting/mt/Parallel.hpp"
+
+#include "tests.hpp"
+
+
+
+namespace test_promise_future{
+void Run(){
+	//value
+	{
+		ting::mt::Promise<std::unique_ptr<int>> p;
+		ting::mt::Future<std::unique_ptr<int>> f = p.GetFuture();
+		ASSERT_ALWAYS(f.IsValid())
+		ASSERT_ALWAYS(!f.IsReady())
+		ASSERT_ALWAYS(!f.WaitWithTimeout(10))
+
+		p.SetValue(std::unique_ptr<int>(new int(13)));
+		ASSERT_ALWAYS(f.IsReady())
+		ASSERT_ALWAYS(f.WaitWithTimeout(0))
+
+		std::unique_ptr<int> v = f.Get();
+		ASSERT_ALWAYS(v && *v == 13)
+		ASSERT_ALWAYS(!f.IsValid())
+	}
+
+	//future can be retrieved only once
+	{
+		ting::mt::Promise<int> p;
+		ting::mt::Future<int> f = p.GetFuture();
+		bool thrown = false;
+		try{
+			p.GetFuture();
+		}catch(ting::mt::Future<int>::Exc&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+		p.SetValue(1);
+		ASSERT_ALWAYS(f.Get() == 1)
+	}
+
+	//value set from other thread
+	{
+		ting::mt::Promise<void> p;
+		ting::mt::Future<void> f = p.GetFuture();
+
+		class TestThread : public ting::mt::Thread{
+		public:
+			ting::mt::Promise<void>& p;
+
+			TestThread(ting::mt::Promise<void>& p) :
+					p(p)
+			{}
+
+			void Run()override{
+				ting::mt::Thread::Sleep(50);
+				this->p.SetValue();
+			}
+		} thr(p);
+
+		thr.Start();
+		f.Wait();
+		ASSERT_ALWAYS(f.IsReady())
+		f.Get();
+		thr.Join();
+	}
+
+	//abandoned promise
+	{
+		ting::mt::Future<int> f;
+		{
+			ting::mt::Promise<int> p;
+			f = p.GetFuture();
+		}
+		ASSERT_ALWAYS(f.IsReady())
+		bool thrown = false;
+		try{
+			f.Get();
+		}catch(ting::mt::Future<int>::Exc&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+	}
+}
+}//~namespace
+
+
+
+namespace test_future_waitable{
+
+class TestThread : public ting::mt::MsgThread{
+public:
+	unsigned numCalls = 0;//accessed only from this thread
+
+	void Run()override{
+		ting::WaitSet ws(1);
+		ws.Add(this->queue, ting::Waitable::READ);
+		while(!this->quitFlag){
+			ws.Wait();
+			while(auto m = this->queue.PeekMsg()){
+				m();
+			}
+		}
+		ws.Remove(this->queue);
+	}
+};
+
+void Run(){
+	//future set before adding to WaitSet
+	{
+		ting::mt::Promise<int> p;
+		ting::mt::Future<int> f = p.GetFuture();
+		p.SetValue(5);
+
+		ting::WaitSet ws(1);
+		ws.Add(f, ting::Waitable::READ);
+		ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 1)
+		ASSERT_ALWAYS(f.CanRead())
+		//stays ready
+		ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 1)
+		ws.Remove(f);
+		ASSERT_ALWAYS(f.Get() == 5)
+	}
+
+	//future set from other thread while waiting in WaitSet
+	{
+		TestThread thr;
+		thr.Start();
+
+		ting::WaitSet ws(2);
+
+		ting::mt::Future<unsigned> f1 = thr.PushCall([&thr](){
+			ting::mt::Thread::Sleep(50);
+			return ++thr.numCalls;
+		});
+		ting::mt::Future<void> f2 = thr.PushCall([](){
+			throw std::runtime_error("test");
+		});
+
+		ws.Add(f1, ting::Waitable::READ);
+		ws.Add(f2, ting::Waitable::READ);
+
+		//not ready yet
+		ASSERT_ALWAYS(ws.WaitWithTimeout(10) == 0)
+
+		std::array<ting::Waitable*, 2> triggered;
+		unsigned numReady = 0;
+		while(numReady != 2){
+			unsigned num = ws.WaitWithTimeout(5000, triggered);
+			ASSERT_ALWAYS(num != 0)
+			for(unsigned i = 0; i != num; ++i){
+				ASSERT_ALWAYS(triggered[i] == &f1 || triggered[i] == &f2)
+				ws.Remove(*triggered[i]);
+				++numReady;
+			}
+		}
+
+		ASSERT_ALWAYS(f1.Get() == 1)
+
+		bool thrown = false;
+		try{
+			f2.Get();
+		}catch(std::runtime_error&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+
+		thr.PushQuitMessage();
+		thr.Join();
+	}
+
+	//call which was not handled by the thread
+	{
+		ting::mt::Future<int> f;
+		{
+			TestThread thr;
+			f = thr.PushCall([](){return 10;});
+		}
+		ASSERT_ALWAYS(f.IsReady())
+		bool thrown = false;
+		try{
+			f.Get();
+		}catch(ting::mt::Future<int>::Exc&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+	}
+}
+}//~namespace
+
+
+
+namespace test_basic{
+void Run(){
+	ting::mt::ThreadPool pool(4);
+	ASSERT_ALWAYS(pool.NumThreads() == 4)
+
+	{
+		auto f = pool.Submit([](){return std::string("hello");});
+		ASSERT_ALWAYS(f.Get() == "hello")
+	}
+
+	{
+		std::atomic<unsigned> counter(0);
+		auto f = pool.Submit([&counter](){++counter;});
+		f.Wait();
+		f.Get();
+		ASSERT_ALWAYS(counter == 1)
+	}
+
+	//exception thrown by task is delivered through the future
+	{
+		auto f = pool.Submit([]() -> int{throw std::runtime_error("test");});
+		bool thrown = false;
+		try{
+			f.Get();
+		}catch(std::runtime_error& e){
+			thrown = true;
+			ASSERT_ALWAYS(std::string(e.what()) == "test")
+		}
+		ASSERT_ALWAYS(thrown)
+	}
+
+	//move-only task function
+	{
+		std::unique_ptr<int> p(new int(10));
+		struct Functor{
+			std::unique_ptr<int> p;
+			int operator()(){
+				return *this->p * 2;
+			}
+		};
+		auto f = pool.Submit(Functor{std::move(p)});
+		ASSERT_ALWAYS(f.Get() == 20)
+	}
+
+	//destructor waits for all the submitted tasks
+	{
+		std::atomic<unsigned> counter(0);
+		{
+			ting::mt::ThreadPool p(2);
+			for(unsigned i = 0; i != 100; ++i){
+				p.Submit([&counter](){
+					ting::mt::Thread::Sleep(1);
+					++counter;
+				});
+			}
+		}
+		ASSERT_ALWAYS(counter == 100)
+	}
+}
+}//~namespace
+
+
+
+namespace test_fork_join{
+
+unsigned Fib(ting::mt::ThreadPool& pool, unsigned n){
+	if(n < 2){
+		return n;
+	}
+	if(n < 12){
+		return Fib(pool, n - 1) + Fib(pool, n - 2);
+	}
+	auto f = pool.Submit([&pool, n](){return Fib(pool, n - 1);});
+	unsigned b = Fib(pool, n - 2);
+	pool.Wait(f);
+	return f.Get() + b;
+}
+
+void Run(){
+	ting::mt::ThreadPool pool;
+
+	auto f = pool.Submit([&pool](){return Fib(pool, 27);});
+	pool.Wait(f);
+	ASSERT_ALWAYS(f.Get() == 196418)
+
+	//waiting from within tasks should not dead-lock even on single worker
+	ting::mt::ThreadPool pool1(1);
+	auto f1 = pool1.Submit([&pool1](){return Fib(pool1, 20);});
+	ASSERT_ALWAYS(f1.Get() == 6765)
+}
+}//~namespace
+
+
+
+namespace test_many_submitters{
+void Run(){
+	ting::mt::ThreadPool pool(3);
+
+	const unsigned DNumThreads = 8;
+	const unsigned DNumTasksPerThread = 2000;
+
+	std::atomic<unsigned> counter(0);
+
+	class Submitter : public ting::mt::Thread{
+	public:
+		ting::mt::ThreadPool& pool;
+		std::atomic<unsigned>& counter;
+		unsigned numTasks;
+		unsigned sum = 0;
+
+		Submitter(ting::mt::ThreadPool& pool, std::atomic<unsigned>& counter, unsigned numTasks) :
+				pool(pool),
+				counter(counter),
+				numTasks(numTasks)
+		{}
+
+		void Run()override{
+			std::vector<ting::mt::Future<unsigned>> futures;
+			for(unsigned i = 0; i != this->numTasks; ++i){
+				std::atomic<unsigned>& c = this->counter;
+				futures.push_back(this->pool.Submit([&c, i](){
+					++c;
+					return i;
+				}));
+			}
+			for(auto& f : futures){
+				this->sum += f.Get();
+			}
+		}
+	};
+
+	std::vector<std::unique_ptr<Submitter>> threads;
+	for(unsigned i = 0; i != DNumThreads; ++i){
+		threads.push_back(std::unique_ptr<Submitter>(new Submitter(pool, counter, DNumTasksPerThread)));
+		threads.back()->Start();
+	}
+
+	for(auto& t : threads){
+		t->Join();
+		ASSERT_ALWAYS(t->sum == DNumTasksPerThread * (DNumTasksPerThread - 1) / 2)
+	}
+
+	ASSERT_ALWAYS(counter == DNumThreads * DNumTasksPerThread)
+}
+}//~namespace
+
+
+
+namespace test_parallel_for{
+void Run(){
+	ting::mt::ThreadPool pool(4);
+
+	std::vector<std::uint32_t> v(100000);
+	for(std::size_t i = 0; i != v.size(); ++i){
+		v[i] = std::uint32_t(i);
+	}
+
+	std::atomic<unsigned> numChunks(0);
+	ting::mt::ParallelFor(pool, ting::Buffer<std::uint32_t>(v), 1000, [&numChunks](ting::Buffer<std::uint32_t> chunk){
+		ASSERT_ALWAYS(chunk.size() != 0)
+		ASSERT_ALWAYS(chunk.size() <= 1000)
+		++numChunks;
+		for(auto& e : chunk){
+			e *= 2;
+		}
+	});
+	ASSERT_ALWAYS(numChunks >= 100)
+
+	for(std::size_t i = 0; i != v.size(); ++i){
+		ASSERT_ALWAYS(v[i] == std::uint32_t(i * 2))
+	}
+
+	//default grain
+	numChunks = 0;
+	ting::mt::ParallelFor(pool, ting::Buffer<std::uint32_t>(v), 0, [&numChunks](ting::Buffer<std::uint32_t> chunk){
+		++numChunks;
+		for(auto& e : chunk){
+			e /= 2;
+		}
+	});
+	ASSERT_ALWAYS(numChunks > 1)
+	for(std::size_t i = 0; i != v.size(); ++i){
+		ASSERT_ALWAYS(v[i] == std::uint32_t(i))
+	}
+
+	//empty buffer
+	ting::mt::ParallelFor(pool, ting::Buffer<std::uint32_t>(), 0, [](ting::Buffer<std::uint32_t>){
+		ASSERT_ALWAYS(false)
+	});
+
+	//exception
+	{
+		bool thrown = false;
+		try{
+			ting::mt::ParallelFor(pool, ting::Buffer<std::uint32_t>(v), 100, [](ting::Buffer<std::uint32_t> chunk){
+				if(chunk[0] <= 5000 && 5000 < chunk[0] + chunk.size()){
+					throw std::runtime_error("test");
+				}
+			});
+		}catch(std::runtime_error&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+	}
+
+	//nested use from within a task
+	{
+		auto f = pool.Submit([&pool, &v](){
+			ting::mt::ParallelFor(pool, ting::Buffer<std::uint32_t>(v), 500, [](ting::Buffer<std::uint32_t> chunk){
+				for(auto& e : chunk){
+					++e;
+				}
+			});
+		});
+		f.Get();
+		for(std::size_t i = 0; i != v.size(); ++i){
+			ASSERT_ALWAYS(v[i] == std::uint32_t(i + 1))
+		}
+	}
+}
+}//~namespace
+
+
+
+namespace test_parallel_reduce{
+void Run(){
+	ting::mt::ThreadPool pool(4);
+
+	std::vector<std::uint64_t> v(100000);
+	for(std::size_t i = 0; i != v.size(); ++i){
+		v[i] = i;
+	}
+
+	std::uint64_t sum = ting::mt::ParallelReduce(
+			pool,
+			ting::Buffer<const std::uint64_t>(v),
+			1000,
+			std::uint64_t(0),
+			[](ting::Buffer<const std::uint64_t> chunk){
+				std::uint64_t s = 0;
+				for(auto e : chunk){
+					s += e;
+				}
+				return s;
+			},
+			[](std::uint64_t a, std::uint64_t b){
+				return a + b;
+			}
+		);
+	ASSERT_ALWAYS(sum == std::uint64_t(v.size()) * (v.size() - 1) / 2)
+
+	//combine function is not commutative, the chunks order should be preserved
+	std::vector<char> str(5000);
+	for(std::size_t i = 0; i != str.size(); ++i){
+		str[i] = char('a' + i % 26);
+	}
+	std::string res = ting::mt::ParallelReduce(
+			pool,
+			ting::Buffer<const char>(str),
+			0,
+			std::string(),
+			[](ting::Buffer<const char> chunk){
+				return std::string(chunk.begin(), chunk.end());
+			},
+			[](std::string a, std::string b){
+				return a + b;
+			}
+		);
+	ASSERT_ALWAYS(res == std::string(str.begin(), str.end()))
+
+	//empty buffer
+	ASSERT_ALWAYS(ting::mt::ParallelReduce(pool, ting::Buffer<const char>(), 0, std::string("identity"), [](ting::Buffer<const char>){return std::string();}, [](std::string a, std::string){return a;}) == "identity")
+}
+}//~namespace
@@ -0,0 +1,31 @@
+#pragma once
+
+
+
+namespace test_promise_future{
+void Run();
+}//~namespace
+
+namespace test_future_waitable{
+void Run();
+}//~namespace
+
+namespace test_basic{
+void Run();
+}//~namespace
+
+namespace test_fork_join{
+void Run();
+}//~namespace
+
+namespace test_many_submitters{
+void Run();
+}//~namespace
+
+namespace test_parallel_for{
+void Run();
+}//~namespace
+
+namespace test_parallel_reduce{
+void Run();
+}//~namespace
@@ -7,8 +7,28 @@
 
 
 inline void TestTingWaitSet(){
-	test_general::Run();
 	test_message_queue_as_waitable::Run();
+	test_message_queue_batch_peek::Run();
+	test_message_queue_priorities::Run();
+	test_message_queue_no_alloc::Run();
+
+	for(auto backend : {ting::WaitSet::NATIVE, ting::WaitSet::IO_URING}){
+		if(ting::WaitSet(1, backend).Backend() != backend){
+			TRACE_ALWAYS(<< "WaitSet backend " << backend << " is not available, skipping" << std::endl)
+			continue;
+		}
+		test_general::Run(backend);
+		test_edge_triggered::Run(backend);
+		test_one_shot::Run(backend);
+		test_batches::Run(backend);
+		test_dispatch::Run(backend);
+		test_remove_and_add::Run(backend);
+		test_deferred::Run(backend);
+		test_deferred_failure::Run(backend);
+		test_chrono_timeouts::Run(backend);
+		test_busy_poll::Run(backend);
+		test_stats::Run(backend);
+	}
 
 	TRACE_ALWAYS(<< "[PASSED]: WaitSet test" << std::endl)
 }
@@ -1,13 +1,42 @@
+#include <set>
+#include <new>
+#include <array>
+#include <atomic>
 #include <vector>
+#include <chrono>
+#include <cstdlib>
 
 #include "../../src/ting/debug.hpp"
 #include "../../src/ting/WaitSet.hpp"
 #include "../../src/ting/mt/MsgThread.hpp"
 
+#if M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX
+#	include <unistd.h>
+#endif
+
 #include "tests.hpp"
 
 
 
+namespace{
+std::atomic<unsigned> numAllocations(0);
+}
+
+//count allocations to check that pushing messages to the queue does not allocate memory
+void* operator new(std::size_t size){
+	++numAllocations;
+	if(void* p = std::malloc(size)){
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p)NOEXCEPT{
+	std::free(p);
+}
+
+
+
 namespace test_message_queue_as_waitable{
 
 class TestThread : public ting::mt::MsgThread{
@@ -42,8 +71,8 @@ void Run(){
 
 
 namespace test_general{
-void Run(){
-	ting::WaitSet ws(4);
+void Run(ting::WaitSet::EBackend backend){
+	ting::WaitSet ws(4, backend);
 
 	ting::mt::Queue q1, q2;
 
@@ -111,3 +140,808 @@ void Run(){
 	ws.Remove(q2);
 }
 }//~namespace
+
+
+
+namespace test_edge_triggered{
+void Run(ting::WaitSet::EBackend backend){
+	ting::WaitSet ws(1, backend);
+
+	ting::mt::Queue q;
+
+	ws.Add(q, ting::Waitable::READ, ting::Waitable::EDGE_TRIGGERED);
+
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 0)
+
+	q.PushMessage([](){});
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100) == 1)
+	ASSERT_ALWAYS(q.CanRead())
+
+	//the queue is still readable, but no new edge has happened, so it should not trigger
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100) == 0)
+	ASSERT_ALWAYS(q.CanRead())
+
+	//pushing second message does not cause an edge since the queue is not empty
+	q.PushMessage([](){});
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100) == 0)
+
+	ASSERT_ALWAYS(q.PeekMsg())
+	ASSERT_ALWAYS(q.PeekMsg())
+	ASSERT_ALWAYS(!q.CanRead())
+
+	//queue became non-empty again, this is an edge
+	q.PushMessage([](){});
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100) == 1)
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100) == 0)
+
+	ASSERT_ALWAYS(q.PeekMsg())
+
+	ws.Remove(q);
+}
+}//~namespace
+
+
+
+namespace test_one_shot{
+void Run(ting::WaitSet::EBackend backend){
+	ting::WaitSet ws(1, backend);
+
+	ting::mt::Queue q;
+
+	ws.Add(q, ting::Waitable::READ, ting::Waitable::ONE_SHOT);
+
+	q.PushMessage([](){});
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100) == 1)
+
+	//the Waitable is disarmed after it has triggered once
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100) == 0)
+	ASSERT_ALWAYS(q.CanRead())
+
+	//re-arm
+	ws.Change(q, ting::Waitable::READ);
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100) == 1)
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100) == 0)
+
+	ASSERT_ALWAYS(q.PeekMsg())
+	ASSERT_ALWAYS(!q.CanRead())
+
+	ws.Change(q, ting::Waitable::READ);
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100) == 0)
+
+	ws.Remove(q);
+}
+}//~namespace
+
+
+
+namespace test_batches{
+void Run(ting::WaitSet::EBackend backend){
+	//batch size is less than number of Waitables added
+	ting::WaitSet ws(4, backend);
+	ASSERT_ALWAYS(ws.BatchSize() == 4)
+
+	std::vector<ting::mt::Queue> queues(10);
+
+	for(auto& q : queues){
+		ws.Add(q, ting::Waitable::READ, ting::Waitable::EDGE_TRIGGERED);
+	}
+	ASSERT_ALWAYS(ws.NumWaitables() == queues.size())
+
+	for(auto& q : queues){
+		q.PushMessage([](){});
+	}
+
+	std::set<ting::Waitable*> reported;
+
+	//output buffer is smaller than the batch size, so triggered Waitables are reported 3 at a time
+	std::array<ting::Waitable*, 3> buf;
+	for(unsigned expected : {3, 3, 3, 1}){
+		unsigned num = ws.WaitWithTimeout(100, buf);
+		ASSERT_INFO_ALWAYS(num == expected, "num = " << num << " expected = " << expected)
+		for(unsigned i = 0; i != num; ++i){
+			ASSERT_ALWAYS(reported.insert(buf[i]).second)
+		}
+	}
+	ASSERT_ALWAYS(reported.size() == queues.size())
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100, buf) == 0)
+
+	//output buffer is bigger than the batch size
+	for(auto& q : queues){
+		ASSERT_ALWAYS(q.PeekMsg())
+		q.PushMessage([](){});
+	}
+
+	std::array<ting::Waitable*, 16> bigBuf;
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100, bigBuf) == 4)
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100, bigBuf) == 4)
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100, bigBuf) == 2)
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100, bigBuf) == 0)
+
+	for(auto& q : queues){
+		ASSERT_ALWAYS(q.PeekMsg())
+		ws.Remove(q);
+	}
+}
+}//~namespace
+
+
+
+namespace test_dispatch{
+void Run(ting::WaitSet::EBackend backend){
+	ting::WaitSet ws(ting::WaitSet::DEFAULT_BATCH_SIZE, backend);
+
+	ting::mt::Queue q1, q2, q3;
+
+	unsigned numCalls1 = 0, numCalls2 = 0;
+
+	q1.SetReadinessHandler([&numCalls1](ting::Waitable& w, ting::Waitable::EReadinessFlags flags){
+		ASSERT_ALWAYS((flags & ting::Waitable::READ) != 0)
+		ASSERT_ALWAYS(static_cast<ting::mt::Queue&>(w).PeekMsg())
+		++numCalls1;
+	});
+
+	//this handler removes the other queue from the wait set
+	q2.SetReadinessHandler([&numCalls2, &ws, &q1](ting::Waitable& w, ting::Waitable::EReadinessFlags flags){
+		ASSERT_ALWAYS((flags & ting::Waitable::READ) != 0)
+		ASSERT_ALWAYS(static_cast<ting::mt::Queue&>(w).PeekMsg())
+		++numCalls2;
+		ws.Remove(q1);
+	});
+
+	//q3 has no handler set
+
+	ws.Add(q1, ting::Waitable::READ);
+	ws.Add(q2, ting::Waitable::READ);
+	ws.Add(q3, ting::Waitable::READ);
+
+	ASSERT_ALWAYS(ws.DispatchWithTimeout(0) == 0)
+
+	q1.PushMessage([](){});
+	ASSERT_ALWAYS(ws.DispatchWithTimeout(100) == 1)
+	ASSERT_ALWAYS(numCalls1 == 1)
+	ASSERT_ALWAYS(numCalls2 == 0)
+
+	q3.PushMessage([](){});
+	ASSERT_ALWAYS(ws.DispatchWithTimeout(100) == 1)
+	ASSERT_ALWAYS(q3.PeekMsg())
+
+	//Both q1 and q2 trigger, whichever handler is called first, q1 is removed and must not
+	//be dispatched after that.
+	q1.PushMessage([](){});
+	q2.PushMessage([](){});
+	ASSERT_ALWAYS(ws.DispatchWithTimeout(100) == 2)
+	ASSERT_ALWAYS(numCalls2 == 1)
+	ASSERT_ALWAYS(numCalls1 == 1 || numCalls1 == 2)
+	if(numCalls1 == 1){
+		ASSERT_ALWAYS(q1.PeekMsg())
+	}
+
+	ws.Remove(q2);
+	ws.Remove(q3);
+}
+}//~namespace
+
+
+
+namespace test_remove_and_add{
+void Run(ting::WaitSet::EBackend backend){
+	ting::WaitSet ws(4, backend);
+
+	ting::mt::Queue q1, q2;
+
+	for(unsigned i = 0; i != 100; ++i){
+		ws.Add(q1, ting::Waitable::READ);
+		q1.PushMessage([](){});
+
+		//remove the triggered Waitable before waiting, it should not be reported
+		ws.Remove(q1);
+		ws.Add(q2, ting::Waitable::READ);
+		ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 0)
+
+		//change flags back and forth while the Waitable is ready
+		q2.PushMessage([](){});
+		ws.Change(q2, ting::Waitable::NOT_READY);
+		ws.Change(q2, ting::Waitable::READ);
+
+		std::array<ting::Waitable*, 4> buf;
+		ASSERT_ALWAYS(ws.WaitWithTimeout(100, buf) == 1)
+		ASSERT_ALWAYS(buf[0] == &q2)
+
+		ASSERT_ALWAYS(q1.PeekMsg())
+		ASSERT_ALWAYS(q2.PeekMsg())
+		ws.Remove(q2);
+	}
+}
+}//~namespace
+
+
+
+namespace test_deferred{
+void Run(ting::WaitSet::EBackend backend){
+	ting::WaitSet ws(4, backend);
+
+	ting::mt::Queue q1, q2, q3;
+
+	ws.AddDeferred(q1, ting::Waitable::READ);
+	ws.AddDeferred(q2, ting::Waitable::READ);
+	ws.AddDeferred(q3, ting::Waitable::READ);
+	ASSERT_ALWAYS(ws.NumWaitables() == 3)
+
+	//removing Waitable which was not actually added yet
+	ws.Remove(q3);
+	ASSERT_ALWAYS(ws.NumWaitables() == 2)
+
+	q1.PushMessage([](){});
+	q3.PushMessage([](){});
+
+	std::array<ting::Waitable*, 4> buf;
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100, buf) == 1)
+	ASSERT_ALWAYS(buf[0] == &q1)
+
+	//coalesced changes which end up with the same flags
+	ws.ChangeDeferred(q1, ting::Waitable::NOT_READY);
+	ws.ChangeDeferred(q1, ting::Waitable::READ);
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100, buf) == 1)
+	ASSERT_ALWAYS(buf[0] == &q1)
+
+	ws.ChangeDeferred(q1, ting::Waitable::NOT_READY);
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100, buf) == 0)
+
+	//immediate change applies the deferred one
+	ws.ChangeDeferred(q2, ting::Waitable::NOT_READY);
+	ws.Change(q1, ting::Waitable::READ);
+	ws.Change(q1, ting::Waitable::READ);//no-op
+	q2.PushMessage([](){});
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100, buf) == 1)
+	ASSERT_ALWAYS(buf[0] == &q1)
+
+	//deferred add followed by immediate change
+	ws.AddDeferred(q3, ting::Waitable::NOT_READY);
+	ws.Change(q3, ting::Waitable::READ);
+	ws.ApplyDeferredChanges();
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100, buf) == 2)
+	ASSERT_ALWAYS((buf[0] == &q1 && buf[1] == &q3) || (buf[0] == &q3 && buf[1] == &q1))
+
+	//removing Waitable with deferred change
+	ws.ChangeDeferred(q2, ting::Waitable::READ);
+	ws.Remove(q2);
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100, buf) == 2)
+
+	ASSERT_ALWAYS(q1.PeekMsg())
+	ASSERT_ALWAYS(q2.PeekMsg())
+	ASSERT_ALWAYS(q3.PeekMsg())
+
+	ws.Remove(q1);
+	ws.Remove(q3);
+	ASSERT_ALWAYS(ws.NumWaitables() == 0)
+}
+}//~namespace
+
+
+
+namespace test_deferred_failure{
+#if M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX
+class ClosedFDWaitable : public ting::Waitable{
+	int fd;
+public:
+	ClosedFDWaitable(){
+		int p[2];
+		ASSERT_ALWAYS(::pipe(p) == 0)
+		close(p[0]);
+		close(p[1]);
+		this->fd = p[0];
+	}
+
+	int GetHandle()override{
+		return this->fd;
+	}
+
+	using ting::Waitable::IsAdded;
+};
+#endif
+
+void Run(ting::WaitSet::EBackend backend){
+#if M_OS == M_OS_LINUX || M_OS == M_OS_MACOSX
+	if(backend != ting::WaitSet::NATIVE){
+		//io_uring reports errors of polling through the error flag of the Waitable
+		return;
+	}
+
+	ting::WaitSet ws(4, backend);
+
+	ting::mt::Queue q1, q2;
+	ClosedFDWaitable bad;
+
+	ws.AddDeferred(q1, ting::Waitable::READ);
+	ws.AddDeferred(bad, ting::Waitable::READ);
+	ws.AddDeferred(q2, ting::Waitable::READ);
+	ASSERT_ALWAYS(ws.NumWaitables() == 3)
+
+	//the failed Waitable is reported and its change stays deferred
+	for(unsigned i = 0; i != 2; ++i){
+		bool thrown = false;
+		try{
+			ws.ApplyDeferredChanges();
+		}catch(ting::WaitSet::Exc& e){
+			thrown = true;
+			ASSERT_ALWAYS(e.GetWaitable() == &bad)
+		}
+		ASSERT_ALWAYS(thrown)
+		ASSERT_ALWAYS(bad.IsAdded())
+		ASSERT_ALWAYS(ws.NumWaitables() == 3)
+	}
+
+	//removing the failed Waitable discards its change, the rest of the changes are applied
+	ws.Remove(bad);
+	ASSERT_ALWAYS(!bad.IsAdded())
+	ASSERT_ALWAYS(ws.NumWaitables() == 2)
+
+	q2.PushMessage([](){});
+
+	std::array<ting::Waitable*, 4> buf;
+	ASSERT_ALWAYS(ws.WaitWithTimeout(100, buf) == 1)
+	ASSERT_ALWAYS(buf[0] == &q2)
+
+	ASSERT_ALWAYS(q2.PeekMsg())
+
+	ws.Remove(q1);
+	ws.Remove(q2);
+	ASSERT_ALWAYS(ws.NumWaitables() == 0)
+#endif
+}
+}//~namespace
+
+
+
+namespace test_chrono_timeouts{
+void Run(ting::WaitSet::EBackend backend){
+	ting::WaitSet ws(4, backend);
+
+	ting::mt::Queue q;
+	ws.Add(q, ting::Waitable::READ);
+
+	std::array<ting::Waitable*, 4> buf;
+
+	//sub-millisecond timeout, it should never return before the timeout
+	for(unsigned i = 0; i != 10; ++i){
+		auto start = std::chrono::steady_clock::now();
+		ASSERT_ALWAYS(ws.WaitWithTimeout(std::chrono::microseconds(200), buf) == 0)
+		ASSERT_ALWAYS(std::chrono::steady_clock::now() - start >= std::chrono::microseconds(200))
+	}
+
+	//zero and negative timeouts just poll
+	ASSERT_ALWAYS(ws.WaitWithTimeout(std::chrono::nanoseconds(0)) == 0)
+	ASSERT_ALWAYS(ws.WaitWithTimeout(std::chrono::seconds(-1)) == 0)
+
+	//deadline
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+		ASSERT_ALWAYS(ws.WaitUntil(deadline, buf) == 0)
+		ASSERT_ALWAYS(std::chrono::steady_clock::now() >= deadline)
+
+		//deadline in the past
+		ASSERT_ALWAYS(ws.WaitUntil(deadline) == 0)
+	}
+
+	//deadline given for system clock
+	{
+		auto start = std::chrono::steady_clock::now();
+		ASSERT_ALWAYS(ws.WaitUntil(std::chrono::system_clock::now() + std::chrono::milliseconds(10)) == 0)
+		ASSERT_ALWAYS(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(9))
+	}
+
+	//triggered Waitable is reported before the timeout
+	q.PushMessage([](){});
+	ASSERT_ALWAYS(ws.WaitWithTimeout(std::chrono::hours(1), buf) == 1)
+	ASSERT_ALWAYS(buf[0] == &q)
+	ASSERT_ALWAYS(ws.WaitUntil(std::chrono::steady_clock::now() + std::chrono::hours(1), buf) == 1)
+
+	//dispatch
+	unsigned numCalls = 0;
+	q.SetReadinessHandler([&numCalls](ting::Waitable&, ting::Waitable::EReadinessFlags){
+		++numCalls;
+	});
+	ASSERT_ALWAYS(ws.DispatchWithTimeout(std::chrono::milliseconds(100)) == 1)
+	ASSERT_ALWAYS(ws.DispatchUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(100)) == 1)
+	ASSERT_ALWAYS(numCalls == 2)
+
+	ASSERT_ALWAYS(q.PeekMsg())
+	ASSERT_ALWAYS(ws.DispatchWithTimeout(std::chrono::microseconds(500)) == 0)
+	ASSERT_ALWAYS(numCalls == 2)
+
+	ws.Remove(q);
+}
+}//~namespace
+
+
+
+namespace test_busy_poll{
+void Run(ting::WaitSet::EBackend backend){
+	ting::WaitSet ws(4, backend);
+
+	ting::mt::Queue q;
+	ws.Add(q, ting::Waitable::READ);
+
+	std::array<ting::Waitable*, 4> buf;
+
+	ASSERT_ALWAYS(ws.BusyPollBudget() == std::chrono::nanoseconds::zero())
+
+	//counters are not updated when busy polling is disabled
+	ASSERT_ALWAYS(ws.WaitWithTimeout(1, buf) == 0)
+	ASSERT_ALWAYS(ws.GetBusyPollCounters().numPolls == 0)
+
+	const std::chrono::nanoseconds maxBudget = std::chrono::milliseconds(1);
+	ws.SetBusyPoll(maxBudget);
+	ASSERT_ALWAYS(ws.BusyPollBudget() == maxBudget)
+
+	//nothing triggers while spinning, spin budget is halved
+	ASSERT_ALWAYS(ws.WaitWithTimeout(20, buf) == 0)
+	ASSERT_ALWAYS(ws.GetBusyPollCounters().numBlocks == 1)
+	ASSERT_ALWAYS(ws.GetBusyPollCounters().numSpinHits == 0)
+	ASSERT_ALWAYS(ws.GetBusyPollCounters().numPolls != 0)
+	ASSERT_ALWAYS(ws.BusyPollBudget() == maxBudget / 2)
+
+	//the budget does not go lower than 1/64 of maximum budget
+	for(unsigned i = 0; i != 10; ++i){
+		ASSERT_ALWAYS(ws.WaitWithTimeout(std::chrono::milliseconds(2), buf) == 0)
+	}
+	ASSERT_ALWAYS(ws.GetBusyPollCounters().numBlocks == 11)
+	ASSERT_ALWAYS(ws.BusyPollBudget() == maxBudget / 64)
+
+	//triggered while spinning, spin budget is doubled
+	q.PushMessage([](){});
+	ASSERT_ALWAYS(ws.Wait(buf) == 1)
+	ASSERT_ALWAYS(buf[0] == &q)
+	ASSERT_ALWAYS(ws.GetBusyPollCounters().numSpinHits == 1)
+	ASSERT_ALWAYS(ws.BusyPollBudget() == maxBudget / 32)
+
+	//waits with zero timeout do not spin
+	{
+		std::uint64_t numPolls = ws.GetBusyPollCounters().numPolls;
+		ASSERT_ALWAYS(ws.WaitWithTimeout(0, buf) == 1)
+		ASSERT_ALWAYS(ws.GetBusyPollCounters().numPolls == numPolls)
+	}
+
+	ASSERT_ALWAYS(q.PeekMsg())
+
+	//timeout hit while spinning is not a miss
+	ws.SetBusyPoll(std::chrono::milliseconds(50));
+	ws.ResetBusyPollCounters();
+	ASSERT_ALWAYS(ws.GetBusyPollCounters().numPolls == 0)
+	{
+		auto start = std::chrono::steady_clock::now();
+		ASSERT_ALWAYS(ws.WaitWithTimeout(std::chrono::milliseconds(2), buf) == 0)
+		ASSERT_ALWAYS(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(2))
+	}
+	ASSERT_ALWAYS(ws.GetBusyPollCounters().numBlocks == 0)
+	ASSERT_ALWAYS(ws.GetBusyPollCounters().numPolls != 0)
+	ASSERT_ALWAYS(ws.BusyPollBudget() == std::chrono::milliseconds(50))
+
+	//very small spin budget does not go down to zero, so it can grow back
+	ws.SetBusyPoll(std::chrono::nanoseconds(10));
+	for(unsigned i = 0; i != 10; ++i){
+		ASSERT_ALWAYS(ws.WaitWithTimeout(1, buf) == 0)
+	}
+	ASSERT_ALWAYS(ws.BusyPollBudget() == std::chrono::nanoseconds(1))
+	q.PushMessage([](){});
+	ASSERT_ALWAYS(ws.Wait(buf) == 1)
+	ASSERT_ALWAYS(ws.BusyPollBudget() == std::chrono::nanoseconds(2))
+	ASSERT_ALWAYS(q.PeekMsg())
+
+	ws.SetBusyPoll(std::chrono::nanoseconds::zero());
+	ws.Remove(q);
+}
+}//~namespace
+
+
+
+namespace test_stats{
+void Run(ting::WaitSet::EBackend backend){
+	ASSERT_ALWAYS(ting::WaitSet::Stats::HistogramBucket(0) == 0)
+	ASSERT_ALWAYS(ting::WaitSet::Stats::HistogramBucket(1) == 1)
+	ASSERT_ALWAYS(ting::WaitSet::Stats::HistogramBucket(2) == 2)
+	ASSERT_ALWAYS(ting::WaitSet::Stats::HistogramBucket(3) == 2)
+	ASSERT_ALWAYS(ting::WaitSet::Stats::HistogramBucket(4) == 3)
+	ASSERT_ALWAYS(ting::WaitSet::Stats::HistogramBucket(std::uint64_t(-1)) == ting::WaitSet::Stats::DNumHistogramBuckets - 1)
+
+	ting::WaitSet ws(4, backend);
+
+	const ting::WaitSet::Stats* stats = ws.GetStats();
+#ifdef M_ENABLE_WAITSET_STATS
+	ASSERT_ALWAYS(stats)
+#endif
+	if(!stats){
+		ws.ResetStats();//should do nothing
+		return;
+	}
+
+	ting::mt::Queue q1, q2;
+
+	ws.Add(q1, ting::Waitable::READ);
+	ws.AddDeferred(q2, ting::Waitable::READ);
+	ws.ChangeDeferred(q2, ting::Waitable::NOT_READY);
+	ws.ChangeDeferred(q2, ting::Waitable::READ);
+	ws.Change(q1, ting::Waitable::READ);//no-op
+
+	ASSERT_ALWAYS(stats->numSystemAdds == 1)
+	ASSERT_ALWAYS(stats->numSystemChanges == 0)
+
+	q1.PushMessage([](){});
+
+	std::array<ting::Waitable*, 4> buf;
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0, buf) == 1)
+	ASSERT_ALWAYS(ws.Wait() == 1)//without output buffer
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0, buf) == 1)
+
+	q2.PushMessage([](){});
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0, buf) == 2)
+
+	ASSERT_ALWAYS(q1.PeekMsg())
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0, buf) == 1)
+
+	ASSERT_ALWAYS(q2.PeekMsg())
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0, buf) == 0)
+
+	ASSERT_ALWAYS(stats->numSystemAdds == 2)
+	ASSERT_ALWAYS(stats->numWaits == 6)
+	ASSERT_ALWAYS(stats->numSystemWaits >= 6)
+	ASSERT_ALWAYS(stats->numEvents == 6)
+	ASSERT_ALWAYS(stats->eventsPerWait[0] == 1)
+	ASSERT_ALWAYS(stats->eventsPerWait[1] == 4)
+	ASSERT_ALWAYS(stats->eventsPerWait[2] == 1)
+	{
+		std::uint64_t sum = 0;
+		for(auto n : stats->waitDurations){
+			sum += n;
+		}
+		ASSERT_ALWAYS(sum == 6)
+	}
+	ASSERT_ALWAYS(stats->numTriggered.size() == 2)
+	ASSERT_ALWAYS(stats->numTriggered.at(&q1) == 4)
+	ASSERT_ALWAYS(stats->numTriggered.at(&q2) == 2)
+
+	ws.Change(q2, ting::Waitable::NOT_READY);
+	ASSERT_ALWAYS(stats->numSystemChanges == 1)
+
+	ws.Remove(q2);
+	ASSERT_ALWAYS(stats->numSystemRemoves == 1)
+	ASSERT_ALWAYS(stats->numTriggered.size() == 1)
+
+	ws.ResetStats();
+	ASSERT_ALWAYS(stats->numWaits == 0)
+	ASSERT_ALWAYS(stats->numSystemAdds == 0)
+	ASSERT_ALWAYS(stats->numTriggered.size() == 0)
+	ASSERT_ALWAYS(stats->eventsPerWait[1] == 0)
+
+	ws.Remove(q1);
+}
+}//~namespace
+
+
+
+namespace test_message_queue_batch_peek{
+void Run(){
+	ting::WaitSet ws(1);
+
+	ting::mt::Queue q;
+	ws.Add(q, ting::Waitable::READ);
+
+	ASSERT_ALWAYS(q.PeekAllMsgs().size() == 0)
+
+	std::vector<unsigned> handled;
+	for(unsigned i = 0; i != 5; ++i){
+		q.PushMessage([&handled, i](){handled.push_back(i);});
+	}
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 1)
+
+	//peek part of the messages
+	{
+		std::array<ting::mt::Queue::T_Message, 2> buf;
+		ASSERT_ALWAYS(q.PeekMsgs(buf) == 2)
+		for(auto& m : buf){
+			m();
+		}
+		ASSERT_ALWAYS(q.CanRead())
+		ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 1)
+	}
+
+	//peek the rest of the messages
+	{
+		auto msgs = q.PeekAllMsgs();
+		ASSERT_ALWAYS(msgs.size() == 3)
+		ASSERT_ALWAYS(!q.CanRead())
+		ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 0)
+
+		//messages pushed after peeking are not included in the batch
+		q.PushMessage([&handled](){handled.push_back(100);});
+
+		for(auto& m : msgs){
+			m();
+		}
+	}
+
+	ASSERT_ALWAYS(handled.size() == 5)
+	for(unsigned i = 0; i != handled.size(); ++i){
+		ASSERT_ALWAYS(handled[i] == i)
+	}
+
+	//peek to the buffer bigger than number of messages
+	{
+		ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 1)
+		std::array<ting::mt::Queue::T_Message, 4> buf;
+		ASSERT_ALWAYS(q.PeekMsgs(buf) == 1)
+		buf[0]();
+		ASSERT_ALWAYS(handled.back() == 100)
+		ASSERT_ALWAYS(!q.CanRead())
+		ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 0)
+		ASSERT_ALWAYS(q.PeekMsgs(buf) == 0)
+	}
+
+	ws.Remove(q);
+}
+}//~namespace
+
+
+
+namespace test_message_queue_priorities{
+void Run(){
+	typedef ting::mt::Queue Q;
+
+	ting::WaitSet ws(1);
+
+	Q q;
+	ws.Add(q, ting::Waitable::READ);
+
+	std::vector<unsigned> handled;
+	auto push = [&q, &handled](unsigned id, Q::EPriority p){
+		q.PushMessage([&handled, id](){handled.push_back(id);}, p);
+	};
+
+	//one by one, highest priority first, same priority in FIFO order
+	push(0, Q::LOW);
+	push(1, Q::NORMAL);
+	push(2, Q::NORMAL);
+	push(3, Q::HIGH);
+	push(4, Q::LOW);
+	push(5, Q::HIGH);
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 1)
+
+	while(auto m = q.PeekMsg()){
+		m();
+	}
+	ASSERT_ALWAYS(!q.CanRead())
+	ASSERT_ALWAYS(ws.WaitWithTimeout(0) == 0)
+	{
+		std::vector<unsigned> expected = {3, 5, 1, 2, 0, 4};
+		ASSERT_ALWAYS(handled == expected)
+	}
+
+	//all at once
+	handled.clear();
+	push(0, Q::NORMAL);
+	push(1, Q::LOW);
+	push(2, Q::HIGH);
+	push(3, Q::NORMAL);
+	for(auto& m : q.PeekAllMsgs()){
+		m();
+	}
+	ASSERT_ALWAYS(!q.CanRead())
+	{
+		std::vector<unsigned> expected = {2, 0, 3, 1};
+		ASSERT_ALWAYS(handled == expected)
+	}
+
+	//to the buffer
+	handled.clear();
+	push(0, Q::LOW);
+	push(1, Q::NORMAL);
+	push(2, Q::HIGH);
+	push(3, Q::LOW);
+	{
+		std::array<Q::T_Message, 3> buf;
+		ASSERT_ALWAYS(q.PeekMsgs(buf) == 3)
+		ASSERT_ALWAYS(q.CanRead())
+		for(auto& m : buf){
+			m();
+		}
+		//high priority message pushed later goes before the remaining low priority one
+		push(4, Q::HIGH);
+		ASSERT_ALWAYS(q.PeekMsgs(buf) == 2)
+		ASSERT_ALWAYS(!q.CanRead())
+		buf[0]();
+		buf[1]();
+	}
+	{
+		std::vector<unsigned> expected = {2, 1, 0, 4, 3};
+		ASSERT_ALWAYS(handled == expected)
+	}
+
+	ws.Remove(q);
+}
+}//~namespace
+
+
+
+namespace test_message_queue_no_alloc{
+
+class TestThread : public ting::mt::MsgThread{
+public:
+	//override
+	void Run(){}
+};
+
+void Run(){
+	//typical message captures two pointers and a 32 byte payload
+	struct Payload{
+		std::array<std::uint8_t, 32> data;
+	};
+
+	unsigned first = 0;
+	unsigned last = 0;
+
+	auto push = [&first, &last](ting::mt::Queue& q, std::uint8_t i){
+		Payload p;
+		p.data.fill(i);
+		unsigned* pf = &first;
+		unsigned* pl = &last;
+		q.PushMessage([pf, pl, p](){
+			*pf += p.data.front();
+			*pl += p.data.back();
+		});
+	};
+
+	ting::mt::Queue q;
+
+	//one by one
+	{
+		unsigned n = numAllocations;
+		for(unsigned i = 0; i != ting::mt::Queue::DEFAULT_RESERVE; ++i){
+			push(q, std::uint8_t(i));
+		}
+		ASSERT_INFO_ALWAYS(numAllocations == n, "numAllocations - n = " << (numAllocations - n))
+
+		while(auto m = q.PeekMsg()){
+			m();
+		}
+		ASSERT_ALWAYS(numAllocations == n)
+		ASSERT_ALWAYS(first == (ting::mt::Queue::DEFAULT_RESERVE - 1) * ting::mt::Queue::DEFAULT_RESERVE / 2)
+		ASSERT_ALWAYS(last == first)
+	}
+
+	//nodes taken out in a batch are reused after the batch is destroyed
+	{
+		first = 0;
+		for(unsigned i = 0; i != ting::mt::Queue::DEFAULT_RESERVE; ++i){
+			push(q, 1);
+		}
+		for(auto& m : q.PeekAllMsgs()){
+			m();
+		}
+		ASSERT_ALWAYS(first == ting::mt::Queue::DEFAULT_RESERVE)
+
+		unsigned n = numAllocations;
+		for(unsigned i = 0; i != ting::mt::Queue::DEFAULT_RESERVE; ++i){
+			push(q, 1);
+		}
+		ASSERT_INFO_ALWAYS(numAllocations == n, "numAllocations - n = " << (numAllocations - n))
+		ASSERT_ALWAYS(q.PeekAllMsgs().size() == ting::mt::Queue::DEFAULT_RESERVE)
+	}
+
+	//pushing to MsgThread
+	{
+		TestThread t;
+		first = 0;
+		unsigned n = numAllocations;
+		Payload p;
+		p.data.fill(3);
+		unsigned* pf = &first;
+		unsigned* pl = &last;
+		t.PushMessage([pf, pl, p](){
+			*pf += p.data.front();
+			*pl += p.data.back();
+		});
+		t.PushPreallocatedQuitMessage();
+		ASSERT_ALWAYS(numAllocations == n)
+	}
+}
+}//~namespace
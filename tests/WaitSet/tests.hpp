@@ -1,11 +1,65 @@
 #pragma once
 
+#include "../../src/ting/WaitSet.hpp"
+
 
 
 namespace test_message_queue_as_waitable{
 void Run();
 }//~namespace
 
-namespace test_general{
+namespace test_message_queue_batch_peek{
+void Run();
+}//~namespace
+
+namespace test_message_queue_priorities{
+void Run();
+}//~namespace
+
+namespace test_message_queue_no_alloc{
 void Run();
 }//~namespace
+
+namespace test_general{
+void Run(ting::WaitSet::EBackend backend);
+}//~namespace
+
+namespace test_edge_triggered{
+void Run(ting::WaitSet::EBackend backend);
+}//~namespace
+
+namespace test_one_shot{
+void Run(ting::WaitSet::EBackend backend);
+}//~namespace
+
+namespace test_batches{
+void Run(ting::WaitSet::EBackend backend);
+}//~namespace
+
+namespace test_dispatch{
+void Run(ting::WaitSet::EBackend backend);
+}//~namespace
+
+namespace test_remove_and_add{
+void Run(ting::WaitSet::EBackend backend);
+}//~namespace
+
+namespace test_deferred{
+void Run(ting::WaitSet::EBackend backend);
+}//~namespace
+
+namespace test_deferred_failure{
+void Run(ting::WaitSet::EBackend backend);
+}//~namespace
+
+namespace test_chrono_timeouts{
+void Run(ting::WaitSet::EBackend backend);
+}//~namespace
+
+namespace test_busy_poll{
+void Run(ting::WaitSet::EBackend backend);
+}//~namespace
+
+namespace test_stats{
+void Run(ting::WaitSet::EBackend backend);
+}//~namespace
@@ -0,0 +1,2 @@
+//WaitSet implementation with statistics enabled, overrides the one from libting
+#include "../../src/ting/WaitSet.cpp"
@@ -0,0 +1,2 @@
+//WaitSet tests built together with WaitSet implementation compiled with statistics enabled
+#include "../WaitSet/main.cpp"
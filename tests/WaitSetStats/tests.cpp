@@ -0,0 +1 @@
+#include "../WaitSet/tests.cpp"
@@ -2,16 +2,41 @@
 
 #include "../../src/ting/debug.hpp"
 #include "../../src/ting/timer.hpp"
+#include "../../src/ting/mt/MsgThread.hpp"
 
 #include "tests.hpp"
 
 
 inline void TestTingTimer(){
-	ting::timer::Lib timerLib;
+	ClockTest::Run();
+	TimerWheelTest::Run();
+	PerThreadTimersTest::Run();
 
-	BasicTimerTest::Run();
-	SeveralTimersForTheSameInterval::Run();
-	StoppingTimers::Run();
+	{
+		ting::timer::Lib timerLib;
+
+		BasicTimerTest::Run();
+		SeveralTimersForTheSameInterval::Run();
+		StoppingTimers::Run();
+		PeriodicTimersTest::RunInLib();
+	}
+
+	{
+		ting::timer::Lib timerLib(ting::timer::WHEEL);
+
+		SeveralTimersForTheSameInterval::Run();
+		StoppingTimers::Run();
+		PeriodicTimersTest::RunInLib();
+	}
+
+	TimerQueueTest::Run(ting::timer::ORDERED_MAP);
+	TimerQueueTest::Run(ting::timer::WHEEL);
+
+	SlackTest::Run(ting::timer::ORDERED_MAP);
+	SlackTest::Run(ting::timer::WHEEL);
+
+	PeriodicTimersTest::Run(ting::timer::ORDERED_MAP);
+	PeriodicTimersTest::Run(ting::timer::WHEEL);
 
 	TRACE_ALWAYS(<< "[PASSED]: Timer test" << std::endl)
 }
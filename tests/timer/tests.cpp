@@ -1,12 +1,65 @@
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <vector>
+#include <random>
+#include <functional>
 
 #include "../../src/ting/debug.hpp"
 #include "../../src/ting/timer.hpp"
+#include "../../src/ting/mt/MsgThread.hpp"
 
 #include "tests.hpp"
 
 
 
+namespace ClockTest{
+
+void Run(){
+	TRACE_ALWAYS(<< "\tRunning ClockTest..." << std::endl)
+
+	//monotonic
+	{
+		std::uint64_t prev = ting::timer::GetNanoTicks();
+		for(unsigned i = 0; i != 100000; ++i){
+			std::uint64_t t = ting::timer::GetNanoTicks();
+			ASSERT_ALWAYS(t >= prev)
+			prev = t;
+		}
+	}
+
+	//all the clocks are the same clock in different units
+	{
+		std::uint64_t ns = ting::timer::GetNanoTicks();
+		std::uint64_t ms = ting::timer::GetTicks64();
+		std::uint32_t ms32 = ting::timer::GetTicks();
+		ASSERT_ALWAYS(ms >= ns / 1000000 && ms - ns / 1000000 <= 1)
+		ASSERT_ALWAYS(std::uint32_t(ms32 - std::uint32_t(ms)) <= 1)
+	}
+
+	//resolution is better than a millisecond
+	{
+		std::uint64_t start = ting::timer::GetNanoTicks();
+		std::uint64_t t;
+		do{
+			t = ting::timer::GetNanoTicks();
+		}while(t == start);
+		ASSERT_INFO_ALWAYS(t - start < 1000000, "t - start = " << (t - start))
+	}
+
+	{
+		std::uint64_t start = ting::timer::GetNanoTicks();
+		ting::mt::Thread::Sleep(100);
+		std::uint64_t elapsed = ting::timer::GetNanoTicks() - start;
+		ASSERT_INFO_ALWAYS(elapsed >= 100000000 && elapsed < 300000000, "elapsed = " << elapsed)
+	}
+}
+
+}//~namespace
+
+
+
 namespace BasicTimerTest{
 
 struct TestTimer1 : public ting::timer::Timer{
@@ -180,3 +233,587 @@ void Run(){
 }
 
 }//~namespace
+
+
+
+namespace TimerQueueTest{
+
+struct TestTimer : public ting::timer::Timer{
+	std::vector<unsigned>& log;
+	unsigned id;
+
+	std::function<void()> onExpired;
+
+	TestTimer(std::vector<unsigned>& log, unsigned id) :
+			log(log),
+			id(id)
+	{}
+
+	//override
+	void OnExpired()NOEXCEPT{
+		this->log.push_back(this->id);
+		if(this->onExpired){
+			this->onExpired();
+		}
+	}
+};
+
+
+
+void Run(ting::timer::EStorage storage){
+	TRACE_ALWAYS(<< "\tRunning TimerQueueTest, it will take about 1 second..." << std::endl)
+
+	ting::WaitSet ws;
+	ting::timer::TimerQueue queue(storage);
+
+	ws.Add(queue, ting::Waitable::READ);
+
+	std::vector<unsigned> log;
+
+	TestTimer t1(log, 1), t2(log, 2), t3(log, 3), t4(log, 4), t5(log, 5);
+
+	//t5 restarts itself once with zero timeout
+	bool restarted = false;
+	t5.onExpired = [&t5, &queue, &restarted](){
+		if(!restarted){
+			restarted = true;
+			t5.Start(queue, 0);
+		}
+	};
+
+	//t4 stops t3 which expires at the same time
+	t4.onExpired = [&t3](){
+		t3.Stop();
+	};
+
+	t1.Start(queue, 300);
+	t2.Start(queue, 100);
+	t4.Start(queue, 200);
+	t3.Start(queue, 200);
+	t5.Start(queue, 0);
+
+	ASSERT_ALWAYS(ws.DispatchWithTimeout(0) <= 1)//t5 might have already expired
+
+	std::uint32_t startTicks = ting::timer::GetTicks();
+	while(log.size() != 5){
+		ws.DispatchWithTimeout(1000);
+		ASSERT_ALWAYS(ting::timer::GetTicks() - startTicks < 1000)
+	}
+
+	ASSERT_INFO_ALWAYS(
+			log == std::vector<unsigned>({5, 5, 2, 4, 1}),
+			"log = " << log[0] << log[1] << log[2] << log[3] << log[4]
+		)
+
+	//stopping the expired timer
+	ASSERT_ALWAYS(!t1.Stop())
+
+	//stopped timer does not expire
+	t1.Start(queue, 100);
+	ASSERT_ALWAYS(t1.Stop())
+	ws.DispatchWithTimeout(200);
+	ASSERT_ALWAYS(log.size() == 5)
+
+	//waiting without dispatching
+	t2.Start(queue, 50);
+	{
+		std::array<ting::Waitable*, 1> triggered;
+		ASSERT_ALWAYS(ws.WaitWithTimeout(1000, triggered) == 1)
+		ASSERT_ALWAYS(triggered[0] == &queue)
+		queue.HandleExpiredTimers();
+	}
+	ASSERT_ALWAYS(log.size() == 6)
+	ASSERT_ALWAYS(log.back() == 2)
+
+	ws.Remove(queue);
+}
+
+}//~namespace
+
+
+
+namespace TimerWheelTest{
+
+struct TestTimer : public ting::timer::Timer{
+	std::uint64_t due;//first tick at which the timer should expire
+	bool isInWheel = false;
+
+	//override
+	void OnExpired()NOEXCEPT{}
+};
+
+
+
+void Run(){
+	TRACE_ALWAYS(<< "\tRunning TimerWheelTest..." << std::endl)
+
+	const std::uint64_t DStartTicks = 123456789;
+	const unsigned DNumTimers = 2000;
+
+	ting::timer::TimerWheel wheel(DStartTicks);
+
+	std::minstd_rand rnd(17);
+
+	std::vector<TestTimer> timers(DNumTimers);
+
+	std::uint64_t ticks = DStartTicks;//ticks of the last processing
+
+	auto insert = [&](TestTimer& t, std::uint64_t deadline){
+		ASSERT_ALWAYS(!t.isInWheel)
+		wheel.Insert(t, deadline);
+		t.due = std::max(deadline, ticks + 1);
+		t.isInWheel = true;
+	};
+
+	//timeouts of different orders, including already passed deadlines and the ones beyond the wheel span
+	for(unsigned i = 0; i != DNumTimers; ++i){
+		std::uint64_t timeout;
+		switch(i % 6){
+			case 0:
+				timeout = rnd() % 100;
+				break;
+			case 1:
+				timeout = rnd() % 5000;
+				break;
+			case 2:
+				timeout = rnd() % 300000;
+				break;
+			case 3:
+				timeout = rnd() % (1 << 26);
+				break;
+			case 4:
+				timeout = (std::uint64_t(1) << 37) + rnd();
+				break;
+			default:
+				insert(timers[i], DStartTicks - rnd() % 1000);
+				continue;
+		}
+		insert(timers[i], DStartTicks + timeout);
+	}
+	ASSERT_ALWAYS(wheel.Size() == DNumTimers)
+
+	std::vector<ting::timer::Timer*> expired;
+
+	auto process = [&](std::uint64_t newTicks){
+		expired.clear();
+		wheel.PopExpired(newTicks, expired);
+		for(ting::timer::Timer* p : expired){
+			TestTimer& t = *static_cast<TestTimer*>(p);
+			ASSERT_ALWAYS(t.isInWheel)
+			ASSERT_INFO_ALWAYS(ticks < t.due && t.due <= newTicks, "due = " << t.due << " ticks = " << ticks << " newTicks = " << newTicks)
+			t.isInWheel = false;
+		}
+		ticks = newTicks;
+	};
+
+	for(unsigned iter = 0; ticks < DStartTicks + (1 << 27); ++iter){
+		//next tick to process should not be later than any deadline
+		if(iter % 16 == 0){
+			std::uint64_t minDue = std::uint64_t(-1);
+			for(auto& t : timers){
+				if(t.isInWheel){
+					minDue = std::min(minDue, t.due);
+				}
+			}
+			ASSERT_ALWAYS(wheel.NextTick() <= minDue)
+		}
+
+		process(ticks + rnd() % 3000 + 1);
+
+		//stop and restart some timers
+		for(unsigned i = 0; i != 10; ++i){
+			TestTimer& t = timers[rnd() % timers.size()];
+			if(t.isInWheel){
+				wheel.Erase(t);
+				t.isInWheel = false;
+			}else{
+				insert(t, ticks + rnd() % (1 << (rnd() % 24)));
+			}
+		}
+	}
+
+	//all the remaining timers are beyond the wheel span
+	process(std::uint64_t(1) << 41);
+
+	ASSERT_ALWAYS(wheel.Size() == 0)
+	for(auto& t : timers){
+		ASSERT_ALWAYS(!t.isInWheel)
+	}
+	ASSERT_ALWAYS(wheel.NextTick() == std::uint64_t(-1))
+}
+
+}//~namespace
+
+
+
+namespace PerThreadTimersTest{
+
+class LoopThread : public ting::mt::MsgThread{
+public:
+	ting::timer::TimerQueue timerQueue;
+
+	std::atomic<ting::mt::Thread::T_ThreadID> threadID{0};
+
+	//override
+	void Run(){
+		this->threadID = ting::mt::Thread::GetCurrentThreadID();
+		this->timerQueue.AttachToThisThread();
+
+		ting::WaitSet ws;
+		ws.Add(this->queue, ting::Waitable::READ);
+		ws.Add(this->timerQueue, ting::Waitable::READ);
+
+		while(!this->quitFlag){
+			ws.Dispatch();
+			while(auto m = this->queue.PeekMsg()){
+				m();
+			}
+		}
+
+		ws.Remove(this->timerQueue);
+		ws.Remove(this->queue);
+
+		this->timerQueue.DetachFromThisThread();
+	}
+};
+
+
+
+struct TestTimer : public ting::timer::Timer{
+	std::atomic<bool> expired{false};
+	std::atomic<ting::mt::Thread::T_ThreadID> expiredIn{0};
+
+	//override
+	void OnExpired()NOEXCEPT{
+		this->expiredIn = ting::mt::Thread::GetCurrentThreadID();
+		this->expired = true;
+	}
+};
+
+
+
+struct SlowTimer : public ting::timer::Timer{
+	std::atomic<bool> entered{false};
+	std::atomic<bool> left{false};
+
+	//override
+	void OnExpired()NOEXCEPT{
+		this->entered = true;
+		ting::mt::Thread::Sleep(200);
+		this->left = true;
+	}
+};
+
+
+
+struct SelfDeletingTimer : public ting::timer::Timer{
+	std::atomic<bool>& deleted;
+
+	SelfDeletingTimer(std::atomic<bool>& deleted) :
+			deleted(deleted)
+	{}
+
+	//override
+	void OnExpired()NOEXCEPT{
+		std::atomic<bool>& d = this->deleted;
+		delete this;
+		d = true;
+	}
+};
+
+
+
+void Run(){
+	TRACE_ALWAYS(<< "\tRunning PerThreadTimersTest, it will take about 1 second..." << std::endl)
+
+	LoopThread loop;
+	loop.Start();
+
+	const unsigned DNumTimers = 200;
+
+	std::vector<std::unique_ptr<TestTimer>> timers;
+	for(unsigned i = 0; i != DNumTimers; ++i){
+		timers.push_back(std::unique_ptr<TestTimer>(new TestTimer()));
+	}
+
+	//timers started in the timer queue attached to the loop thread, timer library is not initialized
+	loop.PushCall([&timers](){
+		ASSERT_ALWAYS(!ting::timer::Lib::IsCreated())
+		for(unsigned i = 0; i != timers.size(); ++i){
+			timers[i]->Start(*ting::timer::TimerQueue::OfThisThread(), 300 + i % 50);
+		}
+	}).Wait();
+
+	//stop every other timer from this thread and destroy it right away
+	for(unsigned i = 1; i < timers.size(); i += 2){
+		ASSERT_ALWAYS(timers[i]->Stop())
+		ASSERT_ALWAYS(!timers[i]->expired)
+		timers[i].reset();
+	}
+
+	std::uint32_t startTicks = ting::timer::GetTicks();
+	for(unsigned i = 0; i < timers.size(); i += 2){
+		while(!timers[i]->expired){
+			ting::mt::Thread::Sleep(10);
+			ASSERT_ALWAYS(ting::timer::GetTicks() - startTicks < 2000)
+		}
+		ASSERT_ALWAYS(timers[i]->expiredIn == loop.threadID)
+	}
+
+	//stopping from another thread races with expiration, exactly one of those should happen
+	for(unsigned iter = 0; iter != 20; ++iter){
+		std::vector<std::unique_ptr<TestTimer>> racing;
+		for(unsigned i = 0; i != 100; ++i){
+			racing.push_back(std::unique_ptr<TestTimer>(new TestTimer()));
+		}
+
+		loop.PushCall([&racing](){
+			for(unsigned i = 0; i != racing.size(); ++i){
+				racing[i]->Start(*ting::timer::TimerQueue::OfThisThread(), i % 3);
+			}
+		}).Wait();
+
+		std::vector<bool> stopped;
+		for(auto& t : racing){
+			stopped.push_back(t->Stop());
+		}
+
+		//restart stopped timers from the loop thread, it has to wait for the queue to release them
+		loop.PushCall([&racing, &stopped](){
+			for(unsigned i = 0; i != racing.size(); ++i){
+				if(stopped[i]){
+					racing[i]->Start(*ting::timer::TimerQueue::OfThisThread(), 100000);
+					ASSERT_ALWAYS(racing[i]->Stop())
+				}
+			}
+		}).Wait();
+
+		for(unsigned i = 0; i != racing.size(); ++i){
+			ASSERT_ALWAYS(racing[i]->expired != stopped[i])
+		}
+	}
+
+	//stopping from another thread while the handler is being called waits until it returns
+	{
+		SlowTimer t;
+		loop.PushCall([&t](){
+			t.Start(*ting::timer::TimerQueue::OfThisThread(), 0);
+		}).Wait();
+		while(!t.entered){
+			ting::mt::Thread::Sleep(1);
+		}
+		ASSERT_ALWAYS(!t.Stop())
+		ASSERT_ALWAYS(t.left)
+	}
+
+	//timer can destroy itself from within the handler
+	{
+		std::atomic<bool> deleted{false};
+		loop.PushCall([&deleted](){
+			(new SelfDeletingTimer(deleted))->Start(*ting::timer::TimerQueue::OfThisThread(), 0);
+		}).Wait();
+		std::uint32_t startTicks = ting::timer::GetTicks();
+		while(!deleted){
+			ting::mt::Thread::Sleep(1);
+			ASSERT_ALWAYS(ting::timer::GetTicks() - startTicks < 2000)
+		}
+	}
+
+	loop.PushPreallocatedQuitMessage();
+	loop.Join();
+}
+
+}//~namespace
+
+
+
+namespace SlackTest{
+
+struct TestTimer : public ting::timer::Timer{
+	std::uint32_t expiredAt = 0;
+
+	//override
+	void OnExpired()NOEXCEPT{
+		this->expiredAt = ting::timer::GetTicks();
+	}
+};
+
+
+
+void Run(ting::timer::EStorage storage){
+	TRACE_ALWAYS(<< "\tRunning SlackTest, it will take about 1 second..." << std::endl)
+
+	ting::WaitSet ws;
+	ting::timer::TimerQueue queue(storage);
+
+	ws.Add(queue, ting::Waitable::READ);
+
+	const unsigned DNumTimers = 50;
+	const std::uint32_t DSlack = 200;
+
+	std::array<TestTimer, DNumTimers> timers;
+
+	std::uint32_t startTicks = ting::timer::GetTicks();
+
+	//timers expiring every 2 milliseconds, without slack that would be a wake up per timer
+	for(unsigned i = 0; i != timers.size(); ++i){
+		timers[i].SetSlack(DSlack);
+		ASSERT_ALWAYS(timers[i].Slack() == DSlack)
+		timers[i].Start(queue, 100 + i * 2);
+	}
+
+	unsigned numWakeUps = 0;
+	while(std::find_if(timers.begin(), timers.end(), [](const TestTimer& t){return t.expiredAt == 0;}) != timers.end()){
+		if(ws.DispatchWithTimeout(1000) != 0){
+			++numWakeUps;
+		}
+		ASSERT_ALWAYS(ting::timer::GetTicks() - startTicks < 2000)
+	}
+
+	//timers spread over 100 ms fall into a few aligned moments within the 200 ms slack
+	ASSERT_INFO_ALWAYS(numWakeUps <= 4, "numWakeUps = " << numWakeUps)
+
+	for(unsigned i = 0; i != timers.size(); ++i){
+		std::uint32_t elapsed = timers[i].expiredAt - startTicks;
+		ASSERT_INFO_ALWAYS(elapsed >= 100 + i * 2, "elapsed = " << elapsed)
+		ASSERT_INFO_ALWAYS(elapsed <= 100 + i * 2 + DSlack + 50, "elapsed = " << elapsed)
+	}
+
+	ws.Remove(queue);
+}
+
+}//~namespace
+
+
+
+namespace PeriodicTimersTest{
+
+struct TestTimer : public ting::timer::Timer{
+	std::uint32_t startTicks;
+	std::vector<std::uint32_t> expirations;//ticks since start
+
+	std::uint32_t sleepOnFirst = 0;
+
+	//override
+	void OnExpired()NOEXCEPT{
+		this->expirations.push_back(ting::timer::GetTicks() - this->startTicks);
+		if(this->expirations.size() == 1){
+			ting::mt::Thread::Sleep(this->sleepOnFirst);
+		}
+	}
+};
+
+
+
+std::vector<std::uint32_t> RunTimer(
+		ting::timer::TimerQueue& queue,
+		std::uint32_t period,
+		ting::timer::Timer::EMissedTicks missedTicks,
+		std::uint32_t sleepOnFirst,
+		unsigned numExpirations
+	)
+{
+	ting::WaitSet ws;
+	ws.Add(queue, ting::Waitable::READ);
+
+	TestTimer timer;
+	timer.sleepOnFirst = sleepOnFirst;
+	timer.startTicks = ting::timer::GetTicks();
+	timer.StartPeriodic(queue, period, missedTicks);
+
+	while(timer.expirations.size() < numExpirations){
+		ws.DispatchWithTimeout(1000);
+		ASSERT_ALWAYS(ting::timer::GetTicks() - timer.startTicks < 5000)
+	}
+
+	//periodic timer keeps running
+	ASSERT_ALWAYS(timer.Stop())
+	ASSERT_ALWAYS(!timer.Stop())
+
+	ws.Remove(queue);
+
+	return std::move(timer.expirations);
+}
+
+
+
+void Run(ting::timer::EStorage storage){
+	TRACE_ALWAYS(<< "\tRunning PeriodicTimersTest, it will take about 2 seconds..." << std::endl)
+
+	ting::timer::TimerQueue queue(storage);
+
+	//no drift, even though every expiration is handled a bit late
+	{
+		auto e = RunTimer(queue, 20, ting::timer::Timer::SKIP, 0, 20);
+		ASSERT_INFO_ALWAYS(e.back() >= 400 && e.back() < 430, "e.back() = " << e.back())
+	}
+
+	//First handler call takes 250 ms, the 200 ms tick is missed and handled late right after that.
+	//Then the timer continues according to the policy.
+	{
+		auto e = RunTimer(queue, 100, ting::timer::Timer::SKIP, 250, 4);
+		ASSERT_INFO_ALWAYS(e[1] >= 350 && e[1] < 380, "e[1] = " << e[1])
+		ASSERT_INFO_ALWAYS(e[2] >= 400 && e[2] < 430, "e[2] = " << e[2])
+		ASSERT_INFO_ALWAYS(e[3] >= 500 && e[3] < 530, "e[3] = " << e[3])
+	}
+	{
+		auto e = RunTimer(queue, 100, ting::timer::Timer::CATCH_UP, 250, 4);
+		ASSERT_INFO_ALWAYS(e[1] >= 350 && e[1] < 380, "e[1] = " << e[1])
+		ASSERT_INFO_ALWAYS(e[2] - e[1] < 20, "e[2] = " << e[2])//the 300 ms tick
+		ASSERT_INFO_ALWAYS(e[3] >= 400 && e[3] < 430, "e[3] = " << e[3])
+	}
+	{
+		//lots of missed ticks are caught up right away, not one per millisecond
+		auto e = RunTimer(queue, 10, ting::timer::Timer::CATCH_UP, 250, 25);
+		ASSERT_INFO_ALWAYS(e[24] - e[1] < 10, "e[1] = " << e[1] << " e[24] = " << e[24])
+	}
+	{
+		auto e = RunTimer(queue, 100, ting::timer::Timer::RESTART, 250, 3);
+		ASSERT_INFO_ALWAYS(e[1] >= 350 && e[1] < 380, "e[1] = " << e[1])
+		ASSERT_INFO_ALWAYS(e[2] - e[1] >= 100 && e[2] - e[1] < 130, "e[2] = " << e[2])
+	}
+
+	//zero period is not allowed
+	{
+		TestTimer timer;
+		bool thrown = false;
+		try{
+			timer.StartPeriodic(queue, 0);
+		}catch(ting::Exc&){
+			thrown = true;
+		}
+		ASSERT_ALWAYS(thrown)
+	}
+}
+
+
+
+struct StoppingTimer : public ting::timer::Timer{
+	std::atomic<unsigned> count{0};
+	std::atomic<bool> stopped{false};
+
+	//override
+	void OnExpired()NOEXCEPT{
+		if(++this->count == 5){
+			this->stopped = this->Stop();
+		}
+	}
+};
+
+
+
+void RunInLib(){
+	TRACE_ALWAYS(<< "\tRunning PeriodicTimersTest in timer library, it will take about 1 second..." << std::endl)
+
+	StoppingTimer timer;
+	timer.StartPeriodic(50);
+
+	ting::mt::Thread::Sleep(500);
+
+	//the timer has stopped itself from within the handler
+	ASSERT_ALWAYS(timer.stopped)
+	ASSERT_ALWAYS(timer.count == 5)
+	ASSERT_ALWAYS(!timer.Stop())
+}
+
+}//~namespace
@@ -1,7 +1,12 @@
 #pragma once
 
+#include "../../src/ting/timer.hpp"
 
 
+namespace ClockTest{
+void Run();
+}//~namespace
+
 namespace BasicTimerTest{
 void Run();
 }//~namespace
@@ -13,3 +18,24 @@ void Run();
 namespace StoppingTimers{
 void Run();
 }//~namespace
+
+namespace TimerQueueTest{
+void Run(ting::timer::EStorage storage);
+}//~namespace
+
+namespace TimerWheelTest{
+void Run();
+}//~namespace
+
+namespace PerThreadTimersTest{
+void Run();
+}//~namespace
+
+namespace SlackTest{
+void Run(ting::timer::EStorage storage);
+}//~namespace
+
+namespace PeriodicTimersTest{
+void Run(ting::timer::EStorage storage);
+void RunInLib();
+}//~namespace